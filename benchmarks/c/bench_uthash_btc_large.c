@@ -104,7 +104,11 @@ double test_insert_uthash()
 
 double test_insert_zmap() 
 {
+#ifdef BENCH_HUGEPAGES
+    m_zmap = map_init_alloc(BtcMap, hash_btc, cmp_btc, zmap_hugepage_allocator());
+#else
     m_zmap = map_init(BtcMap, hash_btc, cmp_btc);
+#endif
     double start = now();
     for (int i = 0; i < ITER_ITEMS; i++) 
     {
@@ -0,0 +1,422 @@
+
+/*
+ * bench_memory.cpp — bytes per entry and peak RSS: zmap against uthash and
+ * std::unordered_map.
+ *
+ * Each configuration (container, value size, load factor, entry count) is
+ * built in a fresh child process, so one run's heap never inflates the next.
+ * Three numbers are reported per configuration:
+ *
+ *   reported   What the library says it holds: zmap_memory_usage for zmap,
+ *              HASH_OVERHEAD plus the element structs for uthash, and an
+ *              estimate from node and bucket sizes for std::unordered_map.
+ *   rss        Resident-set growth while building, as the OS sees it. This
+ *              includes allocator headers and rounding.
+ *   peak_rss   Peak resident-set growth, which also catches the old and new
+ *              tables held side by side during a resize.
+ *
+ * zmap's load factor is swept (standard, stable and stable-arena storage);
+ * uthash and std::unordered_map run with their defaults. Sizes go in 1-2-5
+ * steps from 10^4 entries up to --max-n (default 10^7, 10^6 with --quick).
+ *
+ * Usage: bench_memory [--format json|csv|both] [--out PREFIX] [--max-n N] [--quick]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Blob64
+{
+    uint64_t w[8];
+};
+
+#define REGISTER_ZMAP_TYPES(X)          \
+    X(uint64_t, uint64_t, U64)          \
+    X(uint64_t, Blob64, U64Blob)
+
+#define REGISTER_STABLE_MAPS(X)         \
+    X(uint64_t, uint64_t, U64)          \
+    X(uint64_t, Blob64, U64Blob)
+
+#include "zmap.h"
+#include "uthash.h"
+#include "workloads.hpp"
+
+namespace bench
+{
+    using workload::splitmix64;
+
+    static zmap_hash_t hash_u64(uint64_t k, uint32_t seed)
+    {
+        return ZMAP_HASH_SCALAR(k, seed);
+    }
+
+    static int cmp_u64(uint64_t a, uint64_t b)
+    {
+        return (a == b) ? 0 : 1;
+    }
+
+    template <typename V> V make_val(uint64_t i);
+
+    template <> uint64_t make_val<uint64_t>(uint64_t i)
+    {
+        return i;
+    }
+
+    template <> Blob64 make_val<Blob64>(uint64_t i)
+    {
+        Blob64 b;
+        for (size_t w = 0; w < 8; w++)
+        {
+            b.w[w] = i + w;
+        }
+        return b;
+    }
+
+    // Typed entry points of the two registered zmap shapes.
+    template <typename V> struct zmap_api;
+
+    template <> struct zmap_api<uint64_t>
+    {
+        using map = zmap_U64;
+        using stable = zmap_stable_U64;
+        static constexpr auto init = zmap_init_ext_U64;
+        static constexpr auto put = zmap_put_U64;
+        static constexpr auto usage = zmap_memory_usage_U64;
+        static constexpr auto init_stable = zmap_init_ext_stable_U64;
+        static constexpr auto put_stable = zmap_put_stable_U64;
+        static constexpr auto usage_stable = zmap_memory_usage_stable_U64;
+    };
+
+    template <> struct zmap_api<Blob64>
+    {
+        using map = zmap_U64Blob;
+        using stable = zmap_stable_U64Blob;
+        static constexpr auto init = zmap_init_ext_U64Blob;
+        static constexpr auto put = zmap_put_U64Blob;
+        static constexpr auto usage = zmap_memory_usage_U64Blob;
+        static constexpr auto init_stable = zmap_init_ext_stable_U64Blob;
+        static constexpr auto put_stable = zmap_put_stable_U64Blob;
+        static constexpr auto usage_stable = zmap_memory_usage_stable_U64Blob;
+    };
+
+    template <typename V>
+    struct ut_node
+    {
+        uint64_t key;
+        V value;
+        UT_hash_handle hh;
+    };
+
+    struct options
+    {
+        const char *format = "both";
+        const char *out = "benchmark_memory";
+        size_t max_n = 10000000;
+    };
+
+    // What a child sends back through its pipe.
+    struct sample
+    {
+        size_t reported;
+        size_t rss;
+        size_t peak_rss;
+        bool ok;
+    };
+
+    struct record
+    {
+        std::string container;
+        std::string value;
+        std::string load;
+        size_t n;
+        sample s;
+    };
+
+    // Current resident set in bytes, from /proc; 0 where that is unavailable.
+    static size_t resident_bytes()
+    {
+        FILE *f = std::fopen("/proc/self/statm", "r");
+        if (!f)
+        {
+            return 0;
+        }
+        unsigned long pages = 0;
+        unsigned long resident = 0;
+        int got = std::fscanf(f, "%lu %lu", &pages, &resident);
+        std::fclose(f);
+        return (2 == got) ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+    }
+
+    static size_t peak_resident_bytes()
+    {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+        return (size_t)ru.ru_maxrss;
+#else
+        return (size_t)ru.ru_maxrss * 1024;
+#endif
+    }
+
+    // Builds one container in the child and returns what it reports. The
+    // container is deliberately leaked: the child exits right after.
+    template <typename V>
+    static size_t build(const std::string &container, float load, size_t n)
+    {
+        using api = zmap_api<V>;
+        if ("zmap" == container)
+        {
+            typename api::map *m = new typename api::map(api::init(hash_u64, cmp_u64, load));
+            for (size_t i = 0; i < n; i++)
+            {
+                api::put(m, splitmix64(i), make_val<V>(i));
+            }
+            return api::usage(m);
+        }
+        if ("zmap_stable" == container || "zmap_stable_arena" == container)
+        {
+            typename api::stable *m = new typename api::stable(api::init_stable(hash_u64, cmp_u64, load));
+            m->arena.enabled = ("zmap_stable_arena" == container);
+            for (size_t i = 0; i < n; i++)
+            {
+                api::put_stable(m, splitmix64(i), make_val<V>(i));
+            }
+            return api::usage_stable(m);
+        }
+        if ("uthash" == container)
+        {
+            ut_node<V> *head = NULL;
+            for (size_t i = 0; i < n; i++)
+            {
+                ut_node<V> *e = (ut_node<V>*)std::malloc(sizeof(ut_node<V>));
+                e->key = splitmix64(i);
+                e->value = make_val<V>(i);
+                HASH_ADD(hh, head, key, sizeof(uint64_t), e);
+            }
+            return HASH_OVERHEAD(hh, head) + n * (sizeof(ut_node<V>) - sizeof(UT_hash_handle));
+        }
+        // std::unordered_map does not report its size; estimate one node (next
+        // pointer plus the pair) per entry and one pointer per bucket.
+        auto *m = new std::unordered_map<uint64_t, V>();
+        for (size_t i = 0; i < n; i++)
+        {
+            (*m)[splitmix64(i)] = make_val<V>(i);
+        }
+        return sizeof(*m) + m->size() * (sizeof(void*) + sizeof(std::pair<const uint64_t, V>))
+               + m->bucket_count() * sizeof(void*);
+    }
+
+    template <typename V>
+    static sample measure(const std::string &container, float load, size_t n)
+    {
+        sample s = { 0, 0, 0, false };
+        int fds[2];
+        if (0 != pipe(fds))
+        {
+            return s;
+        }
+        pid_t pid = fork();
+        if (0 == pid)
+        {
+            close(fds[0]);
+            // The peak is taken against the starting resident set: a forked
+            // child inherits the parent's high-water mark.
+            size_t rss0 = resident_bytes();
+            sample r;
+            r.reported = build<V>(container, load, n);
+            size_t rss1 = resident_bytes();
+            size_t peak1 = std::max(peak_resident_bytes(), rss1);
+            r.rss = (rss1 > rss0) ? rss1 - rss0 : 0;
+            r.peak_rss = (peak1 > rss0) ? peak1 - rss0 : 0;
+            r.ok = true;
+            ssize_t w = write(fds[1], &r, sizeof(r));
+            _exit((w == (ssize_t)sizeof(r)) ? 0 : 1);
+        }
+        close(fds[1]);
+        if (pid > 0)
+        {
+            if (read(fds[0], &s, sizeof(s)) != (ssize_t)sizeof(s))
+            {
+                s.ok = false;
+            }
+            waitpid(pid, NULL, 0);
+        }
+        close(fds[0]);
+        return s;
+    }
+
+    static const float loads[] = { 0.50f, 0.70f, 0.85f, 0.95f };
+
+    // 1-2-5 steps per decade: capacities are powers of two, so the same load
+    // factor leaves tables anywhere from half to fully used depending on n.
+    static std::vector<size_t> sizes(size_t max_n)
+    {
+        std::vector<size_t> out;
+        for (size_t decade = 10000; decade <= max_n; decade *= 10)
+        {
+            for (size_t step : { 1, 2, 5 })
+            {
+                if (decade * step <= max_n)
+                {
+                    out.push_back(decade * step);
+                }
+            }
+        }
+        return out;
+    }
+
+    template <typename V>
+    static void run_value(const char *value_name, const options &opt, std::vector<record> &rs)
+    {
+        for (size_t n : sizes(opt.max_n))
+        {
+            for (const char *c : { "zmap", "zmap_stable", "zmap_stable_arena" })
+            {
+                for (float lf : loads)
+                {
+                    char label[16];
+                    std::snprintf(label, sizeof(label), "%.2f", lf);
+                    rs.push_back(record{ c, value_name, label, n, measure<V>(c, lf, n) });
+                }
+            }
+            for (const char *c : { "uthash", "std::unordered_map" })
+            {
+                rs.push_back(record{ c, value_name, "default", n, measure<V>(c, 0, n) });
+            }
+            std::fprintf(stderr, "  %-8s n=%zu\n", value_name, n);
+        }
+    }
+
+    static double per_entry(size_t bytes, size_t n)
+    {
+        return (double)bytes / (double)n;
+    }
+
+    static bool write_json(const std::string &path, const std::vector<record> &rs)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        std::fprintf(f, "{\n  \"suite\": \"zmap-memory\",\n  \"compiler\": \"%s\",\n  \"results\": [\n", __VERSION__);
+        for (size_t i = 0; i < rs.size(); i++)
+        {
+            const record &r = rs[i];
+            std::fprintf(f, "    {\"container\": \"%s\", \"value\": \"%s\", \"load\": \"%s\", \"n\": %zu, "
+                            "\"reported_bytes\": %zu, \"reported_per_entry\": %.2f, \"rss_bytes\": %zu, "
+                            "\"rss_per_entry\": %.2f, \"peak_rss_bytes\": %zu, \"ok\": %s}%s\n",
+                         r.container.c_str(), r.value.c_str(), r.load.c_str(), r.n, r.s.reported,
+                         per_entry(r.s.reported, r.n), r.s.rss, per_entry(r.s.rss, r.n), r.s.peak_rss,
+                         r.s.ok ? "true" : "false", (i + 1 < rs.size()) ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+        return 0 == std::fclose(f);
+    }
+
+    static bool write_csv(const std::string &path, const std::vector<record> &rs)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        std::fprintf(f, "container,value,load,n,reported_bytes,reported_per_entry,rss_bytes,rss_per_entry,"
+                        "peak_rss_bytes,ok\n");
+        for (const record &r : rs)
+        {
+            std::fprintf(f, "%s,%s,%s,%zu,%zu,%.2f,%zu,%.2f,%zu,%d\n",
+                         r.container.c_str(), r.value.c_str(), r.load.c_str(), r.n, r.s.reported,
+                         per_entry(r.s.reported, r.n), r.s.rss, per_entry(r.s.rss, r.n), r.s.peak_rss, r.s.ok);
+        }
+        return 0 == std::fclose(f);
+    }
+
+    // Bytes per entry at the largest size, one row per configuration.
+    static void print_summary(const std::vector<record> &rs)
+    {
+        size_t top = 0;
+        for (const record &r : rs)
+        {
+            top = std::max(top, r.n);
+        }
+        std::printf("\n%-20s %-8s %-8s %14s %12s %14s\n", "container", "value", "load", "reported B/e", "rss B/e",
+                    "peak rss MB");
+        for (const record &r : rs)
+        {
+            if (r.n == top)
+            {
+                std::printf("%-20s %-8s %-8s %14.1f %12.1f %14.1f\n", r.container.c_str(), r.value.c_str(),
+                            r.load.c_str(), per_entry(r.s.reported, r.n), per_entry(r.s.rss, r.n),
+                            (double)r.s.peak_rss / (1024.0 * 1024.0));
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench::options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (0 == std::strcmp(a, "--quick"))
+        {
+            opt.max_n = 1000000;
+        }
+        else if (v && 0 == std::strcmp(a, "--max-n"))
+        {
+            opt.max_n = std::max<size_t>(10000, (size_t)std::strtoull(v, NULL, 10));
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--format"))
+        {
+            opt.format = v;
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--out"))
+        {
+            opt.out = v;
+            i++;
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--format json|csv|both] [--out PREFIX] [--max-n N] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::string fmt = opt.format;
+    std::string out = opt.out;
+    bool json = ("json" == fmt || "both" == fmt);
+    bool csv = ("csv" == fmt || "both" == fmt);
+
+    std::vector<bench::record> rs;
+    std::fprintf(stderr, "=> Running memory benchmark (up to %zu entries)...\n", opt.max_n);
+    bench::run_value<uint64_t>("int", opt, rs);
+    bench::run_value<Blob64>("value64", opt, rs);
+    bench::print_summary(rs);
+
+    bool ok = (!json || bench::write_json(out + ".json", rs));
+    ok = (!csv || bench::write_csv(out + ".csv", rs)) && ok;
+    if (json)
+    {
+        std::fprintf(stderr, "=> Wrote %s.json\n", out.c_str());
+    }
+    if (csv)
+    {
+        std::fprintf(stderr, "=> Wrote %s.csv\n", out.c_str());
+    }
+    return ok ? 0 : 1;
+}
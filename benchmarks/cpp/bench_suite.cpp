@@ -0,0 +1,1027 @@
+
+/*
+ * bench_suite.cpp — zmap against std::unordered_map and absl::flat_hash_map.
+ *
+ * Key shapes: 64-bit integers, heap-allocated strings, 32-byte keys and
+ * integer keys with 256-byte values. Table sizes are derived from the
+ * machine's cache sizes, from L1-resident up to 10x L3. Operations: insert,
+ * lookup hit, lookup miss, mixed read/write, iteration, erase and clear.
+ *
+ * Results are written as JSON and/or CSV (one record per key, map, size and
+ * operation) so runs can be diffed and tracked for regressions. A build
+ * without absl lists it under "missing_baselines" in the JSON and in a
+ * leading "# missing baselines" line of the CSV.
+ *
+ * --latency switches to per-operation timing: every insert, hit, miss and
+ * erase is timed on its own (rdtsc on x86) into a log-linear histogram, and
+ * p50/p99/p99.9/max are reported at several fill levels. Means hide resize
+ * stalls and long probe chains; the tail percentiles and max show them.
+ *
+ * --workload picks the keys and the lookup stream (see workloads.hpp):
+ * uniform, sequential, strided, clustered timestamps, Zipf-skewed lookups,
+ * shared-prefix keys, or a key trace replayed from a file.
+ *
+ * Usage: bench_suite [--format json|csv|both] [--out PREFIX] [--reps N]
+ *                    [--min-ops N] [--max-mb N] [--quick] [--workload NAME[:PARAM]]
+ *                    [--latency [--slots N] [--samples N]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#endif
+
+#ifdef BENCH_HAVE_ABSL
+#   include <absl/container/flat_hash_map.h>
+#endif
+
+struct Key32
+{
+    uint64_t w[4];
+
+    bool operator==(const Key32 &o) const
+    {
+        return 0 == std::memcmp(w, o.w, sizeof(w));
+    }
+};
+
+struct Blob256
+{
+    uint64_t w[32];
+};
+
+// Each shape uses the registration the README recommends for it: scalar keys
+// with the hash baked in, large keys by reference so lookups do not copy them.
+#define REGISTER_ZMAP_INLINE_TYPES(X)                                      \
+    X(uint64_t, uint64_t, U64, ZMAP_HASH_SCALAR, ZMAP_EQ_SCALAR)           \
+    X(uint64_t, Blob256, U64Blob, ZMAP_HASH_SCALAR, ZMAP_EQ_SCALAR)
+
+#define REGISTER_ZMAP_REF_TYPES(X)                                         \
+    X(std::string, uint64_t, Str)                                          \
+    X(Key32, uint64_t, K32)
+
+#include "zmap.h"
+#include "workloads.hpp"
+
+namespace bench
+{
+    // All maps hash with the same function, so only the table designs differ.
+    template <typename K>
+    struct zhasher
+    {
+        zmap_hash_t operator()(const K &k, uint32_t s) const
+        {
+            return ZMAP_HASH_SCALAR(k, s);
+        }
+    };
+
+    template <>
+    struct zhasher<std::string>
+    {
+        zmap_hash_t operator()(const std::string &k, uint32_t s) const
+        {
+            return ZMAP_HASH_FUNC(k.data(), k.size(), s);
+        }
+    };
+
+    template <typename K>
+    struct hasher
+    {
+        size_t operator()(const K &k) const
+        {
+            return (size_t)ZMAP_HASH_SCALAR(k, 0xCAFEBABE);
+        }
+    };
+
+    template <>
+    struct hasher<std::string>
+    {
+        size_t operator()(const std::string &k) const
+        {
+            return (size_t)ZMAP_HASH_FUNC(k.data(), k.size(), 0xCAFEBABE);
+        }
+    };
+
+    using workload::splitmix64;
+
+    // Key of a workload ID; distinct IDs give distinct keys.
+    template <typename K> K make_key(const workload::spec &w, uint64_t id);
+
+    template <> uint64_t make_key<uint64_t>(const workload::spec &w, uint64_t id)
+    {
+        return w.int_key(id);
+    }
+
+    template <> std::string make_key<std::string>(const workload::spec &w, uint64_t id)
+    {
+        return w.string_key(id);
+    }
+
+    template <> Key32 make_key<Key32>(const workload::spec &w, uint64_t id)
+    {
+        Key32 k;
+        w.wide_key(id, k.w, 4);
+        return k;
+    }
+
+    template <typename K> K key_from_line(const std::string &line);
+
+    template <> uint64_t key_from_line<uint64_t>(const std::string &line)
+    {
+        return workload::int_from_line(line);
+    }
+
+    template <> std::string key_from_line<std::string>(const std::string &line)
+    {
+        return line;
+    }
+
+    template <> Key32 key_from_line<Key32>(const std::string &line)
+    {
+        Key32 k;
+        workload::wide_from_line(line, k.w, 4);
+        return k;
+    }
+
+    template <typename V> V make_val(uint64_t i);
+
+    template <> uint64_t make_val<uint64_t>(uint64_t i)
+    {
+        return i;
+    }
+
+    template <> Blob256 make_val<Blob256>(uint64_t i)
+    {
+        Blob256 b;
+        for (size_t w = 0; w < 32; w++)
+        {
+            b.w[w] = i + w;
+        }
+        return b;
+    }
+
+    static uint64_t first_word(uint64_t v)
+    {
+        return v;
+    }
+
+    static uint64_t first_word(const Blob256 &b)
+    {
+        return b.w[0];
+    }
+
+    // Uniform adapters: insert, find (returns a value word or 0), erase, for_each, clear.
+    template <typename K, typename V>
+    struct zmap_type
+    {
+        using type = z_map::map<K, V>;
+    };
+
+    template <>
+    struct zmap_type<std::string, uint64_t>
+    {
+        using type = z_map::map<std::string, uint64_t, zhasher<std::string>, std::equal_to<std::string>>;
+    };
+
+    template <>
+    struct zmap_type<Key32, uint64_t>
+    {
+        using type = z_map::map<Key32, uint64_t, zhasher<Key32>, std::equal_to<Key32>>;
+    };
+
+    template <typename K, typename V>
+    struct zmap_adapter
+    {
+        static const char *name() { return "zmap"; }
+
+        typename zmap_type<K, V>::type m;
+
+        void reserve(size_t n) { m.reserve(n); }
+        void insert(const K &k, const V &v) { m.put(k, v); }
+        uint64_t find(const K &k) { const V *v = m.get(k); return v ? first_word(*v) + 1 : 0; }
+        void erase(const K &k) { m.erase(k); }
+        void clear() { m.clear(); }
+        size_t size() const { return m.size(); }
+
+        uint64_t sum()
+        {
+            uint64_t s = 0;
+            for (auto &b : m)
+            {
+                s += first_word(b.value);
+            }
+            return s;
+        }
+    };
+
+    template <typename K, typename V>
+    struct std_adapter
+    {
+        static const char *name() { return "std::unordered_map"; }
+
+        std::unordered_map<K, V, hasher<K>> m;
+
+        void reserve(size_t n) { m.reserve(n); }
+        void insert(const K &k, const V &v) { m[k] = v; }
+        uint64_t find(const K &k) { auto it = m.find(k); return (it != m.end()) ? first_word(it->second) + 1 : 0; }
+        void erase(const K &k) { m.erase(k); }
+        void clear() { m.clear(); }
+        size_t size() const { return m.size(); }
+
+        uint64_t sum()
+        {
+            uint64_t s = 0;
+            for (auto &kv : m)
+            {
+                s += first_word(kv.second);
+            }
+            return s;
+        }
+    };
+
+#ifdef BENCH_HAVE_ABSL
+    template <typename K, typename V>
+    struct absl_adapter
+    {
+        static const char *name() { return "absl::flat_hash_map"; }
+
+        absl::flat_hash_map<K, V, hasher<K>> m;
+
+        void reserve(size_t n) { m.reserve(n); }
+        void insert(const K &k, const V &v) { m[k] = v; }
+        uint64_t find(const K &k) { auto it = m.find(k); return (it != m.end()) ? first_word(it->second) + 1 : 0; }
+        void erase(const K &k) { m.erase(k); }
+        void clear() { m.clear(); }
+        size_t size() const { return m.size(); }
+
+        uint64_t sum()
+        {
+            uint64_t s = 0;
+            for (auto &kv : m)
+            {
+                s += first_word(kv.second);
+            }
+            return s;
+        }
+    };
+#endif
+
+    struct options
+    {
+        const char *format = "both";
+        const char *out = "benchmark_results";
+        int reps = 3;
+        size_t min_ops = 1u << 20;
+        size_t max_mb = 0;      // 0 = no cap.
+        bool latency = false;
+        size_t slots = 1u << 20;    // Latency mode: table capacity the fill levels refer to.
+        size_t samples = 1u << 18;  // Latency mode: timed hits, misses and erases per fill level.
+        workload::spec workload;
+        std::vector<std::string> trace;     // Lines of the trace file, for trace workloads.
+    };
+
+    struct record
+    {
+        std::string workload;
+        std::string key;
+        std::string map;
+        std::string op;
+        size_t n;
+        std::string tier;
+        double ns_per_op;
+        size_t ops;
+    };
+
+    struct tier
+    {
+        const char *name;
+        size_t bytes;
+    };
+
+    static volatile uint64_t sink;
+
+    static double now_ns()
+    {
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    static size_t cache_size(int name, size_t fallback)
+    {
+        long v = sysconf(name);
+        return (v > 0) ? (size_t)v : fallback;
+    }
+#endif
+
+    // Working-set sizes from L1-resident to 10x L3.
+    static std::vector<tier> tiers(const options &opt)
+    {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        size_t l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 32u << 10);
+        size_t l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 1u << 20);
+        size_t l3 = cache_size(_SC_LEVEL3_CACHE_SIZE, 32u << 20);
+#else
+        size_t l1 = 32u << 10, l2 = 1u << 20, l3 = 32u << 20;
+#endif
+        std::vector<tier> all = {
+            { "L1", l1 / 2 }, { "L2", l2 / 2 }, { "L3", l3 / 2 }, { "2xL3", l3 * 2 }, { "10xL3", l3 * 10 }
+        };
+        std::vector<tier> out;
+        for (const tier &t : all)
+        {
+            if (0 == opt.max_mb || t.bytes <= (opt.max_mb << 20))
+            {
+                out.push_back(t);
+            }
+        }
+        return out;
+    }
+
+    template <typename K, typename V>
+    static size_t entry_bytes()
+    {
+        // Strings above are past the small-string buffer, so count their heap block too.
+        return sizeof(K) + sizeof(V) + (std::is_same<K, std::string>::value ? 32 : 0);
+    }
+
+    // Keys to insert, absent keys for misses, and the order of lookups.
+    template <typename K, typename V>
+    struct dataset
+    {
+        std::vector<K> keys;
+        std::vector<K> misses;
+        std::vector<V> vals;
+        std::vector<uint32_t> access;   // Key indices to look up; empty means insertion order.
+
+        size_t lookups() const
+        {
+            return access.empty() ? keys.size() : access.size();
+        }
+
+        size_t lookup(size_t i) const
+        {
+            return access.empty() ? i : access[i];
+        }
+
+        // Index of the j-th random lookup among the first `limit` keys.
+        size_t pick(size_t j, size_t limit) const
+        {
+            if (access.empty())
+            {
+                return (size_t)(splitmix64(j) % limit);
+            }
+            size_t idx = access[j % access.size()];
+            return (idx < limit) ? idx : idx % limit;
+        }
+    };
+
+    // n keys of the workload, or the distinct keys of its trace (n is then ignored).
+    template <typename K, typename V>
+    static dataset<K, V> make_dataset(const options &opt, size_t n)
+    {
+        const workload::spec &w = opt.workload;
+        dataset<K, V> d;
+        if (workload::TRACE == w.k)
+        {
+            std::unordered_map<K, uint32_t, hasher<K>> index;
+            d.access.reserve(opt.trace.size());
+            for (const std::string &line : opt.trace)
+            {
+                auto r = index.emplace(key_from_line<K>(line), (uint32_t)d.keys.size());
+                if (r.second)
+                {
+                    d.keys.push_back(r.first->first);
+                }
+                d.access.push_back(r.first->second);
+            }
+            // Misses are generated keys, skipping any that the trace happens to contain.
+            for (uint64_t i = 0; d.misses.size() < d.keys.size(); i++)
+            {
+                K k = make_key<K>(w, splitmix64(i));
+                if (0 == index.count(k))
+                {
+                    d.misses.push_back(k);
+                }
+            }
+        }
+        else
+        {
+            d.keys.reserve(n);
+            d.misses.reserve(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                d.keys.push_back(make_key<K>(w, w.id(i)));
+                d.misses.push_back(make_key<K>(w, w.id(i + n)));
+            }
+            if (workload::ZIPF == w.k)
+            {
+                d.access = workload::zipf_access(n, n, w.param, 0x21BF);
+            }
+        }
+        d.vals.reserve(d.keys.size());
+        for (size_t i = 0; i < d.keys.size(); i++)
+        {
+            d.vals.push_back(make_val<V>(i));
+        }
+        return d;
+    }
+
+    static void keep_min(std::vector<record> &rs, size_t at, double elapsed_ns, size_t ops)
+    {
+        rs[at].ops = ops;
+        rs[at].ns_per_op = std::min(rs[at].ns_per_op, elapsed_ns / (double)ops);
+    }
+
+    // One repetition of every operation on a fresh map. Results go into rs[base..base+7).
+    template <typename Map, typename K, typename V>
+    static void run_once(const dataset<K, V> &d, const options &opt, std::vector<record> &rs, size_t base)
+    {
+        const std::vector<K> &keys = d.keys;
+        const std::vector<K> &misses = d.misses;
+        const std::vector<V> &vals = d.vals;
+        const size_t n = keys.size();
+        const size_t hits = d.lookups();
+        const size_t passes = std::max<size_t>(1, opt.min_ops / n);
+        Map *map = new Map();
+        uint64_t acc = 0;
+
+        double t = now_ns();
+        for (size_t i = 0; i < n; i++)
+        {
+            map->insert(keys[i], vals[i]);
+        }
+        keep_min(rs, base + 0, now_ns() - t, n);
+
+        const size_t hit_passes = std::max<size_t>(1, opt.min_ops / hits);
+        t = now_ns();
+        for (size_t p = 0; p < hit_passes; p++)
+        {
+            for (size_t i = 0; i < hits; i++)
+            {
+                acc += map->find(keys[d.lookup(i)]);
+            }
+        }
+        keep_min(rs, base + 1, now_ns() - t, hits * hit_passes);
+
+        t = now_ns();
+        for (size_t p = 0; p < passes; p++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                acc += map->find(misses[i]);
+            }
+        }
+        keep_min(rs, base + 2, now_ns() - t, n * passes);
+
+        // Mixed: per 10 iterations, 9 lookups plus an erase and re-insert of one key,
+        // counted as 11 operations (about 82% lookups).
+        size_t mixed = n * passes;
+        t = now_ns();
+        for (size_t i = 0; i < mixed; i++)
+        {
+            size_t idx = d.pick(i, n);
+            if (9 == i % 10)
+            {
+                map->erase(keys[idx]);
+                map->insert(keys[idx], vals[idx]);
+            }
+            else
+            {
+                acc += map->find(keys[idx]);
+            }
+        }
+        keep_min(rs, base + 3, now_ns() - t, mixed + mixed / 10);
+
+        t = now_ns();
+        for (size_t p = 0; p < passes; p++)
+        {
+            acc += map->sum();
+        }
+        keep_min(rs, base + 4, now_ns() - t, n * passes);
+
+        t = now_ns();
+        for (size_t i = 0; i < n; i++)
+        {
+            map->erase(keys[i]);
+        }
+        keep_min(rs, base + 5, now_ns() - t, n);
+        acc += map->size();
+
+        // Clear is timed on a refilled table and reported per element.
+        for (size_t i = 0; i < n; i++)
+        {
+            map->insert(keys[i], vals[i]);
+        }
+        t = now_ns();
+        map->clear();
+        keep_min(rs, base + 6, now_ns() - t, n);
+
+        delete map;
+        sink = sink + acc;
+    }
+
+    static const char *const ops[] = { "insert", "hit", "miss", "mixed", "iterate", "erase", "clear" };
+
+    template <typename Map, typename K, typename V>
+    static void run_map(const char *key_name, const tier &tr, const dataset<K, V> &d, const options &opt,
+                        std::vector<record> &rs)
+    {
+        size_t base = rs.size();
+        for (const char *op : ops)
+        {
+            rs.push_back(record{ opt.workload.label, key_name, Map::name(), op, d.keys.size(), tr.name, 1e300, 0 });
+        }
+        std::fprintf(stderr, "  %-6s %-22s %-6s n=%zu\n", key_name, Map::name(), tr.name, d.keys.size());
+        for (int r = 0; r < opt.reps; r++)
+        {
+            run_once<Map, K, V>(d, opt, rs, base);
+        }
+    }
+
+    template <typename K, typename V>
+    static void run_shape(const char *key_name, const options &opt, std::vector<record> &rs)
+    {
+        // A trace fixes the key set, so it runs once at its own size.
+        std::vector<tier> trs = (workload::TRACE == opt.workload.k) ? std::vector<tier>{ { "trace", 0 } } : tiers(opt);
+        for (const tier &tr : trs)
+        {
+            dataset<K, V> d = make_dataset<K, V>(opt, std::max<size_t>(64, tr.bytes / entry_bytes<K, V>()));
+            if (d.keys.empty())
+            {
+                continue;
+            }
+            run_map<zmap_adapter<K, V>>(key_name, tr, d, opt, rs);
+            run_map<std_adapter<K, V>>(key_name, tr, d, opt, rs);
+#ifdef BENCH_HAVE_ABSL
+            run_map<absl_adapter<K, V>>(key_name, tr, d, opt, rs);
+#endif
+        }
+    }
+
+    // Timestamps for single operations: serialized rdtsc on x86, steady_clock elsewhere.
+    struct stamp_clock
+    {
+        double ns_per_tick;
+        uint64_t overhead;      // Cost of an empty start/stop pair, subtracted from samples.
+
+        static uint64_t ticks()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_lfence();
+            uint64_t t = __rdtsc();
+            _mm_lfence();
+            return t;
+#else
+            return (uint64_t)now_ns();
+#endif
+        }
+
+        stamp_clock()
+        {
+            double ns0 = now_ns();
+            uint64_t t0 = ticks();
+            while (now_ns() - ns0 < 20e6)
+            {
+            }
+            ns_per_tick = (now_ns() - ns0) / (double)(ticks() - t0);
+            overhead = UINT64_MAX;
+            for (int i = 0; i < 1000; i++)
+            {
+                uint64_t a = ticks();
+                overhead = std::min(overhead, ticks() - a);
+            }
+        }
+
+        uint64_t since(uint64_t start) const
+        {
+            uint64_t d = ticks() - start;
+            return (d > overhead) ? d - overhead : 0;
+        }
+    };
+
+    // HDR-style log-linear histogram: 16 sub-buckets per power of two (at most
+    // 1/16 relative error) over the full 64-bit range, plus the exact max.
+    struct latency_histogram
+    {
+        static const int sub_bits = 4;
+
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t max = 0;
+        double sum = 0;
+
+        latency_histogram() : counts((size_t)64 << sub_bits, 0) {}
+
+        static size_t index(uint64_t v)
+        {
+            if (v < (1u << sub_bits))
+            {
+                return (size_t)v;
+            }
+            int shift = 63 - __builtin_clzll(v) - sub_bits;
+            return ((size_t)(shift + 1) << sub_bits) + (size_t)((v >> shift) & ((1u << sub_bits) - 1));
+        }
+
+        // Highest value that lands in bucket i.
+        static uint64_t upper(size_t i)
+        {
+            if (i < (1u << sub_bits))
+            {
+                return i;
+            }
+            int shift = (int)(i >> sub_bits) - 1;
+            uint64_t top = (1u << sub_bits) + (i & ((1u << sub_bits) - 1));
+            return ((top + 1) << shift) - 1;
+        }
+
+        void add(uint64_t v)
+        {
+            counts[index(v)]++;
+            total++;
+            sum += (double)v;
+            max = std::max(max, v);
+        }
+
+        uint64_t percentile(double p) const
+        {
+            uint64_t target = std::max<uint64_t>(1, (uint64_t)(p * (double)total + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < counts.size(); i++)
+            {
+                seen += counts[i];
+                if (seen >= target)
+                {
+                    return std::min(upper(i), max);
+                }
+            }
+            return max;
+        }
+    };
+
+    struct latency_record
+    {
+        std::string workload;
+        std::string key;
+        std::string map;
+        std::string op;
+        std::string fill;
+        size_t n;
+        uint64_t samples;
+        double mean_ns;
+        double p50_ns;
+        double p99_ns;
+        double p999_ns;
+        double max_ns;
+    };
+
+    static void add_latency(std::vector<latency_record> &ls, const options &opt, const char *key_name,
+                            const char *map_name, const char *op, const std::string &fill, size_t n,
+                            const latency_histogram &h, const stamp_clock &clk)
+    {
+        double k = clk.ns_per_tick;
+        ls.push_back(latency_record{ opt.workload.label, key_name, map_name, op, fill, n, h.total,
+                                     h.total ? h.sum / (double)h.total * k : 0, (double)h.percentile(0.50) * k,
+                                     (double)h.percentile(0.99) * k, (double)h.percentile(0.999) * k,
+                                     (double)h.max * k });
+    }
+
+    // Fill levels as a fraction of `slots`; the last one sits just under zmap's resize threshold.
+    static const double fills[] = { 0.25, 0.50, 0.75, 0.84 };
+
+    template <typename Map, typename K, typename V>
+    static void run_latency_map(const char *key_name, const dataset<K, V> &d, const options &opt,
+                                const stamp_clock &clk, std::vector<latency_record> &ls)
+    {
+        const std::vector<K> &keys = d.keys;
+        const std::vector<K> &misses = d.misses;
+        const std::vector<V> &vals = d.vals;
+        const size_t n = keys.size();
+        uint64_t acc = 0;
+        std::fprintf(stderr, "  %-6s %-22s slots=%zu\n", key_name, Map::name(), opt.slots);
+
+        // Growing from empty: every resize lands on one unlucky insert.
+        {
+            Map *map = new Map();
+            latency_histogram h;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t t = stamp_clock::ticks();
+                map->insert(keys[i], vals[i]);
+                h.add(clk.since(t));
+            }
+            add_latency(ls, opt, key_name, Map::name(), "insert_grow", "grow", n, h, clk);
+            delete map;
+        }
+
+        Map *map = new Map();
+        map->reserve(n);
+        size_t filled = 0;
+        for (double f : fills)
+        {
+            size_t target = std::min(n, (size_t)(f * (double)opt.slots));
+            char label[16];
+            std::snprintf(label, sizeof(label), "%d%%", (int)(f * 100.0 + 0.5));
+
+            latency_histogram ins;
+            for (; filled < target; filled++)
+            {
+                uint64_t t = stamp_clock::ticks();
+                map->insert(keys[filled], vals[filled]);
+                ins.add(clk.since(t));
+            }
+            add_latency(ls, opt, key_name, Map::name(), "insert", label, filled, ins, clk);
+
+            latency_histogram hit;
+            latency_histogram miss;
+            latency_histogram erase;
+            for (size_t j = 0; j < opt.samples; j++)
+            {
+                size_t idx = d.pick(j, filled);
+                uint64_t t = stamp_clock::ticks();
+                acc += map->find(keys[idx]);
+                hit.add(clk.since(t));
+
+                t = stamp_clock::ticks();
+                acc += map->find(misses[j % n]);
+                miss.add(clk.since(t));
+            }
+            // Each erased key is put back untimed so the fill level holds.
+            for (size_t j = 0; j < opt.samples; j++)
+            {
+                size_t idx = (size_t)(splitmix64(j + filled) % filled);
+                uint64_t t = stamp_clock::ticks();
+                map->erase(keys[idx]);
+                erase.add(clk.since(t));
+                map->insert(keys[idx], vals[idx]);
+            }
+            add_latency(ls, opt, key_name, Map::name(), "hit", label, filled, hit, clk);
+            add_latency(ls, opt, key_name, Map::name(), "miss", label, filled, miss, clk);
+            add_latency(ls, opt, key_name, Map::name(), "erase", label, filled, erase, clk);
+        }
+        acc += map->size();
+        delete map;
+        sink = sink + acc;
+    }
+
+    template <typename K, typename V>
+    static void run_latency(const char *key_name, const options &opt, const stamp_clock &clk,
+                            std::vector<latency_record> &ls)
+    {
+        size_t n = (size_t)(fills[sizeof(fills) / sizeof(fills[0]) - 1] * (double)opt.slots);
+        dataset<K, V> d = make_dataset<K, V>(opt, n);
+        // A trace larger than the top fill level is cut; lookups of cut keys fold onto kept ones.
+        if (d.keys.size() > n)
+        {
+            d.keys.resize(n);
+            d.misses.resize(n);
+            d.vals.resize(n);
+        }
+        if (d.keys.empty())
+        {
+            return;
+        }
+        run_latency_map<zmap_adapter<K, V>>(key_name, d, opt, clk, ls);
+        run_latency_map<std_adapter<K, V>>(key_name, d, opt, clk, ls);
+#ifdef BENCH_HAVE_ABSL
+        run_latency_map<absl_adapter<K, V>>(key_name, d, opt, clk, ls);
+#endif
+    }
+
+    // Baseline this build could not include, or "". Results without absl have
+    // no open-addressing baseline, and the output files say so.
+#ifdef BENCH_HAVE_ABSL
+    static const char *const missing_baseline = "";
+#else
+    static const char *const missing_baseline = "absl::flat_hash_map";
+#endif
+
+    static std::string missing_baselines_json()
+    {
+        return *missing_baseline ? std::string("[\"") + missing_baseline + "\"]" : std::string("[]");
+    }
+
+    static void write_csv_preamble(FILE *f)
+    {
+        if (*missing_baseline)
+        {
+            std::fprintf(f, "# missing baselines: %s\n", missing_baseline);
+        }
+    }
+
+    static bool write_latency_json(const std::string &path, const std::vector<latency_record> &ls)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        std::fprintf(f, "{\n  \"suite\": \"zmap-latency\",\n  \"compiler\": \"%s\",\n  \"missing_baselines\": %s,\n"
+                        "  \"results\": [\n", __VERSION__, missing_baselines_json().c_str());
+        for (size_t i = 0; i < ls.size(); i++)
+        {
+            const latency_record &r = ls[i];
+            std::fprintf(f, "    {\"workload\": \"%s\", \"key\": \"%s\", \"map\": \"%s\", \"op\": \"%s\", "
+                            "\"fill\": \"%s\", \"n\": %zu, \"samples\": %llu, \"mean_ns\": %.1f, \"p50_ns\": %.1f, "
+                            "\"p99_ns\": %.1f, \"p999_ns\": %.1f, \"max_ns\": %.1f}%s\n",
+                         r.workload.c_str(), r.key.c_str(), r.map.c_str(), r.op.c_str(), r.fill.c_str(), r.n,
+                         (unsigned long long)r.samples, r.mean_ns, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns,
+                         (i + 1 < ls.size()) ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+        return 0 == std::fclose(f);
+    }
+
+    static bool write_latency_csv(const std::string &path, const std::vector<latency_record> &ls)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        write_csv_preamble(f);
+        std::fprintf(f, "workload,key,map,op,fill,n,samples,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n");
+        for (const latency_record &r : ls)
+        {
+            std::fprintf(f, "%s,%s,%s,%s,%s,%zu,%llu,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                         r.workload.c_str(), r.key.c_str(), r.map.c_str(), r.op.c_str(), r.fill.c_str(), r.n,
+                         (unsigned long long)r.samples, r.mean_ns, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns);
+        }
+        return 0 == std::fclose(f);
+    }
+
+    static bool write_json(const std::string &path, const std::vector<record> &rs)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        std::fprintf(f, "{\n  \"suite\": \"zmap\",\n  \"compiler\": \"%s\",\n  \"missing_baselines\": %s,\n"
+                        "  \"results\": [\n", __VERSION__, missing_baselines_json().c_str());
+        for (size_t i = 0; i < rs.size(); i++)
+        {
+            const record &r = rs[i];
+            std::fprintf(f, "    {\"workload\": \"%s\", \"key\": \"%s\", \"map\": \"%s\", \"op\": \"%s\", "
+                            "\"tier\": \"%s\", \"n\": %zu, \"ops\": %zu, \"ns_per_op\": %.3f}%s\n",
+                         r.workload.c_str(), r.key.c_str(), r.map.c_str(), r.op.c_str(), r.tier.c_str(), r.n, r.ops, r.ns_per_op,
+                         (i + 1 < rs.size()) ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+        return 0 == std::fclose(f);
+    }
+
+    static bool write_csv(const std::string &path, const std::vector<record> &rs)
+    {
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return false;
+        }
+        write_csv_preamble(f);
+        std::fprintf(f, "workload,key,map,op,tier,n,ops,ns_per_op\n");
+        for (const record &r : rs)
+        {
+            std::fprintf(f, "%s,%s,%s,%s,%s,%zu,%zu,%.3f\n",
+                         r.workload.c_str(), r.key.c_str(), r.map.c_str(), r.op.c_str(), r.tier.c_str(), r.n, r.ops, r.ns_per_op);
+        }
+        return 0 == std::fclose(f);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench::options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (0 == std::strcmp(a, "--quick"))
+        {
+            opt.reps = 1;
+            opt.min_ops = 1u << 18;
+            opt.max_mb = 64;
+            opt.slots = 1u << 16;
+            opt.samples = 1u << 16;
+        }
+        else if (0 == std::strcmp(a, "--latency"))
+        {
+            opt.latency = true;
+        }
+        else if (v && 0 == std::strcmp(a, "--slots"))
+        {
+            opt.slots = zmap_next_pow2(std::max<size_t>(64, (size_t)std::strtoull(v, NULL, 10)));
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--samples"))
+        {
+            opt.samples = std::max<size_t>(1, (size_t)std::strtoull(v, NULL, 10));
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--workload"))
+        {
+            if (!opt.workload.parse(v))
+            {
+                std::fprintf(stderr, "unknown workload '%s' (uniform, sequential, strided[:S], clustered[:B], "
+                                     "zipf[:S], prefix[:L], trace:FILE)\n", v);
+                return 1;
+            }
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--format"))
+        {
+            opt.format = v;
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--out"))
+        {
+            opt.out = v;
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--reps"))
+        {
+            opt.reps = std::max(1, std::atoi(v));
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--min-ops"))
+        {
+            opt.min_ops = (size_t)std::strtoull(v, NULL, 10);
+            i++;
+        }
+        else if (v && 0 == std::strcmp(a, "--max-mb"))
+        {
+            opt.max_mb = (size_t)std::strtoull(v, NULL, 10);
+            i++;
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--format json|csv|both] [--out PREFIX] [--reps N] "
+                                 "[--min-ops N] [--max-mb N] [--quick] [--workload NAME[:PARAM]] "
+                                 "[--latency [--slots N] [--samples N]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (workload::TRACE == opt.workload.k)
+    {
+        if (!workload::read_trace(opt.workload.path, opt.trace) || opt.trace.empty())
+        {
+            std::fprintf(stderr, "cannot read keys from trace '%s'\n", opt.workload.path.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "=> Replaying %zu keys from %s\n", opt.trace.size(), opt.workload.path.c_str());
+    }
+#ifndef BENCH_HAVE_ABSL
+    std::fprintf(stderr, "=> WARNING: absl not found; the open-addressing baseline is skipped and recorded as missing.\n");
+#endif
+
+    std::string fmt = opt.format;
+    std::string out = opt.out;
+    bool json = ("json" == fmt || "both" == fmt);
+    bool csv = ("csv" == fmt || "both" == fmt);
+    bool ok = true;
+
+    if (opt.latency)
+    {
+        bench::stamp_clock clk;
+        std::vector<bench::latency_record> ls;
+        std::fprintf(stderr, "=> Running latency benchmark (%s workload, %.3f ns/tick, %zu samples per fill level)...\n",
+                     opt.workload.label.c_str(), clk.ns_per_tick, opt.samples);
+        bench::run_latency<uint64_t, uint64_t>("int", opt, clk, ls);
+        bench::run_latency<std::string, uint64_t>("string", opt, clk, ls);
+        ok = (!json || bench::write_latency_json(out + ".json", ls)) && ok;
+        ok = (!csv || bench::write_latency_csv(out + ".csv", ls)) && ok;
+    }
+    else
+    {
+        std::vector<bench::record> rs;
+        std::fprintf(stderr, "=> Running benchmark suite (%s workload, %d reps, best of)...\n",
+                     opt.workload.label.c_str(), opt.reps);
+        bench::run_shape<uint64_t, uint64_t>("int", opt, rs);
+        bench::run_shape<std::string, uint64_t>("string", opt, rs);
+        bench::run_shape<Key32, uint64_t>("key32", opt, rs);
+        bench::run_shape<uint64_t, Blob256>("value256", opt, rs);
+        ok = (!json || bench::write_json(out + ".json", rs)) && ok;
+        ok = (!csv || bench::write_csv(out + ".csv", rs)) && ok;
+    }
+    if (json)
+    {
+        std::fprintf(stderr, "=> Wrote %s.json\n", out.c_str());
+    }
+    if (csv)
+    {
+        std::fprintf(stderr, "=> Wrote %s.csv\n", out.c_str());
+    }
+    return ok ? 0 : 1;
+}
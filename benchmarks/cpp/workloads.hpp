@@ -0,0 +1,377 @@
+
+/*
+ * workloads.hpp — key-set and access-stream generators for the benchmarks.
+ *
+ * Uniform random keys are the easy case for a hash table. Production streams
+ * are skewed (a few hot keys take most lookups), ordered (sequential IDs,
+ * timestamps arriving in bursts, fixed strides) or low in entropy (long
+ * shared prefixes, keys that differ only in their last bytes). These are the
+ * inputs that expose weak hashes and long Robin Hood clusters.
+ *
+ * A workload is named on the command line as NAME[:PARAM]:
+ *
+ *   uniform          Pseudo-random 64-bit IDs (the default).
+ *   sequential       IDs 0, 1, 2, ...
+ *   strided:S        IDs 0, S, 2S, ... (default S = 4096).
+ *   clustered:B      Microsecond timestamps in bursts of B consecutive
+ *                    values, one burst per ~1 s (default B = 64).
+ *   zipf:S           Uniform keys, lookups Zipf-distributed with exponent S
+ *                    (default 0.99).
+ *   prefix:L         Keys that share an L-byte prefix and differ only in the
+ *                    tail (default L = 32). Fixed-size keys keep all but the
+ *                    last 8 bytes constant, like keys hashed on a 4-byte prefix.
+ *   trace:FILE       Replay FILE, one key per line. The distinct keys form
+ *                    the key set and the lines, in order, the lookup stream.
+ *
+ * Generators are deterministic: the same workload and size give the same keys
+ * on every run and machine.
+ */
+
+#ifndef ZMAP_BENCH_WORKLOADS_HPP
+#define ZMAP_BENCH_WORKLOADS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace workload
+{
+    static inline uint64_t splitmix64(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // Counter-based generator: cheap, seedable, and good enough for sampling.
+    struct rng
+    {
+        uint64_t state;
+
+        explicit rng(uint64_t seed) : state(seed) {}
+
+        uint64_t next()
+        {
+            return splitmix64(state++);
+        }
+
+        // Uniform in [0, 1).
+        double unit()
+        {
+            return (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+    };
+
+    // Zipf(s) over ranks [0, n), by rejection-inversion (Hoermann and
+    // Derflinger, 1996): O(1) memory and about one draw per sample, so it
+    // works for any table size. Rank 0 is the most popular. Requires s > 0.
+    class zipf
+    {
+      public:
+        zipf(size_t n, double s, uint64_t seed) : n_((double)n), s_(s), rng_(seed)
+        {
+            h_x1_ = h_integral(1.5) - 1.0;
+            h_n_ = h_integral(n_ + 0.5);
+            cut_ = 2.0 - h_integral_inv(h_integral(2.5) - h(2.0));
+        }
+
+        size_t next()
+        {
+            for (;;)
+            {
+                double u = h_n_ + rng_.unit() * (h_x1_ - h_n_);
+                double x = h_integral_inv(u);
+                double k = std::floor(x + 0.5);
+                k = (k < 1.0) ? 1.0 : (k > n_) ? n_ : k;
+                if (k - x <= cut_ || u >= h_integral(k + 0.5) - h(k))
+                {
+                    return (size_t)k - 1;
+                }
+            }
+        }
+
+      private:
+        double n_;
+        double s_;
+        rng rng_;
+        double h_x1_;
+        double h_n_;
+        double cut_;
+
+        // log1p(x)/x and expm1(x)/x, with series near 0 where they lose precision.
+        static double log1p_div(double x)
+        {
+            return (std::fabs(x) > 1e-8) ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+        }
+
+        static double expm1_div(double x)
+        {
+            return (std::fabs(x) > 1e-8) ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+        }
+
+        double h(double x) const
+        {
+            return std::exp(-s_ * std::log(x));
+        }
+
+        // Integral of x^-s, continuous through s = 1.
+        double h_integral(double x) const
+        {
+            double lx = std::log(x);
+            return expm1_div((1.0 - s_) * lx) * lx;
+        }
+
+        double h_integral_inv(double x) const
+        {
+            double t = x * (1.0 - s_);
+            return std::exp(log1p_div((t < -1.0) ? -1.0 : t) * x);
+        }
+    };
+
+    // `count` Zipf(s) draws over n keys, as key indices. Ranks are scattered by
+    // a fixed permutation so the hot keys are not also the first inserted.
+    static inline std::vector<uint32_t> zipf_access(size_t n, size_t count, double s, uint64_t seed)
+    {
+        std::vector<uint32_t> perm(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            perm[i] = (uint32_t)i;
+        }
+        rng r(seed);
+        for (size_t i = n; i > 1; i--)
+        {
+            size_t j = (size_t)(r.next() % i);
+            uint32_t t = perm[i - 1];
+            perm[i - 1] = perm[j];
+            perm[j] = t;
+        }
+        zipf z(n, s, seed ^ 0x5A5A5A5A5A5A5A5Aull);
+        std::vector<uint32_t> out(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = perm[z.next()];
+        }
+        return out;
+    }
+
+    enum kind
+    {
+        UNIFORM,
+        SEQUENTIAL,
+        STRIDED,
+        CLUSTERED,
+        ZIPF,
+        PREFIX,
+        TRACE
+    };
+
+    struct spec
+    {
+        kind k = UNIFORM;
+        double param = 0;
+        std::string path;       // TRACE only.
+        std::string label = "uniform";
+
+        // Parses NAME[:PARAM]. Returns false for an unknown name or bad parameter.
+        bool parse(const char *text)
+        {
+            static const struct
+            {
+                const char *name;
+                kind k;
+                double param;
+            } table[] = {
+                { "uniform", UNIFORM, 0 },   { "sequential", SEQUENTIAL, 0 }, { "strided", STRIDED, 4096 },
+                { "clustered", CLUSTERED, 64 }, { "zipf", ZIPF, 0.99 },     { "prefix", PREFIX, 32 },
+                { "trace", TRACE, 0 }
+            };
+            std::string s = text;
+            size_t colon = s.find(':');
+            std::string name = s.substr(0, colon);
+            std::string arg = (colon == std::string::npos) ? "" : s.substr(colon + 1);
+            for (const auto &t : table)
+            {
+                if (name != t.name)
+                {
+                    continue;
+                }
+                k = t.k;
+                param = t.param;
+                label = s;
+                if (TRACE == k)
+                {
+                    path = arg;
+                    size_t slash = arg.find_last_of('/');
+                    label = "trace:" + ((slash == std::string::npos) ? arg : arg.substr(slash + 1));
+                    return !arg.empty();
+                }
+                if (!arg.empty())
+                {
+                    char *end = NULL;
+                    param = std::strtod(arg.c_str(), &end);
+                    if (*end || !(param > 0))
+                    {
+                        return false;
+                    }
+                }
+                if (CLUSTERED == k && param > (double)(1u << 20))
+                {
+                    return false;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        // ID of the i-th key. Distinct i give distinct IDs, so keys [0, n) and
+        // misses [n, 2n) never overlap.
+        uint64_t id(uint64_t i) const
+        {
+            switch (k)
+            {
+                case SEQUENTIAL:
+                case PREFIX:
+                    return i;
+                case STRIDED:
+                    return i * (uint64_t)param;
+                case CLUSTERED:
+                    return 1700000000000000ull + (i / (uint64_t)param) * (1ull << 20) + i % (uint64_t)param;
+                default:
+                    return splitmix64(i);
+            }
+        }
+
+        uint64_t int_key(uint64_t id) const
+        {
+            // Only the low bits vary; the top 16 are a constant tag.
+            return (PREFIX == k) ? (0xC0DEull << 48) | (id & 0xFFFFFFFFFFFFull) : id;
+        }
+
+        std::string string_key(uint64_t id) const
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)id);
+            if (PREFIX != k)
+            {
+                return std::string("key:") + buf;
+            }
+            static const char path_like[] = "tenant-0042/eu-west-1/sessions/";
+            std::string key;
+            for (size_t i = 0; i < (size_t)param; i++)
+            {
+                key += path_like[i % (sizeof(path_like) - 1)];
+            }
+            return key + buf;
+        }
+
+        // Fills a fixed-size key of `words` 64-bit words from an ID.
+        void wide_key(uint64_t id, uint64_t *w, size_t words) const
+        {
+            if (PREFIX == k)
+            {
+                for (size_t i = 0; i + 1 < words; i++)
+                {
+                    w[i] = 0x5EED5EED5EED5EEDull;
+                }
+                w[words - 1] = id;
+                return;
+            }
+            w[0] = id;
+            for (size_t i = 1; i < words; i++)
+            {
+                w[i] = splitmix64(w[i - 1]);
+            }
+        }
+    };
+
+    // Reads one key per line, dropping line endings and blank lines. Returns
+    // false if the file cannot be read.
+    static inline bool read_trace(const std::string &path, std::vector<std::string> &lines)
+    {
+        FILE *f = std::fopen(path.c_str(), "rb");
+        if (!f)
+        {
+            return false;
+        }
+        std::string line;
+        int c;
+        while ((c = std::fgetc(f)) != EOF)
+        {
+            if ('\n' != c)
+            {
+                line += (char)c;
+                continue;
+            }
+            if (!line.empty() && '\r' == line.back())
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                lines.push_back(line);
+            }
+            line.clear();
+        }
+        if (!line.empty())
+        {
+            lines.push_back(line);
+        }
+        bool ok = !std::ferror(f);
+        std::fclose(f);
+        return ok;
+    }
+
+    // FNV-1a, for trace lines that are not numbers.
+    static inline uint64_t fnv1a(const std::string &s)
+    {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (unsigned char c : s)
+        {
+            h = (h ^ c) * 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    // A trace line as an integer key: decimal, 0x-hex or octal, else its FNV-1a hash.
+    static inline uint64_t int_from_line(const std::string &line)
+    {
+        char *end = NULL;
+        unsigned long long v = std::strtoull(line.c_str(), &end, 0);
+        return (end != line.c_str() && 0 == *end) ? (uint64_t)v : fnv1a(line);
+    }
+
+    // A trace line as a fixed-size key: exactly 16 * words hex digits (a txid
+    // or digest) are decoded; anything else is copied and zero-padded. words <= 32.
+    static inline void wide_from_line(const std::string &line, uint64_t *w, size_t words)
+    {
+        size_t bytes = words * 8;
+        unsigned char buf[256] = { 0 };
+        bool hex = (line.size() == 2 * bytes && bytes <= sizeof(buf));
+        for (size_t i = 0; hex && i < line.size(); i++)
+        {
+            char c = line[i];
+            int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                  : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (d < 0)
+            {
+                hex = false;
+                break;
+            }
+            buf[i / 2] = (unsigned char)(buf[i / 2] | (d << ((i & 1) ? 0 : 4)));
+        }
+        if (!hex)
+        {
+            std::memset(buf, 0, sizeof(buf));
+            std::memcpy(buf, line.data(), std::min(line.size(), std::min(bytes, sizeof(buf))));
+        }
+        std::memcpy(w, buf, bytes);
+    }
+}
+
+#endif
@@ -1,23 +1,60 @@
 
 #include <iostream>
 #include <string>
+#include <stdexcept>
 #include <cassert>
+#include <thread>
+#include <vector>
 
-#define REGISTER_ZMAP_TYPES(X) \
-    X(int, int, IntInt)        \
+// Counts every construction, to show that hits build no value.
+struct Counted
+{
+    static int made;
+    int v;
+    Counted() : v(0) { made++; }
+    Counted(int x) : v(x) { made++; }
+};
+int Counted::made = 0;
+
+#define REGISTER_ZMAP_TYPES(X)      \
+    X(int, int, IntInt)             \
+    X(int, Counted, IntCounted)     \
     X(std::string, float, StrFloat)
 
+struct U64Hash
+{
+    uint32_t operator()(uint64_t k, uint32_t s) const { return (uint32_t)(k ^ (k >> 32)) ^ s; }
+};
+
+#define REGISTER_ZMAP_REF_TYPES(X) \
+    X(std::string, int, StrIntRef)
+
+#define REGISTER_STABLE_MAPS(X) \
+    X(int, std::string, IntStr)
+
+#define REGISTER_ZMAP_CONCURRENT_TYPES(X) \
+    X(std::string, int, StrIntConc)
+
+#define REGISTER_ZMAP_INLINE_TYPES(X) \
+    X(uint64_t, int, U64Int, U64Hash{}, ZMAP_EQ_SCALAR)
+
+#define REGISTER_ZSET_TYPES(X) \
+    X(std::string, StrSet)
+
 #include "zmap.h"
 
 #define TEST(name) printf("[TEST] %-40s", name);
 #define PASS() std::cout << "\033[0;32mPASS\033[0m\n";
 
-uint32_t hash_int(int k, uint32_t s) { return (uint32_t)k ^ s; }
+zmap_hash_t hash_int(int k, uint32_t s) { return (uint32_t)k ^ s; }
 int cmp_int(int a, int b) { return a - b; }
 
-uint32_t hash_str(std::string k, uint32_t s) { return ZMAP_HASH_FUNC(k.c_str(), k.length(), s); }
+zmap_hash_t hash_str(std::string k, uint32_t s) { return ZMAP_HASH_FUNC(k.c_str(), k.length(), s); }
 int cmp_str(std::string a, std::string b) { return a.compare(b); }
 
+zmap_hash_t hash_str_ref(const std::string *k, uint32_t s) { return ZMAP_HASH_FUNC(k->c_str(), k->length(), s); }
+int cmp_str_ref(const std::string *a, const std::string *b) { return a->compare(*b); }
+
 void test_cpp_wrappers() 
 {
     TEST("C++ Wrapper (Put, [], At)");
@@ -34,6 +71,66 @@ void test_cpp_wrappers()
     m[3] = 300; // Auto-insert.
     assert(m.size() == 3);
 
+    // Batched lookup.
+    int keys[] = { 1, 2, 3, 4 };
+    int *out[4];
+    assert(m.get_many(keys, 4, out) == 3);
+    assert(*out[1] == 200 && out[3] == nullptr);
+
+    // Bulk insert.
+    int more_keys[] = { 4, 5 };
+    int more_vals[] = { 400, 500 };
+    m.put_many(more_keys, more_vals, 2);
+    assert(m.size() == 5 && m[5] == 500);
+    m.erase(4);
+    m.erase(5);
+
+    // Capacity control; clear keeps the table, shrink_to_fit releases it.
+    m.reserve(500);
+    size_t cap = m.capacity();
+    assert(cap >= 512 && m.size() == 3 && m[2] == 200);
+    m.shrink_to_fit();
+    assert(m.capacity() == 16 && m[3] == 300);
+    zmap_stats st = m.stats();
+    assert(st.count == 3 && st.capacity == 16 && st.max_probe < st.count);
+    assert(m.memory_usage() == st.memory_bytes && m.memory_usage() > 16 * 2 * sizeof(int));
+#ifdef ZMAP_ENABLE_COUNTERS
+    assert(m.counters().resizes > 0);
+    m.reset_counters();
+    assert(m.counters().resizes == 0 && m.counters().puts == 0);
+#endif
+    m.clear();
+    assert(m.capacity() == 16 && m.size() == 0);
+    m.put(1, 100);
+    m.clear();
+    m.shrink_to_fit();
+    assert(m.capacity() == 0);
+    m.put(1, 100);
+    m.put(2, 200);
+    m[3] = 300;
+
+    // try_emplace only constructs on a miss.
+    std::pair<int*, bool> r = m.try_emplace(7, 700);
+    assert(r.second && *r.first == 700);
+    r = m.try_emplace(7, 1);
+    assert(!r.second && *r.first == 700);
+    m[8]++;
+    m[8]++;
+    assert(m[8] == 2 && m.size() == 5);
+    m.erase(7);
+    m.erase(8);
+
+    // A hit constructs no value, through try_emplace or operator[].
+    z_map::map<int, Counted> c(hash_int, cmp_int);
+    c.reserve(8);
+    Counted::made = 0;
+    assert(c.try_emplace(1, 10).second && Counted::made == 1);
+    assert(!c.try_emplace(1, 20).second && Counted::made == 1);
+    assert(c[1].v == 10 && Counted::made == 1);
+    c[2];
+    assert(c.size() == 2 && Counted::made == 2);
+    assert(c[2].v == 0 && Counted::made == 2);
+
     // At (exceptions).
     try 
     {
@@ -64,6 +161,123 @@ void test_complex_types()
     prices.erase("Apple");
     assert(prices.size() == 1);
 
+    // Word count through operator[]: inserts shift non-trivial keys within clusters.
+    z_map::map<std::string, float> words(hash_str, cmp_str);
+    for (int i = 0; i < 3000; i++)
+    {
+        words["w" + std::to_string(i % 1000)] += 1.0f;
+    }
+    assert(words.size() == 1000 && words["w0"] == 3.0f && words["w999"] == 3.0f);
+
+    // Seed rotation moves the strings within the same bucket array.
+    size_t cap = words.capacity();
+    words.reseed(0x12345678);
+    assert(words.capacity() == cap && words.size() == 1000);
+    for (int i = 0; i < 1000; i++)
+    {
+        assert(*words.get("w" + std::to_string(i)) == 3.0f);
+    }
+    assert(!words.contains("w1000"));
+
+    PASS();
+}
+
+void test_ref_keys() 
+{
+    TEST("By-Reference Keys (std::string)");
+
+    // Keys reach the callbacks as const std::string *: no copies per probe.
+    z_map::map<std::string, int> m(hash_str_ref, cmp_str_ref);
+    std::vector<std::string> words;
+    for (int i = 0; i < 500; i++)
+    {
+        words.push_back("key-" + std::to_string(i));
+    }
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        m[words[i]] += (int)i;
+    }
+    assert(m.size() == 500 && m[words[123]] == 123);
+    assert(m.contains(words[499]) && !m.contains("key-500"));
+    assert(!m.try_emplace(words[7], 0).second);
+    m.erase(words[7]);
+    assert(m.size() == 499 && nullptr == m.get(words[7]));
+
+    PASS();
+}
+
+// Minimal std-style allocator that tracks the bytes it hands out.
+static size_t g_tracked_bytes = 0;
+
+template <typename T>
+struct TrackingAlloc
+{
+    using value_type = T;
+
+    TrackingAlloc() {}
+    template <typename U> TrackingAlloc(const TrackingAlloc<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        g_tracked_bytes += n * sizeof(T);
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        g_tracked_bytes -= n * sizeof(T);
+        ::operator delete(p);
+    }
+
+    template <typename U> bool operator==(const TrackingAlloc<U> &) const { return true; }
+    template <typename U> bool operator!=(const TrackingAlloc<U> &) const { return false; }
+};
+
+void test_allocator() 
+{
+    TEST("Std-Style Allocator");
+
+    {
+        using TrackedMap = z_map::map<std::string, float, void, void, TrackingAlloc<char>>;
+        TrackedMap m(hash_str, cmp_str, TrackingAlloc<char>());
+        for (int i = 0; i < 500; i++) 
+        {
+            m["key" + std::to_string(i)] = (float)i;
+        }
+        assert(g_tracked_bytes > 0);
+
+        // Moving keeps both maps on a valid allocator.
+        TrackedMap moved(std::move(m));
+        assert(moved.size() == 500 && *moved.get("key42") == 42.0f);
+        m["again"] = 1.0f;
+        assert(m.size() == 1);
+    }
+    assert(g_tracked_bytes == 0);
+
+    PASS();
+}
+
+void test_stable_arena() 
+{
+    TEST("Stable Arena (Non-Trivial Values)");
+
+    // Arena chunks hold constructed values; remove/clear/free run destructors.
+    zmap_stable_IntStr m = zmap_init_stable_arena_IntStr(hash_int, cmp_int);
+    for (int i = 0; i < 1000; i++) 
+    {
+        assert(zmap_put_stable_IntStr(&m, i, std::string(40, 'a' + i % 26)) == Z_OK);
+    }
+    std::string *p = zmap_get_stable_IntStr(&m, 27);
+    assert(p && *p == std::string(40, 'b'));
+    zmap_remove_stable_IntStr(&m, 27);
+    assert(zmap_put_stable_IntStr(&m, 27, "recycled") == Z_OK);
+    assert(zmap_get_stable_IntStr(&m, 27) == p && *p == "recycled");
+
+    zmap_clear_stable_IntStr(&m);
+    assert(zmap_size_stable_IntStr(&m) == 0 && !zmap_get_stable_IntStr(&m, 1));
+    assert(zmap_put_stable_IntStr(&m, 1, "one") == Z_OK);
+    zmap_free_stable_IntStr(&m);
+
     PASS();
 }
 
@@ -105,13 +319,156 @@ void test_move_semantics()
     PASS();
 }
 
+struct StrHash
+{
+    zmap_hash_t operator()(const std::string &k, uint32_t s) const { return ZMAP_HASH_FUNC(k.c_str(), k.length(), s); }
+};
+
+struct StrEq
+{
+    bool operator()(const std::string &a, const std::string &b) const { return a == b; }
+};
+
+void test_functor_hashing() 
+{
+    TEST("Inline Registration & Functors");
+
+    // Hash and equality baked in at registration.
+    z_map::map<uint64_t, int> ids;
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        ids.put(i << 33, (int)i);
+    }
+    assert(ids.size() == 100);
+    assert(*ids.get(7ull << 33) == 7);
+    assert(!ids.contains(7));
+
+    // Functor template parameters.
+    z_map::map<std::string, float, StrHash, StrEq> prices;
+    prices["Apple"] = 1.5f;
+    assert(prices.contains("Apple"));
+    assert(!prices.contains("Pear"));
+
+    // Functors on a by-reference registration receive the dereferenced key.
+    z_map::map<std::string, int, StrHash, StrEq> counts;
+    counts["a"]++;
+    counts["a"]++;
+    assert(counts["a"] == 2 && !counts.contains("b"));
+
+    PASS();
+}
+
+void test_sets() 
+{
+    TEST("Sets (Keys Only)");
+
+    z_map::set<std::string> s(hash_str, cmp_str);
+    assert(s.insert("apple"));
+    assert(s.insert("pear"));
+    assert(!s.insert("apple"));
+    assert(s.size() == 2 && s.contains("pear"));
+    assert(s.memory_usage() >= sizeof(s) + 2 * (sizeof(std::string) + 1));
+
+    z_map::set<std::string, StrHash, StrEq> words;
+    for (int i = 0; i < 100; i++) 
+    {
+        words.insert("w" + std::to_string(i % 10));
+    }
+    assert(words.size() == 10);
+    assert(words.erase("w3") && !words.erase("w3"));
+
+    size_t seen = 0;
+    for (const std::string &w : words) 
+    {
+        assert(w[0] == 'w' && w != "w3");
+        seen++;
+    }
+    assert(seen == 9);
+
+    words.clear();
+    assert(words.empty() && words.begin() == words.end());
+    PASS();
+}
+
+void test_concurrent_map() 
+{
+    TEST("Concurrent Map (Threads)");
+
+    z_map::concurrent_map<std::string, int, StrHash, StrEq> m(16);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) 
+    {
+        workers.emplace_back([&m, t]() 
+        {
+            for (int i = 0; i < 5000; i++) 
+            {
+                m.put("k" + std::to_string(t * 5000 + i), i);
+                m.upsert("hits", 1, [](int &v) { v++; });
+            }
+        });
+    }
+    for (auto &w : workers) 
+    {
+        w.join();
+    }
+
+    int v = 0;
+    assert(m.size() == 20001);
+    assert(m.get("hits", v) && v == 20000);
+    assert(m.get("k19999", v) && v == 4999);
+    assert(m.erase("k0") && !m.contains("k0"));
+    m.clear();
+    assert(m.size() == 0);
+
+    PASS();
+}
+
+// Rejects one key, like a hash that validates or allocates.
+zmap_hash_t hash_str_strict(std::string k, uint32_t s) 
+{ 
+    if (k == "boom") 
+    {
+        throw std::runtime_error("unhashable");
+    }
+    return hash_str(k, s); 
+}
+
+void test_throwing_hash() 
+{
+    TEST("Throwing Hash (Reports Z_ENOMEM)");
+
+    zmap_StrFloat m = zmap_init_StrFloat(hash_str_strict, cmp_str);
+    assert(zmap_put_StrFloat(&m, "ok", 1.0f) == Z_OK);
+    assert(zmap_put_StrFloat(&m, "boom", 2.0f) == Z_ENOMEM);
+    std::string keys[] = { "a", "b", "boom" };
+    float vals[] = { 1.0f, 2.0f, 3.0f };
+    assert(zmap_put_many_StrFloat(&m, keys, vals, 3) == Z_ENOMEM);
+    assert(m.count == 1 && *zmap_get_StrFloat(&m, "ok") == 1.0f);
+    zmap_free_StrFloat(&m);
+
+    zmap_concurrent_StrIntConc c;
+    assert(zmap_init_concurrent_StrIntConc(&c, hash_str_strict, cmp_str, 4) == Z_OK);
+    assert(zmap_put_concurrent_StrIntConc(&c, "ok", 1) == Z_OK);
+    assert(zmap_put_concurrent_StrIntConc(&c, "boom", 2) == Z_ENOMEM);
+    zmap_free_concurrent_StrIntConc(&c);
+
+    PASS();
+}
+
 int main() 
 {
     std::cout << "=> Running tests (zmap.h, C++)\n";
     test_cpp_wrappers();
     test_complex_types();
+    test_ref_keys();
+    test_allocator();
+    test_stable_arena();
     test_stl_iterators();
     test_move_semantics();
+    test_functor_hashing();
+    test_sets();
+    test_concurrent_map();
+    test_throwing_hash();
     std::cout << "=> All tests passed successfully.\n";
     return 0;
 }
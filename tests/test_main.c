@@ -1,27 +1,83 @@
 
+#define _POSIX_C_SOURCE 200809L   // pthread_rwlock_t under -std=c11.
+#define _DEFAULT_SOURCE           // MAP_ANONYMOUS and madvise for huge-page maps.
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
 
 typedef struct 
 { 
     float x, y; 
 } Vec2;
 
+typedef struct 
+{ 
+    uint64_t w[4]; 
+} U256;
+
 #define REGISTER_ZMAP_TYPES(X) \
     X(int, int, IntInt)        \
     X(char*, int, StrInt)
 
+#define REGISTER_ZMAP_FROZEN_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_PERFECT_TYPES(X) \
+    X(int, int, IntInt)          \
+    X(char*, int, StrInt)
+
+#define REGISTER_ZMAP_REF_TYPES(X) \
+    X(U256, int, U256Int)
+
+#define REGISTER_STABLE_MAPS(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_GROUP_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_SOA_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_INCR_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_CONCURRENT_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_SEQLOCK_TYPES(X) \
+    X(int, int, IntInt)
+
+#define REGISTER_ZMAP_INLINE_TYPES(X) \
+    X(int, int, IntIntFast, ZMAP_HASH_SCALAR, ZMAP_EQ_SCALAR)
+
+#define REGISTER_ZSET_TYPES(X) \
+    X(int, IntSet)
+
+// Counts releases so teardown cost can be checked. Atomic: concurrent tests free too.
+static size_t test_frees = 0;
+static void test_free(void *p) 
+{ 
+    if (p) 
+    {
+        __atomic_fetch_add(&test_frees, 1, __ATOMIC_RELAXED); 
+    }
+    free(p); 
+}
+#define ZMAP_FREE(p) test_free(p)
+
 #include "zmap.h"
 
 #define TEST(name) printf("[TEST] %-35s", name);
 #define PASS() printf(" \033[0;32mPASS\033[0m\n")
 
-uint32_t hash_int(int k, uint32_t seed) { return (uint32_t)k ^ seed; }
+zmap_hash_t hash_int(int k, uint32_t seed) { return (uint32_t)k ^ seed; }
 int cmp_int(int a, int b) { return a - b; }
 
-uint32_t hash_str(char* k, uint32_t seed) { return ZMAP_HASH_STR(k, seed); }
+zmap_hash_t hash_str(char* k, uint32_t seed) { return ZMAP_HASH_STR(k, seed); }
 int cmp_str(char* a, char* b) { return strcmp(a, b); }
 
 void test_basic_ops(void) 
@@ -136,6 +192,1050 @@ void test_iterators(void)
     PASS();
 }
 
+typedef struct 
+{
+    size_t live_bytes;
+    size_t calls;
+} CountingHeap;
+
+static void *counting_alloc(void *ctx, size_t size) 
+{
+    CountingHeap *h = (CountingHeap*)ctx;
+    h->live_bytes += size;
+    h->calls++;
+    return malloc(size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) 
+{
+    ((CountingHeap*)ctx)->live_bytes -= size;
+    free(ptr);
+}
+
+void test_custom_allocator(void) 
+{
+    TEST("Per-Map Allocator");
+
+    CountingHeap heap = {0, 0};
+    zmap_allocator a = { counting_alloc, counting_free, &heap };
+    zmap_IntInt m = zmap_init_alloc(IntInt, hash_int, cmp_int, a);
+    for (int i = 0; i < 1000; i++) 
+    {
+        assert(zmap_put(&m, i, i) == Z_OK);
+    }
+    assert(heap.calls > 0);
+    assert(heap.live_bytes == m.capacity * sizeof(m.buckets[0]));
+    assert(zmap_shrink_to_fit(&m) == Z_OK);
+    assert(heap.live_bytes == m.capacity * sizeof(m.buckets[0]));
+    assert(*zmap_get(&m, 999) == 999);
+    zmap_free(&m);
+    assert(heap.live_bytes == 0);
+
+    // Maps without an allocator still use ZMAP_CALLOC/ZMAP_FREE.
+    size_t calls = heap.calls;
+    m = zmap_init(IntInt, hash_int, cmp_int);
+    assert(zmap_put(&m, 1, 1) == Z_OK);
+    zmap_free(&m);
+    assert(heap.calls == calls);
+    PASS();
+}
+
+void test_hugepage_allocator(void) 
+{
+    TEST("Huge-Page Buckets");
+
+    // Large enough for the bucket array to cross ZMAP_HUGEPAGE_MIN.
+    zmap_IntInt m = zmap_init_alloc(IntInt, hash_int, cmp_int, zmap_hugepage_allocator());
+    for (int i = 0; i < 300000; i++) 
+    {
+        assert(zmap_put(&m, i, i + 1) == Z_OK);
+    }
+    assert(m.capacity * sizeof(m.buckets[0]) >= ZMAP_HUGEPAGE_MIN);
+#if ZMAP_HAS_MMAP
+    assert((uintptr_t)m.buckets % ZMAP_HUGEPAGE_SIZE == 0);
+#endif
+    for (int i = 0; i < 300000; i += 7) 
+    {
+        assert(*zmap_get(&m, i) == i + 1);
+    }
+
+    // Shrinking below the threshold moves the buckets back to the regular heap.
+    for (int i = 100; i < 300000; i++) 
+    {
+        zmap_remove(&m, i);
+    }
+    assert(zmap_shrink_to_fit(&m) == Z_OK);
+    assert(zmap_size(&m) == 100 && *zmap_get(&m, 99) == 100);
+    zmap_free(&m);
+    PASS();
+}
+
+void test_frozen_snapshot(void) 
+{
+    TEST("Frozen Snapshots (mmap)");
+
+    const char *path = "zmap_frozen_test.bin";
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    zmap_set_seed(&m, 1234);
+    for (int i = 0; i < 5000; i++) 
+    {
+        assert(zmap_put(&m, i * 7, i) == Z_OK);
+    }
+    assert(zmap_freeze(&m, path) == Z_OK);
+
+    zmap_frozen_IntInt f;
+    assert(zmap_frozen_open(IntInt, &f, path, hash_int, cmp_int) == Z_OK);
+    assert(zmap_frozen_size(&f) == 5000 && f.seed == 1234 && f.load_factor == m.load_factor);
+    assert(zmap_frozen_verify(&f));
+    for (int i = 0; i < 5000; i++) 
+    {
+        const int *v = zmap_frozen_get(&f, i * 7);
+        assert(v && *v == i);
+        assert(!zmap_frozen_get(&f, i * 7 + 1));
+    }
+    zmap_frozen_close(&f);
+
+    // In-memory images are validated, and the checksum catches corruption.
+    size_t len = sizeof(zmap_frozen_header) + m.capacity * sizeof(m.buckets[0]);
+    char *image = (char*)malloc(len);
+    FILE *fp = fopen(path, "rb");
+    assert(fp && fread(image, len, 1, fp) == 1);
+    fclose(fp);
+    assert(zmap_frozen_view_IntInt(&f, image, len - 1, hash_int, cmp_int) == Z_EINVAL);
+    assert(zmap_frozen_view_IntInt(&f, image, len, hash_int, cmp_int) == Z_OK);
+    image[len - 1] ^= 0x5A;
+    assert(!zmap_frozen_verify(&f));
+    float bad_load = -1.0f;
+    memcpy(image + offsetof(zmap_frozen_header, load_factor), &bad_load, sizeof(bad_load));
+    assert(zmap_frozen_view_IntInt(&f, image, len, hash_int, cmp_int) == Z_EINVAL);
+    image[0] = 'X';
+    assert(zmap_frozen_view_IntInt(&f, image, len, hash_int, cmp_int) == Z_EINVAL);
+    free(image);
+
+    // Empty maps freeze to a bare header.
+    zmap_IntInt empty = zmap_init(IntInt, hash_int, cmp_int);
+    assert(zmap_freeze(&empty, path) == Z_OK);
+    assert(zmap_frozen_open(IntInt, &f, path, hash_int, cmp_int) == Z_OK);
+    assert(zmap_frozen_size(&f) == 0 && !zmap_frozen_get(&f, 1));
+    zmap_frozen_close(&f);
+
+    remove(path);
+    zmap_free(&m);
+    PASS();
+}
+
+void test_perfect_hash(void) 
+{
+    TEST("Minimal Perfect Hash");
+
+    enum { N = 10000 };
+    int *keys = (int*)malloc(N * sizeof(int));
+    int *vals = (int*)malloc(N * sizeof(int));
+    for (int i = 0; i < N; i++) 
+    {
+        keys[i] = i * 13 + 5;
+        vals[i] = i;
+    }
+    zmap_perfect_IntInt p;
+    assert(zmap_build_perfect(IntInt, &p, hash_int, cmp_int, keys, vals, N) == Z_OK);
+    assert(zmap_perfect_size(&p) == N);
+    for (int i = 0; i < N; i++) 
+    {
+        int *v = zmap_perfect_get(&p, keys[i]);
+        assert(v && *v == i);
+        assert(!zmap_perfect_get(&p, keys[i] + 1));
+    }
+    zmap_perfect_free(&p);
+
+    // Duplicate keys are rejected; an empty set builds and misses everything.
+    keys[N - 1] = keys[0];
+    assert(zmap_build_perfect(IntInt, &p, hash_int, cmp_int, keys, vals, N) == Z_EEXIST);
+    assert(zmap_perfect_size(&p) == 0 && !zmap_perfect_get(&p, keys[1]));
+    assert(zmap_build_perfect(IntInt, &p, hash_int, cmp_int, keys, vals, 0) == Z_OK);
+    assert(!zmap_perfect_get(&p, keys[0]));
+    zmap_perfect_free(&p);
+    free(keys);
+    free(vals);
+
+    char *words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta" };
+    int ids[] = { 0, 1, 2, 3, 4, 5, 6 };
+    zmap_perfect_StrInt ps;
+    assert(zmap_build_perfect(StrInt, &ps, hash_str, cmp_str, words, ids, 7) == Z_OK);
+    assert(*zmap_perfect_get(&ps, "epsilon") == 4 && !zmap_perfect_get(&ps, "omega"));
+    zmap_perfect_free(&ps);
+    PASS();
+}
+
+void test_stable_arena(void) 
+{
+    TEST("Stable Maps (Slab Arena)");
+
+    zmap_stable_IntInt m = zmap_init_stable_arena(IntInt, hash_int, cmp_int);
+    for (int i = 0; i < 5000; i++) 
+    {
+        assert(zmap_put(&m, i, i * 2) == Z_OK);
+    }
+    int *p = zmap_get(&m, 1234);
+    assert(p && *p == 2468);
+
+    // Values keep their address across resizes; slabs double, so there are few of them.
+    for (int i = 5000; i < 20000; i++) 
+    {
+        assert(zmap_put(&m, i, i * 2) == Z_OK);
+    }
+    assert(zmap_get(&m, 1234) == p);
+    size_t slabs = 0;
+    for (zmap_slab *s = m.arena.slabs; s; s = s->next) 
+    {
+        slabs++;
+    }
+    assert(slabs < 16);
+
+    // Removed chunks are recycled before the arena grows.
+    zmap_remove(&m, 1234);
+    assert(zmap_put(&m, 1234, 7) == Z_OK);
+    assert(zmap_get(&m, 1234) == p && *p == 7);
+
+    // Clear keeps the table and the arena mode.
+    size_t cap = m.capacity;
+    zmap_clear(&m);
+    assert(zmap_size(&m) == 0 && m.capacity == cap && !zmap_get(&m, 1));
+    assert(zmap_put(&m, 1, 1) == Z_OK && *zmap_get(&m, 1) == 1 && m.arena.enabled);
+    zmap_free(&m);
+    assert(m.arena.slabs == NULL);
+
+    // Teardown releases each slab plus the bucket array, however many values there are.
+    m = zmap_init_stable_arena(IntInt, hash_int, cmp_int);
+    for (int i = 0; i < 20000; i++) 
+    {
+        assert(zmap_put(&m, i, i) == Z_OK);
+    }
+    slabs = 0;
+    for (zmap_slab *s = m.arena.slabs; s; s = s->next) 
+    {
+        slabs++;
+    }
+    test_frees = 0;
+    zmap_free(&m);
+    assert(test_frees == slabs + 1);
+
+    // Plain stable maps still allocate values one at a time.
+    m = zmap_init_stable(IntInt, hash_int, cmp_int);
+    for (int i = 0; i < 1000; i++) 
+    {
+        assert(zmap_put(&m, i, i) == Z_OK);
+    }
+    assert(*zmap_get(&m, 1) == 1 && m.arena.slabs == NULL);
+    test_frees = 0;
+    zmap_free(&m);
+    assert(test_frees == 1000 + 1);
+    PASS();
+}
+
+void test_group_probing(void) 
+{
+    TEST("Group Probing (Control Bytes)");
+
+    zmap_group_IntInt m = zmap_init_group(IntInt, hash_int, cmp_int);
+
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&m, i, i * 2);
+    }
+    assert(zmap_size(&m) == 1000);
+
+    // Hits and misses.
+    for (int i = 0; i < 1000; i++) 
+    {
+        int* v = zmap_get(&m, i);
+        assert(v != NULL && *v == i * 2);
+        assert(zmap_get(&m, i + 100000) == NULL);
+    }
+
+    // Remove evens, leaving tombstones that later inserts reuse.
+    for (int i = 0; i < 1000; i += 2) 
+    {
+        zmap_remove(&m, i);
+    }
+    assert(zmap_size(&m) == 500);
+    assert(zmap_get(&m, 10) == NULL);
+    assert(*zmap_get(&m, 11) == 22);
+
+    for (int i = 0; i < 1000; i += 2) 
+    {
+        zmap_put(&m, i, -i);
+    }
+    assert(zmap_size(&m) == 1000);
+    assert(*zmap_get(&m, 10) == -10);
+
+    int seen = 0;
+    zmap_iter_group_IntInt it = zmap_iter_init(IntInt, &m);
+    while (zmap_iter_next(&it, NULL, NULL))
+    {
+        seen++;
+    }
+    assert(seen == 1000);
+
+    zmap_free(&m);
+    PASS();
+}
+
+zmap_hash_t hash_const(int k, uint32_t seed) { (void)k; (void)seed; return 7; }
+
+void test_soa_layout(void) 
+{
+    TEST("SoA Layout (Saturated Distances)");
+
+    zmap_soa_IntInt m = zmap_init_soa(IntInt, hash_int, cmp_int);
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&m, i, i + 1);
+    }
+    assert(zmap_size(&m) == 1000);
+    assert(*zmap_get(&m, 999) == 1000);
+    assert(zmap_get(&m, 5000) == NULL);
+    zmap_remove(&m, 500);
+    assert(zmap_get(&m, 500) == NULL);
+    assert(*zmap_get(&m, 501) == 502);
+    zmap_free(&m);
+
+    // A degenerate hash pushes probe distances past the metadata byte.
+    m = zmap_init_soa(IntInt, hash_const, cmp_int);
+    for (int i = 0; i < 400; i++) 
+    {
+        zmap_put(&m, i, i);
+    }
+    for (int i = 0; i < 400; i += 3) 
+    {
+        zmap_remove(&m, i);
+    }
+    for (int i = 0; i < 400; i++) 
+    {
+        int* v = zmap_get(&m, i);
+        assert((i % 3 == 0) ? v == NULL : (v != NULL && *v == i));
+    }
+    zmap_free(&m);
+    PASS();
+}
+
+void test_inline_hash(void) 
+{
+    TEST("Inline Hash & Equality");
+
+    zmap_IntIntFast m = zmap_init_inline(IntIntFast);
+    assert(m.hash_func == NULL);
+
+    for (int i = 0; i < 500; i++) 
+    {
+        zmap_put(&m, i, -i);
+    }
+    assert(zmap_size(&m) == 500);
+    assert(*zmap_get(&m, 250) == -250);
+    assert(zmap_get(&m, 999) == NULL);
+
+    zmap_remove(&m, 250);
+    assert(zmap_get(&m, 250) == NULL);
+    assert(zmap_size(&m) == 499);
+
+    zmap_free(&m);
+    PASS();
+}
+
+void test_get_many(void) 
+{
+    TEST("Batched Lookup (get_many)");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    int keys[100];
+    int *out[100];
+
+    assert(zmap_get_many(&m, keys, 0, out) == 0);
+
+    for (int i = 0; i < 100; i++) 
+    {
+        keys[i] = i * 2;        // Odd keys are never inserted.
+        zmap_put(&m, i, i * 10);
+    }
+
+    size_t hits = zmap_get_many(&m, keys, 100, out);
+    assert(hits == 50);
+    for (int i = 0; i < 100; i++) 
+    {
+        if (keys[i] < 100)
+        {
+            assert(out[i] != NULL && *out[i] == keys[i] * 10);
+        }
+        else
+        {
+            assert(out[i] == NULL);
+        }
+    }
+
+    zmap_free(&m);
+    PASS();
+}
+
+void test_put_many(void) 
+{
+    TEST("Bulk Insert (put_many)");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    int keys[1000];
+    int vals[1000];
+
+    assert(zmap_put_many(&m, keys, vals, 0) == Z_OK);
+    assert(m.capacity == 0);
+
+    for (int i = 0; i < 1000; i++) 
+    {
+        keys[i] = i;
+        vals[i] = i * 3;
+    }
+    keys[999] = 0;              // Duplicate within the batch: last write wins.
+
+    assert(zmap_put_many(&m, keys, vals, 1000) == Z_OK);
+    assert(zmap_size(&m) == 999);
+    assert(*zmap_get(&m, 0) == 999 * 3);
+    assert(*zmap_get(&m, 998) == 998 * 3);
+
+    // Capacity was reserved once: the batch fits without another resize.
+    size_t cap = m.capacity;
+    assert(m.threshold >= 1000);
+    assert(zmap_put_many(&m, keys, vals, 1) == Z_OK);
+    assert(m.capacity == cap);
+
+    zmap_free(&m);
+    PASS();
+}
+
+void test_reserve_shrink(void) 
+{
+    TEST("Reserve / Shrink To Fit");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+
+    assert(zmap_reserve(&m, 0) == Z_OK);
+    assert(m.capacity == 0);
+
+    assert(zmap_reserve(&m, 1000) == Z_OK);
+    size_t cap = m.capacity;
+    assert(m.threshold >= 1000);
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&m, i, i);
+    }
+    assert(m.capacity == cap);
+
+    // Reserving less than the current capacity never shrinks.
+    assert(zmap_reserve(&m, 10) == Z_OK);
+    assert(m.capacity == cap);
+
+    for (int i = 10; i < 1000; i++) 
+    {
+        zmap_remove(&m, i);
+    }
+    assert(zmap_shrink_to_fit(&m) == Z_OK);
+    assert(m.capacity == 16);
+    for (int i = 0; i < 10; i++) 
+    {
+        assert(*zmap_get(&m, i) == i);
+    }
+
+    // Empty map releases its buckets and still accepts inserts.
+    zmap_clear(&m);
+    assert(zmap_shrink_to_fit(&m) == Z_OK);
+    assert(m.capacity == 0 && m.buckets == NULL);
+    zmap_put(&m, 7, 70);
+    assert(*zmap_get(&m, 7) == 70);
+
+    zmap_free(&m);
+    PASS();
+}
+
+// Uses six bits of the key, like a hash that reads too little of it.
+zmap_hash_t hash_low_bits(int k, uint32_t seed) { return (zmap_hash_t)((k & 0x3F) ^ seed); }
+
+void test_stats(void) 
+{
+    TEST("Probe / Occupancy Stats");
+
+    zmap_stats s;
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    zmap_stats(&m, &s);
+    assert(s.count == 0 && s.capacity == 0 && s.hash_quality == 1.0);
+    for (int i = 0; i < 2000; i++) 
+    {
+        zmap_put(&m, i * 31, i);
+    }
+    zmap_stats(&m, &s);
+    size_t binned = 0;
+    for (int b = 0; b < ZMAP_STATS_BINS; b++) 
+    {
+        binned += s.probe_hist[b];
+    }
+    assert(s.count == 2000 && s.capacity == m.capacity && binned == 2000);
+    assert(s.load > 0.2 && s.load < ZMAP_DEFAULT_LOAD + 0.01);
+    assert(s.memory_bytes == sizeof(m) + m.capacity * sizeof(m.buckets[0]));
+    assert(s.longest_cluster >= 1 && s.longest_cluster > s.max_probe);
+    assert(s.hash_quality > 0.9 && s.mean_probe < 2.0);
+    zmap_free(&m);
+
+    // A hash with only 64 distinct values shows up as low quality and long probes.
+    zmap_IntInt bad = zmap_init(IntInt, hash_low_bits, cmp_int);
+    for (int i = 0; i < 2000; i++) 
+    {
+        zmap_put(&bad, i * 31, i);
+    }
+    zmap_stats(&bad, &s);
+    assert(s.distinct_homes <= 64 && s.hash_quality < 0.1);
+    assert(s.mean_probe > 4.0 && s.probe_hist[ZMAP_STATS_BINS - 1] > 0);
+    zmap_free(&bad);
+    PASS();
+}
+
+void test_rehash(void) 
+{
+    TEST("In-Place Rehash");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    zmap_rehash(&m, 1);
+    assert(m.seed == 1 && m.capacity == 0);
+    for (int i = 0; i < 3000; i++) 
+    {
+        zmap_put(&m, i * 7, i);
+    }
+    void *buckets = m.buckets;
+    size_t cap = m.capacity;
+    zmap_rehash(&m, 0x9E3779B9);
+    assert(m.buckets == buckets && m.capacity == cap && zmap_size(&m) == 3000);
+    for (size_t i = 0; i < m.capacity; i++) 
+    {
+        assert(ZMAP_EMPTY == m.buckets[i].state ||
+               (ZMAP_OCCUPIED == m.buckets[i].state && m.buckets[i].stored_hash == hash_int(m.buckets[i].key, m.seed)));
+    }
+    for (int i = 0; i < 3000; i++) 
+    {
+        assert(*zmap_get(&m, i * 7) == i);
+        assert(zmap_get(&m, i * 7 + 1) == NULL);
+    }
+    for (int i = 0; i < 3000; i += 2) 
+    {
+        zmap_remove(&m, i * 7);
+    }
+    for (int i = 0; i < 3000; i++) 
+    {
+        assert((zmap_get(&m, i * 7) != NULL) == (i % 2 == 1));
+    }
+
+    // Swapping in a better hash function: rehash under the current seed.
+    zmap_IntInt bad = zmap_init(IntInt, hash_low_bits, cmp_int);
+    for (int i = 0; i < 2000; i++) 
+    {
+        zmap_put(&bad, i * 31, i);
+    }
+    bad.hash_func = hash_int;
+    zmap_rehash(&bad, bad.seed);
+    zmap_stats s;
+    zmap_stats(&bad, &s);
+    assert(s.count == 2000 && s.hash_quality > 0.9 && s.mean_probe < 2.0);
+    for (int i = 0; i < 2000; i++) 
+    {
+        assert(*zmap_get(&bad, i * 31) == i);
+    }
+    zmap_free(&bad);
+    zmap_free(&m);
+    PASS();
+}
+
+void test_memory_usage(void) 
+{
+    TEST("Memory Usage");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    assert(zmap_memory_usage(&m) == sizeof(m));
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&m, i, i);
+    }
+    zmap_stats s;
+    zmap_stats(&m, &s);
+    assert(zmap_memory_usage(&m) == sizeof(m) + m.capacity * sizeof(m.buckets[0]));
+    assert(s.memory_bytes == zmap_memory_usage(&m));
+    zmap_free(&m);
+
+    // Stable maps count their values: one block each, or whole slabs with an arena.
+    zmap_stable_IntInt st = zmap_init_stable(IntInt, hash_int, cmp_int);
+    zmap_stable_IntInt ar = zmap_init_stable_arena(IntInt, hash_int, cmp_int);
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&st, i, i);
+        zmap_put(&ar, i, i);
+    }
+    size_t table = sizeof(st) + st.capacity * sizeof(st.buckets[0]);
+    assert(zmap_memory_usage(&st) == table + 1000 * sizeof(int));
+    assert(zmap_memory_usage(&ar) >= table + 1000 * ZMAP_ARENA_CHUNK(int));
+    zmap_free(&ar);
+    assert(zmap_memory_usage(&ar) == sizeof(ar));
+    zmap_free(&st);
+
+    zmap_group_IntInt g = zmap_init_group(IntInt, hash_int, cmp_int);
+    zmap_soa_IntInt a = zmap_init_soa(IntInt, hash_int, cmp_int);
+    zset_IntSet set = zset_init(IntSet, hash_int, cmp_int);
+    zmap_put(&g, 1, 1);
+    zmap_put(&a, 1, 1);
+    zset_insert(&set, 1);
+    assert(zmap_memory_usage(&g) == sizeof(g) + g.capacity + ZMAP_GROUP_WIDTH + g.capacity * sizeof(g.slots[0]));
+    assert(zmap_memory_usage(&a) > sizeof(a) + a.capacity * 2 * sizeof(int));
+    assert(zset_memory_usage(&set) == sizeof(set) + set.capacity * (sizeof(int) + 1));
+    zmap_free(&g);
+    zmap_free(&a);
+    zset_free(&set);
+
+    // An incremental map holds both tables until the migration finishes.
+    zmap_incr_IntInt inc = zmap_init_incr(IntInt, hash_int, cmp_int);
+    int n = 0;
+    while (!inc.old_buckets) 
+    {
+        zmap_put(&inc, n, n);
+        n++;
+    }
+    assert(zmap_memory_usage(&inc) == sizeof(inc) + (inc.capacity + inc.old_capacity) * sizeof(inc.buckets[0]));
+    while (zmap_migrate(&inc, 64)) 
+    {
+    }
+    assert(zmap_memory_usage(&inc) == sizeof(inc) + inc.capacity * sizeof(inc.buckets[0]));
+    zmap_free(&inc);
+    PASS();
+}
+
+#ifdef ZMAP_ENABLE_COUNTERS
+void test_counters(void) 
+{
+    TEST("Operation Counters");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    zmap_counters c = zmap_counters(&m);
+    assert(c.puts == 0 && c.resizes == 0);
+    assert(!zmap_get(&m, 1));
+    for (int i = 0; i < 1000; i++) 
+    {
+        zmap_put(&m, i, i);
+    }
+    zmap_put(&m, 5, 50);
+    for (int i = 0; i < 2000; i++) 
+    {
+        zmap_get(&m, i);
+    }
+    zmap_remove(&m, 3);
+    zmap_remove(&m, 5000);
+    bool inserted;
+    zmap_get_or_insert(&m, 7, 0, &inserted);
+    zmap_get_or_insert(&m, 9000, 0, &inserted);
+
+    c = zmap_counters(&m);
+    assert(c.puts == 1002 && c.hits == 1001 && c.misses == 1002 && c.removes == 1);
+    assert(c.resizes >= 6 && c.resize_ns > 0);
+
+    zmap_reset_counters(&m);
+    c = zmap_counters(&m);
+    assert(c.puts == 0 && c.hits == 0 && c.probes == 0 && c.resize_ns == 0);
+    zmap_free(&m);
+    PASS();
+}
+#endif
+
+void test_get_or_insert(void) 
+{
+    TEST("Get Or Insert (Single Probe)");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    int expect[512] = {0};
+    bool inserted;
+
+    // Counter loop with interleaved removals to exercise the cluster shift.
+    uint32_t x = 12345;
+    for (int i = 0; i < 20000; i++) 
+    {
+        x = x * 1103515245u + 12345u;
+        int key = (int)((x >> 8) % 512);
+        if (0 == i % 7) 
+        {
+            zmap_remove(&m, key);
+            expect[key] = 0;
+            continue;
+        }
+        int *v = zmap_get_or_insert(&m, key, 0, &inserted);
+        assert(v != NULL);
+        assert(inserted == (0 == expect[key]));
+        (*v)++;
+        expect[key]++;
+    }
+
+    size_t live = 0;
+    for (int k = 0; k < 512; k++) 
+    {
+        int *v = zmap_get(&m, k);
+        if (expect[k]) 
+        {
+            assert(v && *v == expect[k]);
+            live++;
+        }
+        else 
+        {
+            assert(NULL == v);
+        }
+    }
+    assert(zmap_size(&m) == live);
+
+    // Existing entries are never overwritten by the default.
+    zmap_put(&m, 9999, 1);
+    assert(*zmap_get_or_insert(&m, 9999, 42, NULL) == 1);
+
+    zmap_free(&m);
+    PASS();
+}
+
+zmap_hash_t hash_u256(U256 const *k, uint32_t s) 
+{ 
+    return ZMAP_HASH_FUNC(k->w, sizeof(k->w), s); 
+}
+
+int cmp_u256(U256 const *a, U256 const *b) 
+{ 
+    return memcmp(a->w, b->w, sizeof(a->w)); 
+}
+
+void test_ref_keys(void) 
+{
+    TEST("By-Reference Keys (U256)");
+
+    zmap_U256Int m = zmap_init(U256Int, hash_u256, cmp_u256);
+    U256 keys[200];
+
+    for (int i = 0; i < 200; i++) 
+    {
+        keys[i] = (U256){ { (uint64_t)i, ~(uint64_t)i, 0, (uint64_t)i << 32 } };
+        assert(zmap_put(&m, &keys[i], i) == Z_OK);
+    }
+    assert(zmap_size(&m) == 200);
+
+    // The map stores its own copy of the key.
+    U256 probe = keys[42];
+    keys[42].w[0] = 9999;
+    assert(*zmap_get(&m, &probe) == 42);
+    assert(NULL == zmap_get(&m, &keys[42]));
+
+    bool inserted;
+    *zmap_get_or_insert(&m, &probe, 0, &inserted) += 1;
+    assert(!inserted && *zmap_get(&m, &probe) == 43);
+
+    int *out[200];
+    assert(zmap_get_many(&m, keys, 200, out) == 199);
+    assert(NULL == out[42] && *out[7] == 7);
+
+    zmap_remove(&m, &probe);
+    assert(NULL == zmap_get(&m, &probe) && zmap_size(&m) == 199);
+
+    zmap_free(&m);
+    PASS();
+}
+
+void test_hash_width(void) 
+{
+    TEST("Hash Width (ZMAP_HASH_BITS)");
+
+    zmap_IntInt m = zmap_init(IntInt, hash_int, cmp_int);
+    zmap_put(&m, 1, 1);
+    assert(sizeof(m.buckets[0].stored_hash) * 8 == ZMAP_HASH_BITS);
+
+    // Fibonacci indexing takes the top bits of the product, so every hash bit matters.
+    zmap_hash_t top = (zmap_hash_t)1 << (ZMAP_HASH_BITS - 1);
+    assert(zmap_fib_index(top, 16) != zmap_fib_index(0, 16));
+#ifdef ZMAP_HASH_64
+    // Indices span more than 2^32 buckets.
+    assert(zmap_fib_index((zmap_hash_t)-1, 40) > 0xFFFFFFFFu);
+#endif
+
+    // Saturated SoA distances are recomputed from the full-width hash.
+    zmap_hash_t h = top | 5;
+    size_t home = zmap_fib_index(h, 20);
+    assert(zmap_meta_dist(ZMAP_META_SAT, (home + 300) & ((1u << 20) - 1), 1u << 20, h, 20) == 300);
+
+    zmap_free(&m);
+    PASS();
+}
+
+void test_sets(void) 
+{
+    TEST("Sets (Keys Only)");
+
+    zset_IntSet s = zset_init(IntSet, hash_int, cmp_int);
+    for (int i = 0; i < 1000; i++) 
+    {
+        assert(zset_insert(&s, i * 3) == Z_OK);
+    }
+    assert(zset_insert(&s, 0) == Z_FOUND);
+    assert(zset_size(&s) == 1000);
+    assert(zset_contains(&s, 999 * 3) && !zset_contains(&s, 1));
+
+    for (int i = 0; i < 1000; i += 2) 
+    {
+        assert(zset_remove(&s, i * 3));
+    }
+    assert(!zset_remove(&s, 0));
+    assert(zset_size(&s) == 500);
+
+    int k = 0;
+    size_t seen = 0;
+    zset_iter_IntSet it = zset_iter_init(IntSet, &s);
+    while (zset_iter_next(&it, &k)) 
+    {
+        assert(k % 6 == 3);
+        seen++;
+    }
+    assert(seen == 500);
+    zset_free(&s);
+
+    // A constant hash forces distances past ZMAP_META_SAT.
+    s = zset_init(IntSet, hash_const, cmp_int);
+    for (int i = 0; i < 400; i++) 
+    {
+        assert(zset_insert(&s, i) == Z_OK);
+    }
+    for (int i = 0; i < 400; i += 3) 
+    {
+        assert(zset_remove(&s, i));
+    }
+    for (int i = 0; i < 400; i++) 
+    {
+        assert(zset_contains(&s, i) == (i % 3 != 0));
+    }
+    zset_free(&s);
+    PASS();
+}
+
+void test_incremental_resize(void) 
+{
+    TEST("Incremental Resize");
+
+    zmap_incr_IntInt m = zmap_init_incr(IntInt, hash_int, cmp_int);
+
+    // Fill a table big enough that one step cannot migrate it, then cross the threshold.
+    int n = 0;
+    while (m.capacity < 1024 || m.count < m.threshold) 
+    {
+        assert(zmap_put(&m, n, n * 2) == Z_OK);
+        n++;
+    }
+    size_t old_cap = m.capacity;
+    assert(zmap_put(&m, n, n * 2) == Z_OK);
+    n++;
+    assert(m.old_buckets != NULL && m.capacity == old_cap * 2);
+
+    // Every key is reachable while entries are split across both arrays.
+    for (int i = 0; i < n; i++) 
+    {
+        assert(*zmap_get(&m, i) == i * 2);
+    }
+
+    // Update and remove a key that has not been migrated yet.
+    size_t slot = m.old_capacity - 1;
+    while (m.old_buckets[slot].state != ZMAP_OCCUPIED) 
+    {
+        slot--;
+    }
+    int last = m.old_buckets[slot].key;
+    assert(zmap_put(&m, last, -1) == Z_OK);
+    assert(m.old_buckets[slot].value == -1);
+    zmap_remove(&m, last);
+    assert(zmap_get(&m, last) == NULL);
+    assert(zmap_size(&m) == (size_t)n - 1);
+
+    int k, v;
+    size_t seen = 0;
+    zmap_iter_incr_IntInt it = zmap_iter_init(IntInt, &m);
+    while (zmap_iter_next(&it, &k, &v)) 
+    {
+        seen++;
+    }
+    assert(seen == zmap_size(&m));
+
+    // Draining finishes the migration and releases the old array.
+    assert(zmap_migrate(&m, SIZE_MAX) == false);
+    assert(m.old_buckets == NULL);
+    for (int i = 0; i < n; i++) 
+    {
+        int *p = zmap_get(&m, i);
+        assert(i == last ? p == NULL : *p == i * 2);
+    }
+
+    // Bulk growth across several resizes.
+    for (int i = 0; i < 100000; i++) 
+    {
+        zmap_put(&m, i, i);
+    }
+    assert(zmap_size(&m) == 100000);
+    for (int i = 0; i < 100000; i += 7) 
+    {
+        assert(*zmap_get(&m, i) == i);
+    }
+
+    zmap_free(&m);
+    PASS();
+}
+
+#define CONC_THREADS 4
+#define CONC_PER_THREAD 20000
+
+static zmap_concurrent_IntInt conc_map;
+
+static void conc_incr(int *v, void *ctx) 
+{ 
+    (void)ctx; 
+    (*v)++; 
+}
+
+static void *conc_worker(void *arg) 
+{
+    int base = (int)(intptr_t)arg * CONC_PER_THREAD;
+    for (int i = 0; i < CONC_PER_THREAD; i++) 
+    {
+        zmap_concurrent_put(&conc_map, base + i, base + i);
+        zmap_concurrent_upsert(&conc_map, -1 - (i % 16), 1, conc_incr, NULL);
+    }
+    for (int i = 0; i < CONC_PER_THREAD; i += 2) 
+    {
+        zmap_concurrent_remove(&conc_map, base + i);
+    }
+    return NULL;
+}
+
+void test_concurrent_map(void) 
+{
+    TEST("Sharded Concurrent Map");
+
+    assert(zmap_init_concurrent(IntInt, &conc_map, hash_int, cmp_int, 6) == Z_OK);
+    assert(conc_map.shard_count == 8);
+
+    pthread_t threads[CONC_THREADS];
+    for (intptr_t t = 0; t < CONC_THREADS; t++) 
+    {
+        assert(0 == pthread_create(&threads[t], NULL, conc_worker, (void*)t));
+    }
+    for (int t = 0; t < CONC_THREADS; t++) 
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Odd keys survive; the 16 shared counters saw every upsert exactly once.
+    assert(zmap_concurrent_size(&conc_map) == CONC_THREADS * CONC_PER_THREAD / 2 + 16);
+
+    // hash_int is k ^ seed: sequential keys share their high bits, yet every
+    // shard gets a share and each shard's table still spreads its keys.
+    size_t conc_total = zmap_concurrent_size(&conc_map);
+    for (size_t i = 0; i < conc_map.shard_count; i++) 
+    {
+        zmap_stats st;
+        zmap_stats_IntInt_shard(&conc_map.shards[i].map, &st);
+        assert(st.count > 0 && st.count < conc_total / 2);
+        assert(st.hash_quality > 0.9);
+    }
+    int v, total = 0;
+    for (int k = 1; k < CONC_THREADS * CONC_PER_THREAD; k += 2) 
+    {
+        assert(zmap_concurrent_get(&conc_map, k, &v) && v == k);
+        assert(!zmap_concurrent_get(&conc_map, k - 1, NULL));
+    }
+    for (int k = -1; k >= -16; k--) 
+    {
+        assert(zmap_concurrent_get(&conc_map, k, &v));
+        total += v;
+    }
+    assert(total == CONC_THREADS * CONC_PER_THREAD);
+
+    assert(zmap_concurrent_remove(&conc_map, 1) == true);
+    assert(zmap_concurrent_remove(&conc_map, 1) == false);
+
+    zmap_concurrent_clear(&conc_map);
+    assert(zmap_concurrent_size(&conc_map) == 0);
+    zmap_concurrent_free(&conc_map);
+    PASS();
+}
+
+#define SEQ_KEYS 50000
+
+static zmap_seqlock_IntInt seq_map;
+static int seq_done;
+
+static void *seq_reader(void *arg) 
+{
+    (void)arg;
+    size_t hits = 0;
+    while (!__atomic_load_n(&seq_done, __ATOMIC_ACQUIRE)) 
+    {
+        for (int k = 0; k < SEQ_KEYS; k += 97) 
+        {
+            int v;
+            if (zmap_concurrent_get(&seq_map, k, &v)) 
+            {
+                assert(v == k * 2);   // Never a torn or stale-table value.
+                hits++;
+            }
+        }
+    }
+    return (void*)hits;
+}
+
+void test_seqlock_map(void) 
+{
+    TEST("Seqlock Map (Lock-Free Readers)");
+
+    assert(zmap_init_seqlock(IntInt, &seq_map, hash_int, cmp_int) == Z_OK);
+
+    pthread_t readers[3];
+    for (int t = 0; t < 3; t++) 
+    {
+        assert(0 == pthread_create(&readers[t], NULL, seq_reader, NULL));
+    }
+
+    // The writer grows the table through many resizes while readers probe it.
+    for (int k = 0; k < SEQ_KEYS; k++) 
+    {
+        assert(zmap_concurrent_put(&seq_map, k, k * 2) == Z_OK);
+    }
+    for (int k = 0; k < SEQ_KEYS; k += 2) 
+    {
+        assert(zmap_concurrent_remove(&seq_map, k));
+    }
+    __atomic_store_n(&seq_done, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < 3; t++) 
+    {
+        pthread_join(readers[t], NULL);
+    }
+
+    // Each reader thread claimed a slot of its own, and every count is back to zero.
+    int owned = 0;
+    for (size_t i = 0; i < (1u << ZMAP_SEQ_SLOT_BITS); i++) 
+    {
+        zmap_seq_slot *sl = &seq_map.slots[i];
+        owned += (0 != sl->owner);
+        assert(!sl->readers[0] && !sl->readers[1] && !sl->shared[0] && !sl->shared[1]);
+    }
+    assert(owned == ((1u << ZMAP_SEQ_SLOT_BITS) < 3 ? (1 << ZMAP_SEQ_SLOT_BITS) : 3));
+
+    assert(zmap_concurrent_size(&seq_map) == SEQ_KEYS / 2);
+    int v;
+    assert(zmap_concurrent_get(&seq_map, 1, &v) && v == 2);
+    assert(!zmap_concurrent_get(&seq_map, 2, &v));
+    assert(zmap_concurrent_upsert(&seq_map, 2, 7, NULL, NULL) == Z_OK);
+    assert(zmap_concurrent_get(&seq_map, 2, &v) && v == 7);
+
+    zmap_concurrent_clear(&seq_map);
+    assert(zmap_concurrent_size(&seq_map) == 0 && !zmap_concurrent_get(&seq_map, 1, NULL));
+    zmap_concurrent_free(&seq_map);
+    PASS();
+}
+
 int main(void) 
 {
     printf("=> Running tests (zmap.h, C)\n");
@@ -143,6 +1243,30 @@ int main(void)
     test_collisions_and_resize();
     test_strings();
     test_iterators();
+    test_custom_allocator();
+    test_hugepage_allocator();
+    test_frozen_snapshot();
+    test_perfect_hash();
+    test_stable_arena();
+    test_group_probing();
+    test_soa_layout();
+    test_inline_hash();
+    test_get_many();
+    test_put_many();
+    test_reserve_shrink();
+    test_stats();
+    test_rehash();
+    test_memory_usage();
+#ifdef ZMAP_ENABLE_COUNTERS
+    test_counters();
+#endif
+    test_get_or_insert();
+    test_ref_keys();
+    test_hash_width();
+    test_sets();
+    test_incremental_resize();
+    test_concurrent_map();
+    test_seqlock_map();
     printf("=> All tests passed successfully.\n");
     return 0;
 }
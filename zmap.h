@@ -160,6 +160,10 @@
  * • Two storage modes:
  * 1. Standard: Keys/Values stored inline (fastest, cache-friendly)
  * 2. Stable: Values stored via pointer (stable addresses, like std::map)
+ * • Group maps: one-byte control metadata scanned 16 slots at a time (SSE2)
+ * • Incremental maps: resize migrates a few buckets per operation (no pauses)
+ * • Concurrent maps: power-of-two shards, each with its own reader/writer lock
+ * • Seqlock maps: lock-free readers, serialized writers, epoch-based reclamation
  * • C++ z_map::map<K,V> with RAII and STL-compatible iterators
  * • C++ complex type support (constructors/destructors called)
  * • Allocation failure returns Z_ENOMEM (fast path)
@@ -174,9 +178,48 @@
 #define ZMAP_H
 // [Bundled] "zcommon.h" is included inline in this same file
 #include <string.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+// SIMD control-byte scanning for group maps (16 slots per compare).
+#if !defined(ZMAP_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   include <emmintrin.h>
+#   define ZMAP_HAS_SSE2 1
+#else
+#   define ZMAP_HAS_SSE2 0
+#endif
+
+// Reader/writer lock for concurrent maps. Define ZMAP_RWLOCK_T and the other
+// ZMAP_RWLOCK_* macros to plug in a different primitive (e.g. a spinlock).
+#ifndef ZMAP_RWLOCK_T
+#   if defined(_WIN32)
+#       ifndef WIN32_LEAN_AND_MEAN
+#           define WIN32_LEAN_AND_MEAN
+#       endif
+#       ifndef NOMINMAX
+#           define NOMINMAX
+#       endif
+#       include <windows.h>
+#       define ZMAP_RWLOCK_T            SRWLOCK
+#       define ZMAP_RWLOCK_INIT(l)      (InitializeSRWLock(l), 0)
+#       define ZMAP_RWLOCK_DESTROY(l)   ((void)(l))
+#       define ZMAP_RWLOCK_RDLOCK(l)    AcquireSRWLockShared(l)
+#       define ZMAP_RWLOCK_RDUNLOCK(l)  ReleaseSRWLockShared(l)
+#       define ZMAP_RWLOCK_WRLOCK(l)    AcquireSRWLockExclusive(l)
+#       define ZMAP_RWLOCK_WRUNLOCK(l)  ReleaseSRWLockExclusive(l)
+#   else
+#       include <pthread.h>
+#       define ZMAP_RWLOCK_T            pthread_rwlock_t
+#       define ZMAP_RWLOCK_INIT(l)      pthread_rwlock_init((l), NULL)
+#       define ZMAP_RWLOCK_DESTROY(l)   pthread_rwlock_destroy(l)
+#       define ZMAP_RWLOCK_RDLOCK(l)    pthread_rwlock_rdlock(l)
+#       define ZMAP_RWLOCK_RDUNLOCK(l)  pthread_rwlock_unlock(l)
+#       define ZMAP_RWLOCK_WRLOCK(l)    pthread_rwlock_wrlock(l)
+#       define ZMAP_RWLOCK_WRUNLOCK(l)  pthread_rwlock_unlock(l)
+#   endif
+#endif
+
 #if defined(__has_include) && __has_include("zerror.h")
 #   include "zerror.h"
 #   define Z_HAS_ZERROR 1
@@ -186,11 +229,118 @@
 #   define Z_HAS_ZERROR 0
 #endif
 
+/* Hash width. Define ZMAP_HASH_64 for 64-bit hashes end to end: callbacks return
+ * uint64_t, buckets store the full 64-bit hash and bucket indices come from a
+ * 64-bit Fibonacci multiply. Use it for tables past ~2^32 buckets, where 32-bit
+ * hashes run out of distinct home slots and start to cluster. */
+#ifdef ZMAP_HASH_64
+    typedef uint64_t zmap_hash_t;
+#   define ZMAP_HASH_BITS 64
+#else
+    typedef uint32_t zmap_hash_t;
+#   define ZMAP_HASH_BITS 32
+#endif
+
+/* Per-map allocator. A NULL `alloc` means the global ZMAP_CALLOC/ZMAP_FREE.
+ * `alloc` returns storage aligned like malloc (or NULL); `free` receives the
+ * size that was requested and may be NULL for arenas that are reset wholesale. */
+typedef struct
+{
+    void *(*alloc)(void *ctx, size_t size);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+} zmap_allocator;
+
+/* Probe and occupancy statistics filled by zmap_stats. probe_hist[d] counts
+ * entries displaced d slots from their home slot; the last bin collects the rest.
+ * hash_quality compares the number of distinct home slots with what a uniform
+ * hash would reach for the same count: ~1.0 is healthy, well below means the
+ * hash function maps many keys onto few homes. */
+#ifndef ZMAP_STATS_BINS
+#   define ZMAP_STATS_BINS 16
+#endif
+
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+    double load;
+    size_t memory_bytes;
+    double mean_probe;
+    size_t max_probe;
+    size_t probe_hist[ZMAP_STATS_BINS];
+    size_t longest_cluster;
+    size_t distinct_homes;
+    double hash_quality;
+} zmap_stats;
+
+/* Per-map operation counters, compiled in only with ZMAP_ENABLE_COUNTERS.
+ * Without the flag maps carry no counter field and no counting code. */
+typedef struct
+{
+    uint64_t puts;          // Inserts and overwrites.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t removes;       // Keys actually removed.
+    uint64_t resizes;
+    uint64_t probes;        // Slots stepped past while probing.
+    uint64_t resize_ns;     // Time spent rehashing.
+} zmap_counters;
+
+#ifdef ZMAP_ENABLE_COUNTERS
+#   include <time.h>
+
+static inline uint64_t zmap_counter_now(void)
+{
+#   if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#   else
+    return (uint64_t)clock() * (1000000000ull / CLOCKS_PER_SEC);
+#   endif
+}
+
+// Fallback for zmap_counters on a type without counters.
+static inline zmap_counters zmap_counters_none(const void *m)
+{
+    zmap_counters c;
+    (void)m;
+    memset(&c, 0, sizeof(c));
+    return c;
+}
+
+#   define ZMAP_COUNTERS_FIELD          zmap_counters counters;
+#   define ZMAP_COUNTERS_INIT           , .counters = { 0, 0, 0, 0, 0, 0, 0 }
+#   define ZMAP_COUNT(m, field, n)      ((m)->counters.field += (n))
+#   define ZMAP_COUNT_TIMER(t)          uint64_t t = zmap_counter_now();
+#   define ZMAP_COUNT_RESIZE(m, t)      ((m)->counters.resizes++, (m)->counters.resize_ns += zmap_counter_now() - (t))
+#   define ZMAP_COUNTERS_API(Name)                                                                  \
+        static inline zmap_counters zmap_counters_##Name(zmap_##Name *m)                           \
+        {                                                                                           \
+            return m->counters;                                                                     \
+        }                                                                                           \
+                                                                                                    \
+        static inline void zmap_reset_counters_##Name(zmap_##Name *m)                              \
+        {                                                                                           \
+            memset(&m->counters, 0, sizeof(m->counters));                                           \
+        }
+#else
+#   define ZMAP_COUNTERS_FIELD
+#   define ZMAP_COUNTERS_INIT
+#   define ZMAP_COUNT(m, field, n)      ((void)0)
+#   define ZMAP_COUNT_TIMER(t)
+#   define ZMAP_COUNT_RESIZE(m, t)      ((void)0)
+#   define ZMAP_COUNTERS_API(Name)
+#endif
+
 // Shared enum.
 typedef enum
 {
     ZMAP_EMPTY = 0,
-    ZMAP_OCCUPIED
+    ZMAP_OCCUPIED,
+    ZMAP_MOVED,     // Incremental maps: old bucket already migrated or removed.
+    ZMAP_PENDING    // zmap_rehash: hashed with the new seed, not yet re-placed.
 } zmap_state;
 
 // C++ interop preamble.
@@ -201,19 +351,225 @@ typedef enum
 #include <type_traits>
 #include <new>
 #include <algorithm>
+#include <memory>
+#include <cstddef>
 
 namespace z_map
 {
     // Forward declarations.
-    template <typename K, typename V> struct map;
+    template <typename K, typename V, typename Hash = void, typename Eq = void, typename Alloc = void> struct map;
+    template <typename K, typename V, typename Hash = void, typename Eq = void> class concurrent_map;
+    template <typename K, typename Hash = void, typename Eq = void> class set;
     template <typename K, typename V> class map_iterator;
 
+    // Array helpers used by the language-neutral generators.
+    namespace detail
+    {
+        template <typename T>
+        static inline T *new_array(size_t n)
+        {
+            return new (std::nothrow) T[n]();
+        }
+
+        template <typename T>
+        static inline void delete_array(T *p)
+        {
+            delete[] p;
+        }
+
+        template <typename T>
+        static inline void reset(T &x)
+        {
+            x = T();
+        }
+
+        template <typename T>
+        static inline void destroy(T *p)
+        {
+            p->~T();
+        }
+
+        // Arrays drawn from a zmap_allocator; without one, plain new[]/delete[].
+        template <typename T>
+        static inline T *alloc_array(const zmap_allocator *a, size_t n)
+        {
+            if (!a->alloc)
+            {
+                return new_array<T>(n);
+            }
+            if (n > SIZE_MAX / sizeof(T))
+            {
+                return nullptr;
+            }
+            T *p = static_cast<T*>(a->alloc(a->ctx, n * sizeof(T)));
+            if (!p)
+            {
+                return nullptr;
+            }
+            size_t i = 0;
+            try
+            {
+                for (; i < n; i++)
+                {
+                    new (p + i) T();
+                }
+            }
+            catch (...)
+            {
+                while (i > 0)
+                {
+                    p[--i].~T();
+                }
+                if (a->free)
+                {
+                    a->free(a->ctx, p, n * sizeof(T));
+                }
+                return nullptr;
+            }
+            return p;
+        }
+
+        template <typename T>
+        static inline void free_array(const zmap_allocator *a, T *p, size_t n)
+        {
+            if (!a->alloc)
+            {
+                delete[] p;
+                return;
+            }
+            if (!p)
+            {
+                return;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                p[i].~T();
+            }
+            if (a->free)
+            {
+                a->free(a->ctx, p, n * sizeof(T));
+            }
+        }
+
+        // How keys cross into the generated C functions: by value, or as `const K *`
+        // for maps registered through REGISTER_ZMAP_REF_TYPES.
+        template <typename K>
+        struct key_by_value
+        {
+            using arg = K;
+            static const K &pass(const K &k) { return k; }
+            static const K &deref(const K &k) { return k; }
+        };
+
+        template <typename K>
+        struct key_by_ref
+        {
+            using arg = const K *;
+            static const K *pass(const K &k) { return &k; }
+            static const K &deref(const K *k) { return *k; }
+        };
+
+        // Adapt hash/equality functors to the C callback signatures.
+        template <typename K, typename Hash, typename Pass = key_by_value<K>>
+        struct functor_hash
+        {
+            using arg = typename Pass::arg;
+            static zmap_hash_t call(arg k, uint32_t s) { return Hash{}(Pass::deref(k), s); }
+            static zmap_hash_t (*get())(arg, uint32_t) { return &call; }
+        };
+
+        template <typename K, typename Pass>
+        struct functor_hash<K, void, Pass>
+        {
+            static decltype(nullptr) get() { return nullptr; }
+        };
+
+        template <typename K, typename Eq, typename Pass = key_by_value<K>>
+        struct functor_cmp
+        {
+            using arg = typename Pass::arg;
+            static int call(arg a, arg b) { return Eq{}(Pass::deref(a), Pass::deref(b)) ? 0 : 1; }
+            static int (*get())(arg, arg) { return &call; }
+        };
+
+        template <typename K, typename Pass>
+        struct functor_cmp<K, void, Pass>
+        {
+            static decltype(nullptr) get() { return nullptr; }
+        };
+
+        // Routes a map's buckets through a std-style allocator, rebound to
+        // max_align_t units. The void specialization keeps the C allocator.
+        template <typename Alloc>
+        struct alloc_bridge
+        {
+            using allocator_type = Alloc;
+            using unit = std::max_align_t;
+            using unit_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<unit>;
+            using unit_traits = std::allocator_traits<unit_alloc>;
+
+            unit_alloc alloc;
+
+            alloc_bridge() : alloc() {}
+            explicit alloc_bridge(const Alloc &a) : alloc(a) {}
+
+            static size_t units(size_t size) { return (size + sizeof(unit) - 1) / sizeof(unit); }
+
+            static void *allocate(void *ctx, size_t size)
+            {
+                try
+                {
+                    return unit_traits::allocate(static_cast<alloc_bridge*>(ctx)->alloc, units(size));
+                }
+                catch (...)
+                {
+                    return nullptr;
+                }
+            }
+
+            static void deallocate(void *ctx, void *p, size_t size)
+            {
+                unit_traits::deallocate(static_cast<alloc_bridge*>(ctx)->alloc, static_cast<unit*>(p), units(size));
+            }
+
+            void bind(zmap_allocator &a)
+            {
+                a.alloc = &allocate;
+                a.free = &deallocate;
+                a.ctx = this;
+            }
+        };
+
+        template <>
+        struct alloc_bridge<void>
+        {
+            struct allocator_type {};
+
+            alloc_bridge() {}
+            explicit alloc_bridge(const allocator_type &) {}
+
+            void bind(zmap_allocator &) {}
+        };
+    }
+
     template <typename K, typename V>
     struct traits
     {
         static_assert(0 == sizeof(K), "No zmap implementation registered for this key/value pair.");
     };
 
+    template <typename K, typename V>
+    struct concurrent_traits
+    {
+        static_assert(0 == sizeof(K), "No concurrent zmap registered for this key/value pair.");
+    };
+
+    template <typename K>
+    struct set_traits
+    {
+        static_assert(0 == sizeof(K), "No zset registered for this key type.");
+    };
+
     template <typename K, typename V>
     class map_iterator
     {
@@ -295,28 +651,66 @@ namespace z_map
         size_t index;
     };
 
-    template <typename K, typename V>
-    struct map
+    template <typename K, typename V, typename Hash, typename Eq, typename Alloc>
+    struct map : private detail::alloc_bridge<Alloc>
     {
         using Traits = traits<K, V>;
         using c_map = typename Traits::map_type;
         using iterator = map_iterator<K, V>;
+
+        // An inline registration bakes HASH/EQ into the generated code, where Hash/Eq would be ignored.
+        static_assert(!Traits::baked || (std::is_void<Hash>::value && std::is_void<Eq>::value),
+                      "z_map::map: Hash/Eq functors cannot be combined with an inline-registered key/value pair.");
         using const_iterator = map_iterator<const K, const V>;
 
         c_map inner;
 
-        using HashFunc = uint32_t (*)(K, uint32_t);
-        using CmpFunc = int (*)(K, K);
+        using Pass = typename Traits::key_pass;
+        using HashFunc = zmap_hash_t (*)(typename Pass::arg, uint32_t);
+        using CmpFunc = int (*)(typename Pass::arg, typename Pass::arg);
+        using Bridge = detail::alloc_bridge<Alloc>;
+        using allocator_type = typename Bridge::allocator_type;
 
         map(HashFunc h, CmpFunc c, uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f) 
             : inner(Traits::init(h, c, load_factor)) 
         {
             Traits::set_seed(&inner, seed);
+            Bridge::bind(inner.alloc);
+        }
+
+        map(HashFunc h, CmpFunc c, const allocator_type &a, uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f)
+            : Bridge(a), inner(Traits::init(h, c, load_factor))
+        {
+            Traits::set_seed(&inner, seed);
+            Bridge::bind(inner.alloc);
+        }
+
+        // For inline-registered types or Hash/Eq functor parameters.
+        explicit map(uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f)
+            : inner(Traits::init(detail::functor_hash<K, Hash, Pass>::get(), detail::functor_cmp<K, Eq, Pass>::get(), load_factor))
+        {
+            static_assert(Traits::baked || (!std::is_void<Hash>::value && !std::is_void<Eq>::value),
+                          "z_map::map needs hash/compare functions, Hash/Eq functors or an inline registration.");
+            Traits::set_seed(&inner, seed);
+            Bridge::bind(inner.alloc);
+        }
+
+        explicit map(const allocator_type &a, uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f)
+            : Bridge(a),
+              inner(Traits::init(detail::functor_hash<K, Hash, Pass>::get(), detail::functor_cmp<K, Eq, Pass>::get(), load_factor))
+        {
+            static_assert(Traits::baked || (!std::is_void<Hash>::value && !std::is_void<Eq>::value),
+                          "z_map::map needs hash/compare functions, Hash/Eq functors or an inline registration.");
+            Traits::set_seed(&inner, seed);
+            Bridge::bind(inner.alloc);
         }
 
-        map(map &&other) noexcept : inner(other.inner) 
+        // The moved-from map keeps its own allocator, so it stays usable.
+        map(map &&other) noexcept : Bridge(static_cast<const Bridge&>(other)), inner(other.inner) 
         {
             other.inner = Traits::init(inner.hash_func, inner.cmp_func, inner.load_factor);
+            other.inner.alloc = inner.alloc;
+            Bridge::bind(inner.alloc);
         }
 
         ~map()
@@ -329,8 +723,11 @@ namespace z_map
             if (this != &other) 
             {
                 Traits::free(&inner);
+                Bridge::operator=(static_cast<const Bridge&>(other));
                 inner = other.inner;
                 other.inner = Traits::init(inner.hash_func, inner.cmp_func, inner.load_factor);
+                other.inner.alloc = inner.alloc;
+                Bridge::bind(inner.alloc);
             }
             return *this;
         }
@@ -340,7 +737,16 @@ namespace z_map
 
         void put(const K &key, const V &val) 
         {
-            if (Z_OK != Traits::put(&inner, key, val))
+            if (Z_OK != Traits::put(&inner, Pass::pass(key), val))
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        // Bulk insert: reserves room for all n pairs, then inserts with prefetching.
+        void put_many(const K *keys, const V *vals, size_t n)
+        {
+            if (Z_OK != Traits::put_many(&inner, keys, vals, n))
             {
                 throw std::bad_alloc();
             }
@@ -353,28 +759,54 @@ namespace z_map
 
         V *get(const K &key)
         {
-            return Traits::get(&inner, key);
+            return Traits::get(&inner, Pass::pass(key));
         }
 
         const V *get(const K &key) const
         {
-            return Traits::get((c_map*)&inner, key);
+            return Traits::get((c_map*)&inner, Pass::pass(key));
+        }
+
+        // Batched lookup with prefetching; out[i] is nullptr on a miss. Returns hits.
+        size_t get_many(const K *keys, size_t n, V **out)
+        {
+            return Traits::get_many(&inner, keys, n, out);
         }
 
         bool contains(const K &key) const
         {
-            return NULL != Traits::get((c_map*)&inner, key);
+            return NULL != Traits::get((c_map*)&inner, Pass::pass(key));
         }
 
-        V &operator[](const K &key)
+        // Stores V(args...) only if key is absent, in a single probe; on a hit no V
+        // is constructed. Returns the value pointer and whether an insert happened.
+        template <typename... Args>
+        std::pair<V*, bool> try_emplace(const K &key, Args&&... args)
         {
-            V *ptr = get(key);
+            bool inserted = false;
+            V *ptr = Traits::insert_slot(&inner, Pass::pass(key), &inserted);
             if (!ptr)
             {
-                put(key, V{});
-                ptr = get(key);
+                throw std::bad_alloc();
             }
-            return *ptr;
+            if (inserted)
+            {
+                try
+                {
+                    *ptr = V(std::forward<Args>(args)...);
+                }
+                catch (...)
+                {
+                    Traits::remove(&inner, Pass::pass(key));
+                    throw;
+                }
+            }
+            return std::pair<V*, bool>(ptr, inserted);
+        }
+
+        V &operator[](const K &key)
+        {
+            return *try_emplace(key).first;
         }
 
         V &at(const K &key)
@@ -389,7 +821,7 @@ namespace z_map
 
         void erase(const K &key)
         {
-            Traits::remove(&inner, key);
+            Traits::remove(&inner, Pass::pass(key));
         }
 
         void clear()
@@ -397,6 +829,62 @@ namespace z_map
             Traits::clear(&inner);
         }
 
+        // Sizes the table for n elements under the current load factor.
+        void reserve(size_t n)
+        {
+            if (Z_OK != Traits::reserve(&inner, n))
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        // Rehashes down to the smallest capacity that fits size(); frees everything when empty.
+        void shrink_to_fit()
+        {
+            if (Z_OK != Traits::shrink(&inner))
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        size_t capacity() const
+        {
+            return inner.capacity;
+        }
+
+        // Moves every entry to a new seed in place (see zmap_rehash). Named apart
+        // from std::unordered_map::rehash, which takes a bucket count.
+        void reseed(uint32_t seed)
+        {
+            Traits::rehash(&inner, seed);
+        }
+
+        // Probe and occupancy statistics (see zmap_stats). Scans every bucket.
+        zmap_stats stats() const
+        {
+            zmap_stats s;
+            Traits::stats((c_map*)&inner, &s);
+            return s;
+        }
+
+        // Bytes held by the map object and its bucket array.
+        size_t memory_usage() const
+        {
+            return Traits::memory_usage((c_map*)&inner);
+        }
+
+#ifdef ZMAP_ENABLE_COUNTERS
+        zmap_counters counters() const
+        {
+            return inner.counters;
+        }
+
+        void reset_counters()
+        {
+            inner.counters = zmap_counters();
+        }
+#endif
+
         size_t size() const
         {
             return inner.count;
@@ -427,58 +915,363 @@ namespace z_map
             return const_iterator((c_map *)&inner, inner.capacity);
         }
     };
-}
-extern "C" {
-#endif // __cplusplus
-
-// Configuration and allocators.
-
-#ifndef ZMAP_MALLOC
-#   define ZMAP_MALLOC(sz)      Z_MALLOC(sz)
-#endif
 
-#ifndef ZMAP_CALLOC
-#   define ZMAP_CALLOC(n, sz)   Z_CALLOC(n, sz)
-#endif
+    // Sharded map safe for concurrent use. Not copyable or movable: other
+    // threads may hold a reference to it.
+    template <typename K, typename V, typename Hash, typename Eq>
+    class concurrent_map
+    {
+    public:
+        using Traits = concurrent_traits<K, V>;
+        using c_map = typename Traits::map_type;
+        using HashFunc = zmap_hash_t (*)(K, uint32_t);
+        using CmpFunc = int (*)(K, K);
 
-#ifndef ZMAP_REALLOC
-#   define ZMAP_REALLOC(p, sz)  Z_REALLOC(p, sz)
-#endif
+        // shards == 0 selects ZMAP_DEFAULT_SHARDS.
+        concurrent_map(HashFunc h, CmpFunc c, size_t shards = 0)
+        {
+            if (Z_OK != Traits::init(&inner, h, c, shards))
+            {
+                throw std::bad_alloc();
+            }
+        }
 
-#ifndef ZMAP_FREE
-#   define ZMAP_FREE(p)         Z_FREE(p)
-#endif
+        explicit concurrent_map(size_t shards = 0)
+        {
+            static_assert(!std::is_void<Hash>::value && !std::is_void<Eq>::value,
+                          "z_map::concurrent_map needs hash/compare functions or Hash/Eq functors.");
+            if (Z_OK != Traits::init(&inner, detail::functor_hash<K, Hash>::get(),
+                                     detail::functor_cmp<K, Eq>::get(), shards))
+            {
+                throw std::bad_alloc();
+            }
+        }
 
-// Load factor configuration.
-#define ZMAP_DEFAULT_LOAD 0.85f
+        ~concurrent_map()
+        {
+            Traits::free(&inner);
+        }
 
-// Hashing helpers.
-#if defined(__has_include) && __has_include("zhash.h")
-#   include "zhash.h"
-#   define ZMAP_HAS_ZHASH 1
-#elif defined(ZHASH_H)
-#   define ZMAP_HAS_ZHASH 1
-#else
-#   define ZMAP_HAS_ZHASH 0
-#endif
+        concurrent_map(const concurrent_map&) = delete;
+        concurrent_map &operator=(const concurrent_map&) = delete;
 
-#ifndef ZMAP_HASH_FUNC
-#   if ZMAP_HAS_ZHASH
-#       define ZMAP_HASH_FUNC(key, len, seed) zhash_fast(key, len, seed)
-#   else
-        // FNV-1a inline fallback.
-        static inline uint32_t zmap_default_hash(const void *key, size_t len, uint32_t seed) 
+        void put(const K &key, const V &val)
         {
-            uint32_t hash = 2166136261u ^ seed;
-            const uint8_t *data = (const uint8_t *)key;
-            for (size_t i = 0; i < len; i++)
+            if (Z_OK != Traits::put(&inner, key, val))
             {
-                hash ^= data[i];
-                hash *= 16777619;
+                throw std::bad_alloc();
             }
-            return hash;
         }
-        #define ZMAP_HASH_FUNC(key, len, seed) zmap_default_hash(key, len, seed)
+
+        // Copies the value into `out`. Returns false if the key is absent.
+        bool get(const K &key, V &out)
+        {
+            return Traits::get(&inner, key, &out);
+        }
+
+        bool contains(const K &key)
+        {
+            return Traits::get(&inner, key, nullptr);
+        }
+
+        bool erase(const K &key)
+        {
+            return Traits::remove(&inner, key);
+        }
+
+        // Inserts `init` if the key is absent, otherwise calls fn(V&) under the
+        // shard lock. fn must not throw or touch this map.
+        template <typename F>
+        void upsert(const K &key, const V &init, F fn)
+        {
+            if (Z_OK != Traits::upsert(&inner, key, init, &upsert_thunk<F>, &fn))
+            {
+                throw std::bad_alloc();
+            }
+        }
+
+        void clear()
+        {
+            Traits::clear(&inner);
+        }
+
+        size_t size()
+        {
+            return Traits::size(&inner);
+        }
+
+    private:
+        template <typename F>
+        static void upsert_thunk(V *val, void *ctx)
+        {
+            (*static_cast<F*>(ctx))(*val);
+        }
+
+        c_map inner;
+    };
+
+    // Keys-only hash set. Iteration yields const keys in table order.
+    template <typename K, typename Hash, typename Eq>
+    class set
+    {
+    public:
+        using Traits = set_traits<K>;
+        using c_set = typename Traits::set_type;
+        using HashFunc = zmap_hash_t (*)(K, uint32_t);
+        using CmpFunc = int (*)(K, K);
+
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = K;
+            using difference_type = ptrdiff_t;
+            using reference = const K&;
+            using pointer = const K*;
+
+            const_iterator(const c_set *s, size_t idx) : set_ptr(s), index(idx)
+            {
+                advance();
+            }
+
+            reference operator*() const
+            {
+                return set_ptr->keys[index];
+            }
+
+            pointer operator->() const
+            {
+                return &set_ptr->keys[index];
+            }
+
+            bool operator==(const const_iterator &other) const
+            {
+                return set_ptr == other.set_ptr && index == other.index;
+            }
+
+            bool operator!=(const const_iterator &other) const
+            {
+                return !(*this == other);
+            }
+
+            const_iterator &operator++()
+            {
+                index++;
+                advance();
+                return *this;
+            }
+
+            const_iterator operator++(int)
+            {
+                const_iterator temp = *this;
+                ++(*this);
+                return temp;
+            }
+
+        private:
+            void advance()
+            {
+                while (index < set_ptr->capacity && 0 == set_ptr->meta[index])
+                {
+                    index++;
+                }
+            }
+
+            const c_set *set_ptr;
+            size_t index;
+        };
+
+        using iterator = const_iterator;
+
+        set(HashFunc h, CmpFunc c, uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f)
+            : inner(Traits::init(h, c, load_factor))
+        {
+            Traits::set_seed(&inner, seed);
+        }
+
+        explicit set(uint32_t seed = 0xCAFEBABE, float load_factor = 0.85f)
+            : inner(Traits::init(detail::functor_hash<K, Hash>::get(), detail::functor_cmp<K, Eq>::get(), load_factor))
+        {
+            static_assert(!std::is_void<Hash>::value && !std::is_void<Eq>::value,
+                          "z_map::set needs hash/compare functions or Hash/Eq functors.");
+            Traits::set_seed(&inner, seed);
+        }
+
+        set(set &&other) noexcept : inner(other.inner)
+        {
+            other.inner = Traits::init(inner.hash_func, inner.cmp_func, inner.load_factor);
+        }
+
+        set &operator=(set &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Traits::free(&inner);
+                inner = other.inner;
+                other.inner = Traits::init(inner.hash_func, inner.cmp_func, inner.load_factor);
+            }
+            return *this;
+        }
+
+        ~set()
+        {
+            Traits::free(&inner);
+        }
+
+        set(const set&) = delete;
+        set &operator=(const set&) = delete;
+
+        // Returns true if the key was added, false if it was already present.
+        bool insert(const K &key)
+        {
+            int rc = Traits::insert(&inner, key);
+            if (Z_ENOMEM == rc)
+            {
+                throw std::bad_alloc();
+            }
+            return Z_OK == rc;
+        }
+
+        bool contains(const K &key) const
+        {
+            return Traits::contains((c_set*)&inner, key);
+        }
+
+        bool erase(const K &key)
+        {
+            return Traits::remove(&inner, key);
+        }
+
+        void clear()
+        {
+            Traits::clear(&inner);
+        }
+
+        size_t size() const
+        {
+            return inner.count;
+        }
+
+        bool empty() const
+        {
+            return 0 == inner.count;
+        }
+
+        // Bytes held by the set object and its key and metadata arrays.
+        size_t memory_usage() const
+        {
+            return Traits::memory_usage((c_set*)&inner);
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(&inner, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(&inner, inner.capacity);
+        }
+
+    private:
+        c_set inner;
+    };
+}
+extern "C" {
+#endif // __cplusplus
+
+// Configuration and allocators.
+
+#ifndef ZMAP_MALLOC
+#   define ZMAP_MALLOC(sz)      Z_MALLOC(sz)
+#endif
+
+#ifndef ZMAP_CALLOC
+#   define ZMAP_CALLOC(n, sz)   Z_CALLOC(n, sz)
+#endif
+
+#ifndef ZMAP_REALLOC
+#   define ZMAP_REALLOC(p, sz)  Z_REALLOC(p, sz)
+#endif
+
+#ifndef ZMAP_FREE
+#   define ZMAP_FREE(p)         Z_FREE(p)
+#endif
+
+// Load factor configuration.
+#define ZMAP_DEFAULT_LOAD 0.85f
+
+// Batch operations: keys hashed and prefetched ahead of the one being resolved (power of two).
+#ifndef ZMAP_BATCH_WINDOW
+#   define ZMAP_BATCH_WINDOW 16
+#endif
+
+// Concurrent maps: default shard count, and padding between shards against false sharing.
+#ifndef ZMAP_DEFAULT_SHARDS
+#   define ZMAP_DEFAULT_SHARDS 64
+#endif
+
+#ifndef ZMAP_CACHE_LINE
+#   define ZMAP_CACHE_LINE 64
+#endif
+
+// Stable-map arenas: values per slab, doubling from MIN up to MAX chunks.
+#ifndef ZMAP_ARENA_MIN_CHUNKS
+#   define ZMAP_ARENA_MIN_CHUNKS 64
+#endif
+
+#ifndef ZMAP_ARENA_MAX_CHUNKS
+#   define ZMAP_ARENA_MAX_CHUNKS 65536
+#endif
+
+// Incremental maps: old buckets migrated per put/remove while a resize is in flight.
+#ifndef ZMAP_INCR_STEP
+#   define ZMAP_INCR_STEP 64
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define ZMAP_PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#elif ZMAP_HAS_SSE2
+#   define ZMAP_PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#   define ZMAP_PREFETCH(addr) ((void)(addr))
+#endif
+
+// Hashing helpers.
+#if defined(__has_include) && __has_include("zhash.h")
+#   include "zhash.h"
+#   define ZMAP_HAS_ZHASH 1
+#elif defined(ZHASH_H)
+#   define ZMAP_HAS_ZHASH 1
+#else
+#   define ZMAP_HAS_ZHASH 0
+#endif
+
+#ifndef ZMAP_HASH_FUNC
+#   if ZMAP_HAS_ZHASH && defined(ZMAP_HASH_64)
+#       define ZMAP_HASH_FUNC(key, len, seed) zhash_wyhash(key, len, seed)
+#   elif ZMAP_HAS_ZHASH
+#       define ZMAP_HASH_FUNC(key, len, seed) zhash_fast(key, len, seed)
+#   else
+        // FNV-1a inline fallback.
+        static inline zmap_hash_t zmap_default_hash(const void *key, size_t len, uint32_t seed) 
+        {
+#       ifdef ZMAP_HASH_64
+            uint64_t hash = 14695981039346656037ull ^ seed;
+            const uint64_t prime = 1099511628211ull;
+#       else
+            uint32_t hash = 2166136261u ^ seed;
+            const uint32_t prime = 16777619u;
+#       endif
+            const uint8_t *data = (const uint8_t *)key;
+            for (size_t i = 0; i < len; i++)
+            {
+                hash ^= data[i];
+                hash *= prime;
+            }
+            return hash;
+        }
+        #define ZMAP_HASH_FUNC(key, len, seed) zmap_default_hash(key, len, seed)
     #endif
 #endif
 
@@ -503,14 +1296,34 @@ static inline size_t zmap_next_pow2(size_t n)
     return n + 1;
 }
 
-#define ZMAP_FIB_CONST 0x9E3779B9U
+// Smallest power-of-two capacity that holds n entries without growing.
+static inline size_t zmap_capacity_for(size_t n, float load_factor)
+{
+    size_t cap = zmap_next_pow2((size_t)((double)n / load_factor) + 1);
+    if (cap < 16)
+    {
+        cap = 16;
+    }
+    while ((size_t)(cap * load_factor) < n)
+    {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+// 2^N / golden ratio, matching the hash width.
+#ifdef ZMAP_HASH_64
+#   define ZMAP_FIB_CONST 0x9E3779B97F4A7C15ULL
+#else
+#   define ZMAP_FIB_CONST 0x9E3779B9U
+#endif
 
-static inline size_t zmap_fib_index(uint32_t hash, uint32_t bits)
+static inline size_t zmap_fib_index(zmap_hash_t hash, uint32_t bits)
 {
-    return (size_t)((hash * ZMAP_FIB_CONST) >> (32 - bits));
+    return (size_t)((zmap_hash_t)(hash * ZMAP_FIB_CONST) >> (ZMAP_HASH_BITS - bits));
 }
 
-static inline size_t zmap_dist(size_t index, size_t capacity, uint32_t hash, uint32_t bits)
+static inline size_t zmap_dist(size_t index, size_t capacity, zmap_hash_t hash, uint32_t bits)
 {
     size_t home = zmap_fib_index(hash, bits);
     if (index >= home) 
@@ -520,862 +1333,4238 @@ static inline size_t zmap_dist(size_t index, size_t capacity, uint32_t hash, uin
     return (index + capacity) - home;
 }
 
-// Safe API logic.
-#if Z_HAS_ZERROR
-    static inline zerr zmap_err_impl(int code, const char* msg, const char* file, int line, const char* func) 
+// Fills the derived zmap_stats fields; total_probe is the sum of all displacements.
+static inline void zmap_stats_finish(zmap_stats *s, size_t total_probe)
+{
+    s->load = s->capacity ? (double)s->count / (double)s->capacity : 0.0;
+    s->mean_probe = s->count ? (double)total_probe / (double)s->count : 0.0;
+    s->hash_quality = 1.0;
+    if (0 == s->count)
     {
-        return zerr_create_impl(code, file, line, func, "%s", msg);
+        return;
     }
+    // Expected homes for a uniform hash: capacity * (1 - (1 - 1/capacity)^count).
+    double miss = 1.0;
+    double base = 1.0 - 1.0 / (double)s->capacity;
+    for (size_t e = s->count; e; e >>= 1)
+    {
+        miss *= (e & 1) ? base : 1.0;
+        base *= base;
+    }
+    double quality = (double)s->distinct_homes / ((double)s->capacity * (1.0 - miss));
+    s->hash_quality = (quality < 1.0) ? quality : 1.0;
+}
 
-    #define ZMAP_GEN_SAFE_IMPL(KeyT, ValT, Name)                                                    \
-        DEFINE_RESULT(ValT*, ResPtr_##Name)                                                         \
-                                                                                                    \
-        static inline zres zmap_put_safe_##Name(zmap_##Name *m, KeyT k, ValT v,                     \
-                                               const char* f, int l, const char* fn)                \
-        {                                                                                           \
-            if (zmap_put_##Name(m, k, v) != Z_OK)                                                   \
-            {                                                                                       \
-                return zres_err(zmap_err_impl(Z_ENOMEM, "Map Put OOM", f, l, fn));                  \
-            }                                                                                       \
-            return zres_ok();                                                                       \
-        }                                                                                           \
-                                                                                                    \
-        static inline ResPtr_##Name zmap_get_safe_##Name(zmap_##Name *m, KeyT k,                    \
-                                                        const char* f, int l, const char* fn)       \
-        {                                                                                           \
-            ValT* ptr = zmap_get_##Name(m, k);                                                      \
-            if (!ptr)                                                                               \
-            {                                                                                       \
-                return ResPtr_##Name##_err(zmap_err_impl(Z_ENOTFOUND, "Key not found", f, l, fn));  \
-            }                                                                                       \
-            return ResPtr_##Name##_ok(ptr);                                                         \
-        }
-#else
-#   define ZMAP_GEN_SAFE_IMPL(KeyT, ValT, Name)
-#endif
-
+// Group probing helpers.
 
-/* * Implementation injection (C vs C++).
- * C++ uses new/delete/move for proper RAII.
- * C uses calloc/free/struct-copy.
+/* * Control bytes: 0x80 = empty, 0xFE = deleted, 0x00..0x7F = 7-bit hash fingerprint.
+ * Both markers have the high bit set, so "free" is a single sign test.
+ * The control array holds ZMAP_GROUP_WIDTH mirrored bytes past the end so a
+ * group load starting at any slot never needs to wrap.
  */
-#ifdef __cplusplus
-#   define ZMAP_IMPL_OPS(KeyT, ValT, Name)                                                                          \
-        static inline void zmap_free_##Name(zmap_##Name *m)                                                         \
-        {                                                                                                           \
-            if (m->buckets)                                                                                         \
-            {                                                                                                       \
-                delete[] m->buckets;                                                                                \
-            }                                                                                                       \
-            m->buckets = nullptr;                                                                                   \
-            m->count = 0;                                                                                           \
-            m->capacity = 0;                                                                                        \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline void zmap_clear_##Name(zmap_##Name *m)                                                        \
-        {                                                                                                           \
-             if (m->buckets)                                                                                        \
-             {                                                                                                      \
-                delete[] m->buckets;                                                                                \
-             }                                                                                                      \
-             m->buckets = nullptr;                                                                                  \
-             m->count = 0;                                                                                          \
-             m->capacity = 0;                                                                                       \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline int zmap_resize_##Name(zmap_##Name *m, size_t new_cap)                                        \
-        {                                                                                                           \
-            try                                                                                                     \
-            {                                                                                                       \
-                zmap_bucket_##Name *new_buckets = new zmap_bucket_##Name[new_cap]();                                \
-                uint32_t new_bits = 0;                                                                              \
-                size_t temp = new_cap;                                                                              \
-                while(temp >>= 1)                                                                                   \
-                {                                                                                                   \
-                    new_bits++;                                                                                     \
-                }                                                                                                   \
-                for (size_t i = 0; i < m->capacity; i++)                                                            \
-                {                                                                                                   \
-                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
-                    {                                                                                               \
-                        zmap_bucket_##Name entry = std::move(m->buckets[i]);                                        \
-                        size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
-                        size_t dist = 0;                                                                            \
-                        for (;;)                                                                                    \
-                        {                                                                                           \
-                            if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
-                            {                                                                                       \
-                                new_buckets[idx] = std::move(entry);                                                \
-                                new_buckets[idx].state = ZMAP_OCCUPIED;                                             \
-                                break;                                                                              \
-                            }                                                                                       \
-                            size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
-                            if (dist > existing_dist)                                                               \
-                            {                                                                                       \
-                                std::swap(new_buckets[idx], entry);                                                 \
-                                dist = existing_dist;                                                               \
-                            }                                                                                       \
-                            idx = (idx + 1) & (new_cap - 1); dist++;                                                \
-                        }                                                                                           \
-                    }                                                                                               \
-                }                                                                                                   \
-                if (m->buckets)                                                                                     \
-                {                                                                                                   \
-                    delete[] m->buckets;                                                                            \
-                }                                                                                                   \
-                m->buckets = new_buckets;                                                                           \
-                m->capacity = new_cap;                                                                              \
-                m->bits = new_bits;                                                                                 \
-                m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
-                return Z_OK;                                                                                        \
-            }                                                                                                       \
-            catch (...)                                                                                             \
-            {                                                                                                       \
-                return Z_ENOMEM;                                                                                    \
-            }                                                                                                       \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline int zmap_put_##Name(zmap_##Name *m, KeyT key, ValT val)                                       \
-        {                                                                                                           \
-            try                                                                                                     \
-            {                                                                                                       \
-                if (m->count >= m->threshold)                                                                       \
-                {                                                                                                   \
-                    size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                  \
-                    if (Z_OK != zmap_resize_##Name(m, new_cap))                                                     \
-                    {                                                                                               \
-                        return Z_ENOMEM;                                                                            \
-                    }                                                                                               \
-                }                                                                                                   \
-                uint32_t hash = m->hash_func(key, m->seed);                                                         \
-                size_t idx = zmap_fib_index(hash, m->bits);                                                         \
-                size_t dist = 0;                                                                                    \
-                zmap_bucket_##Name entry;                                                                           \
-                entry.key = key;                                                                                    \
-                entry.value = val;                                                                                  \
-                entry.stored_hash = hash;                                                                           \
-                entry.state = ZMAP_OCCUPIED;                                                                        \
-                for (;;)                                                                                            \
-                {                                                                                                   \
-                    if (ZMAP_EMPTY == m->buckets[idx].state) {                                                      \
-                        m->buckets[idx] = std::move(entry);                                                         \
-                        m->count++;                                                                                 \
-                        return Z_OK;                                                                                \
-                    }                                                                                               \
-                    if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))          \
-                    {                                                                                               \
-                        m->buckets[idx].value = val;                                                                \
-                        return Z_OK;                                                                                \
-                    }                                                                                               \
-                    size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
-                    if (dist > existing_dist)                                                                       \
-                    {                                                                                               \
-                        std::swap(m->buckets[idx], entry);                                                          \
-                        dist = existing_dist;                                                                       \
-                    }                                                                                               \
-                    idx = (idx + 1) & (m->capacity - 1); dist++;                                                    \
-                }                                                                                                   \
-            }                                                                                                       \
-            catch (...)                                                                                             \
-            {                                                                                                       \
-                return Z_ENOMEM;                                                                                    \
-            }                                                                                                       \
+#define ZMAP_GROUP_WIDTH    16
+#define ZMAP_CTRL_EMPTY     ((uint8_t)0x80)
+#define ZMAP_CTRL_DELETED   ((uint8_t)0xFE)
+#define ZMAP_CTRL_IS_FULL(c) (0 == ((c) & 0x80))
+#define ZMAP_H2(hash)       ((uint8_t)((hash) & 0x7F))
+
+static inline uint32_t zmap_ctz32(uint32_t x)
+{
+#   if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(x);
+#   else
+    uint32_t n = 0;
+    while (0 == (x & 1u))
+    {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#   endif
+}
+
+// Bitmask of the slots in the group whose control byte equals `tag`.
+static inline uint32_t zmap_group_match(const uint8_t *ctrl, uint8_t tag)
+{
+#   if ZMAP_HAS_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#   else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < ZMAP_GROUP_WIDTH; i++)
+    {
+        if (ctrl[i] == tag)
+        {
+            mask |= 1u << i;
         }
+    }
+    return mask;
+#   endif
+}
 
-#   define ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                                   \
-        static inline void zmap_free_stable_##Name(zmap_stable_##Name *m)                                           \
-        {                                                                                                           \
-            if (m->buckets)                                                                                         \
-            {                                                                                                       \
-                for (size_t i = 0; i < m->capacity; i++)                                                            \
-                {                                                                                                   \
-                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
-                    {                                                                                               \
-                        delete m->buckets[i].value;                                                                 \
-                    }                                                                                               \
-                }                                                                                                   \
-                delete[] m->buckets;                                                                                \
-            }                                                                                                       \
-            *m = (zmap_stable_##Name){0};                                                                           \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline void zmap_clear_stable_##Name(zmap_stable_##Name *m)                                          \
-        {                                                                                                           \
-            zmap_free_stable_##Name(m);                                                                             \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline int zmap_resize_stable_##Name(zmap_stable_##Name *m, size_t new_cap)                          \
-        {                                                                                                           \
-            try                                                                                                     \
-            {                                                                                                       \
-                zmap_bucket_stable_##Name *new_buckets = new zmap_bucket_stable_##Name[new_cap]();                  \
-                uint32_t new_bits = 0;                                                                              \
-                size_t temp = new_cap;                                                                              \
-                while(temp >>= 1)                                                                                   \
-                {                                                                                                   \
-                    new_bits++;                                                                                     \
-                }                                                                                                   \
-                for (size_t i = 0; i < m->capacity; i++)                                                            \
-                {                                                                                                   \
-                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
-                    {                                                                                               \
-                        zmap_bucket_stable_##Name entry = m->buckets[i];                                            \
-                        size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
-                        size_t dist = 0;                                                                            \
-                        for (;;)                                                                                    \
-                        {                                                                                           \
-                            if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
-                            {                                                                                       \
-                                new_buckets[idx] = entry; new_buckets[idx].state = ZMAP_OCCUPIED; break;            \
-                            }                                                                                       \
-                            size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
-                            if (dist > existing_dist)                                                               \
-                            {                                                                                       \
-                                std::swap(new_buckets[idx], entry);                                                 \
-                                dist = existing_dist;                                                               \
-                            }                                                                                       \
-                            idx = (idx + 1) & (new_cap - 1); dist++;                                                \
-                        }                                                                                           \
-                    }                                                                                               \
-                }                                                                                                   \
-                if (m->buckets)                                                                                     \
-                {                                                                                                   \
-                    delete[] m->buckets;                                                                            \
-                }                                                                                                   \
-                m->buckets = new_buckets;                                                                           \
-                m->capacity = new_cap;                                                                              \
-                m->bits = new_bits;                                                                                 \
-                m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
-                return Z_OK;                                                                                        \
-            }                                                                                                       \
-            catch(...)                                                                                              \
-            {                                                                                                       \
-                return Z_ENOMEM;                                                                                    \
-            }                                                                                                       \
-        }                                                                                                           \
-                                                                                                                    \
-        static inline int zmap_put_stable_##Name(zmap_stable_##Name *m, KeyT key, ValT val)                         \
-        {                                                                                                           \
-            try                                                                                                     \
-            {                                                                                                       \
-                if (m->count >= m->threshold)                                                                       \
-                {                                                                                                   \
-                    size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                  \
-                    if (Z_OK != zmap_resize_stable_##Name(m, new_cap))                                              \
-                    {                                                                                               \
-                        return Z_ENOMEM;                                                                            \
-                    }                                                                                               \
-                }                                                                                                   \
-                uint32_t hash = m->hash_func(key, m->seed);                                                         \
-                size_t idx = zmap_fib_index(hash, m->bits);                                                         \
-                size_t dist = 0;                                                                                    \
-                zmap_bucket_stable_##Name entry;                                                                    \
-                entry.key = key;                                                                                    \
-                entry.value = nullptr;                                                                              \
-                entry.stored_hash = hash;                                                                           \
-                entry.state = ZMAP_OCCUPIED;                                                                        \
-                for (;;)                                                                                            \
-                {                                                                                                   \
-                    if (ZMAP_EMPTY == m->buckets[idx].state)                                                        \
-                    {                                                                                               \
-                        if (!entry.value)                                                                           \
-                        {                                                                                           \
-                            entry.value = new ValT(val);                                                            \
-                        }                                                                                           \
-                        m->buckets[idx] = entry;                                                                    \
-                        m->count++;                                                                                 \
-                        return Z_OK;                                                                                \
-                    }                                                                                               \
-                    if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))          \
-                    {                                                                                               \
-                        *m->buckets[idx].value = val;                                                               \
-                        return Z_OK;                                                                                \
-                    }                                                                                               \
-                    size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
-                    if (dist > existing_dist)                                                                       \
-                    {                                                                                               \
-                        if (!entry.value)                                                                           \
-                        {                                                                                           \
-                            entry.value = new ValT(val);                                                            \
-                        }                                                                                           \
-                        std::swap(m->buckets[idx], entry);                                                          \
-                        dist = existing_dist;                                                                       \
-                    }                                                                                               \
-                    idx = (idx + 1) & (m->capacity - 1); dist++;                                                    \
-                }                                                                                                   \
-            }                                                                                                       \
-            catch(...)                                                                                              \
-            {                                                                                                       \
-                return Z_ENOMEM;                                                                                    \
-            }                                                                                                       \
-        }                                                                                                           \
-        static inline void zmap_remove_val_stable_##Name(ValT *ptr)                                                 \
-        {                                                                                                           \
-            delete ptr;                                                                                             \
+// Bitmask of the slots in the group that are empty or deleted.
+static inline uint32_t zmap_group_match_free(const uint8_t *ctrl)
+{
+#   if ZMAP_HAS_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#   else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < ZMAP_GROUP_WIDTH; i++)
+    {
+        if (!ZMAP_CTRL_IS_FULL(ctrl[i]))
+        {
+            mask |= 1u << i;
         }
-#else
-#   define ZMAP_IMPL_OPS(KeyT, ValT, Name)                                                                              \
-        static inline void zmap_free_##Name(zmap_##Name *m)                                                             \
+    }
+    return mask;
+#   endif
+}
+
+static inline void zmap_ctrl_set(uint8_t *ctrl, size_t capacity, size_t idx, uint8_t tag)
+{
+    ctrl[idx] = tag;
+    if (idx < ZMAP_GROUP_WIDTH)
+    {
+        ctrl[capacity + idx] = tag;
+    }
+}
+
+// Triangular group probing visits every slot when capacity is a power of two.
+static inline size_t zmap_group_find_free(const uint8_t *ctrl, size_t capacity, uint32_t bits, zmap_hash_t hash)
+{
+    size_t mask = capacity - 1;
+    size_t pos = zmap_fib_index(hash, bits);
+    size_t stride = 0;
+    for (;;)
+    {
+        uint32_t free_mask = zmap_group_match_free(ctrl + pos);
+        if (free_mask)
+        {
+            return (pos + zmap_ctz32(free_mask)) & mask;
+        }
+        stride += ZMAP_GROUP_WIDTH;
+        pos = (pos + stride) & mask;
+    }
+}
+
+// Structure-of-arrays helpers.
+
+/* * SoA maps fold occupancy and probe distance into one metadata byte:
+ * 0 = empty, otherwise distance + 1. Distances that do not fit saturate at
+ * ZMAP_META_SAT and are recomputed from the stored hash when needed.
+ */
+#define ZMAP_META_SAT ((uint8_t)0xFF)
+
+static inline uint8_t zmap_meta_encode(size_t dist)
+{
+    return (dist + 1 < ZMAP_META_SAT) ? (uint8_t)(dist + 1) : ZMAP_META_SAT;
+}
+
+static inline size_t zmap_meta_dist(uint8_t meta, size_t index, size_t capacity, zmap_hash_t hash, uint32_t bits)
+{
+    return (meta < ZMAP_META_SAT) ? (size_t)(meta - 1) : zmap_dist(index, capacity, hash, bits);
+}
+
+// Safe API logic.
+#if Z_HAS_ZERROR
+    static inline zerr zmap_err_impl(int code, const char* msg, const char* file, int line, const char* func) 
+    {
+        return zerr_create_impl(code, file, line, func, "%s", msg);
+    }
+
+    #define ZMAP_GEN_SAFE_IMPL(KeyT, ValT, Name)                                                    \
+        DEFINE_RESULT(ValT*, ResPtr_##Name)                                                         \
+                                                                                                    \
+        static inline zres zmap_put_safe_##Name(zmap_##Name *m, KeyT k, ValT v,                     \
+                                               const char* f, int l, const char* fn)                \
+        {                                                                                           \
+            if (zmap_put_##Name(m, k, v) != Z_OK)                                                   \
+            {                                                                                       \
+                return zres_err(zmap_err_impl(Z_ENOMEM, "Map Put OOM", f, l, fn));                  \
+            }                                                                                       \
+            return zres_ok();                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        static inline ResPtr_##Name zmap_get_safe_##Name(zmap_##Name *m, KeyT k,                    \
+                                                        const char* f, int l, const char* fn)       \
+        {                                                                                           \
+            ValT* ptr = zmap_get_##Name(m, k);                                                      \
+            if (!ptr)                                                                               \
+            {                                                                                       \
+                return ResPtr_##Name##_err(zmap_err_impl(Z_ENOTFOUND, "Key not found", f, l, fn));  \
+            }                                                                                       \
+            return ResPtr_##Name##_ok(ptr);                                                         \
+        }
+#else
+#   define ZMAP_GEN_SAFE_IMPL(KeyT, ValT, Name)
+#endif
+
+/* * Storage primitives for the language-neutral generators.
+ * C++ value-initializes and destroys elements; C zero-fills and frees.
+ * ZMAP_NEW_ARRAY returns NULL on allocation failure in both languages.
+ * ZMAP_TRY_HASH returns Z_ENOMEM from the caller if hashing (or copying the key
+ * for it) throws, so inserts keep reporting errors instead of propagating them.
+ */
+#ifdef __cplusplus
+#   define ZMAP_NEW_ARRAY(T, n)     z_map::detail::new_array<T>(n)
+#   define ZMAP_DELETE_ARRAY(T, p)  z_map::detail::delete_array<T>(p)
+#   define ZMAP_MOVE(x)             std::move(x)
+#   define ZMAP_RESET(x)            z_map::detail::reset(x)
+#   define ZMAP_SWAP(T, a, b)       std::swap(a, b)
+#   define ZMAP_ALIGNOF(T)          alignof(T)
+#   define ZMAP_ALLOC_ARRAY(T, a, n)    z_map::detail::alloc_array<T>(a, n)
+#   define ZMAP_FREE_ARRAY(T, a, p, n)  z_map::detail::free_array<T>(a, p, n)
+#   define ZMAP_TRY_HASH(out, expr)     try { (out) = (expr); } catch (...) { return Z_ENOMEM; }
+#else
+#   define ZMAP_NEW_ARRAY(T, n)     ((T*)ZMAP_CALLOC((n), sizeof(T)))
+#   define ZMAP_DELETE_ARRAY(T, p)  ZMAP_FREE(p)
+#   define ZMAP_MOVE(x)             (x)
+#   define ZMAP_RESET(x)            ((void)0)
+#   define ZMAP_SWAP(T, a, b)       do { T zmap_swap_tmp_ = (a); (a) = (b); (b) = zmap_swap_tmp_; } while (0)
+#   define ZMAP_ALIGNOF(T)          _Alignof(T)
+#   define ZMAP_ALLOC_ARRAY(T, a, n)    ((T*)zmap_alloc_zeroed((a), (n), sizeof(T)))
+#   define ZMAP_FREE_ARRAY(T, a, p, n)  zmap_release((a), (p), (n) * sizeof(T))
+#   define ZMAP_TRY_HASH(out, expr)     (out) = (expr);
+
+static inline void *zmap_alloc_zeroed(const zmap_allocator *a, size_t n, size_t size)
+{
+    if (!a->alloc)
+    {
+        return ZMAP_CALLOC(n, size);
+    }
+    if (size && n > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+    void *p = a->alloc(a->ctx, n * size);
+    if (p)
+    {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+static inline void zmap_release(const zmap_allocator *a, void *p, size_t size)
+{
+    if (!a->alloc)
+    {
+        ZMAP_FREE(p);
+    }
+    else if (p && a->free)
+    {
+        a->free(a->ctx, p, size);
+    }
+}
+#endif
+
+/* * Huge-page bucket storage, opt-in per map through zmap_hugepage_allocator().
+ * Arrays of at least ZMAP_HUGEPAGE_MIN bytes are mmap'd on a ZMAP_HUGEPAGE_SIZE
+ * boundary, from MAP_HUGETLB pages when reserved ones exist, else with
+ * MADV_HUGEPAGE. Small arrays, targets without mmap and failed mappings fall
+ * back to ZMAP_MALLOC. Mapped arrays start exactly on the boundary and carry
+ * no header: the free side recomputes the length from the array size, and
+ * tells a mapping from a large fallback block by its alignment.
+ */
+#ifndef ZMAP_HUGEPAGE_SIZE
+#   define ZMAP_HUGEPAGE_SIZE ((size_t)2 << 20)
+#endif
+
+#ifndef ZMAP_HUGEPAGE_MIN
+#   define ZMAP_HUGEPAGE_MIN ZMAP_HUGEPAGE_SIZE
+#endif
+
+// Large fallback blocks keep their offset from the malloc'd start just below the array.
+#define ZMAP_HUGEPAGE_HEADER 64
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   define ZMAP_HAS_POSIX 1
+#else
+#   define ZMAP_HAS_POSIX 0
+#endif
+
+#if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#   define ZMAP_HAS_MMAP 1
+#   ifndef MAP_ANONYMOUS
+#       define MAP_ANONYMOUS MAP_ANON
+#   endif
+#else
+#   define ZMAP_HAS_MMAP 0
+#endif
+
+// Maps `bytes` (a multiple of ZMAP_HUGEPAGE_SIZE) on a huge-page boundary, or returns NULL.
+static inline void *zmap_huge_map(size_t bytes)
+{
+#if ZMAP_HAS_MMAP
+#   ifdef MAP_HUGETLB
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != p)
+    {
+        return p;
+    }
+#   endif
+    // Over-map by one huge page, then trim both ends to the aligned span.
+    size_t span = bytes + ZMAP_HUGEPAGE_SIZE;
+    char *raw = (char*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)raw)
+    {
+        return NULL;
+    }
+    char *base = (char*)(((uintptr_t)raw + ZMAP_HUGEPAGE_SIZE - 1) & ~(uintptr_t)(ZMAP_HUGEPAGE_SIZE - 1));
+    if (base > raw)
+    {
+        munmap(raw, (size_t)(base - raw));
+    }
+    if (raw + span > base + bytes)
+    {
+        munmap(base + bytes, (size_t)((raw + span) - (base + bytes)));
+    }
+#   ifdef MADV_HUGEPAGE
+    madvise(base, bytes, MADV_HUGEPAGE);
+#   endif
+    return base;
+#else
+    (void)bytes;
+    return NULL;
+#endif
+}
+
+static inline size_t zmap_huge_span(size_t size)
+{
+    return (size + ZMAP_HUGEPAGE_SIZE - 1) & ~(ZMAP_HUGEPAGE_SIZE - 1);
+}
+
+static inline bool zmap_huge_aligned(const void *p)
+{
+    return 0 == ((uintptr_t)p & (ZMAP_HUGEPAGE_SIZE - 1));
+}
+
+static inline void *zmap_huge_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    if (size < ZMAP_HUGEPAGE_MIN)
+    {
+        return ZMAP_MALLOC(size);
+    }
+    void *base = zmap_huge_map(zmap_huge_span(size));
+    if (base)
+    {
+        return base;
+    }
+    // Fallback: the array must not look like a mapping, so skip one more header if it would.
+    char *block = (char*)ZMAP_MALLOC(size + 2 * ZMAP_HUGEPAGE_HEADER);
+    if (!block)
+    {
+        return NULL;
+    }
+    size_t off = ZMAP_HUGEPAGE_HEADER;
+    if (zmap_huge_aligned(block + off))
+    {
+        off += ZMAP_HUGEPAGE_HEADER;
+    }
+    memcpy(block + off - sizeof(off), &off, sizeof(off));
+    return block + off;
+}
+
+static inline void zmap_huge_free(void *ctx, void *ptr, size_t size)
+{
+    (void)ctx;
+    if (!ptr)
+    {
+        return;
+    }
+    if (size < ZMAP_HUGEPAGE_MIN)
+    {
+        ZMAP_FREE(ptr);
+        return;
+    }
+#if ZMAP_HAS_MMAP
+    if (zmap_huge_aligned(ptr))
+    {
+        munmap(ptr, zmap_huge_span(size));
+        return;
+    }
+#endif
+    size_t off;
+    memcpy(&off, (char*)ptr - sizeof(off), sizeof(off));
+    ZMAP_FREE((char*)ptr - off);
+}
+
+// Allocator for zmap_init_alloc: bucket arrays on transparent or reserved huge pages.
+static inline zmap_allocator zmap_hugepage_allocator(void)
+{
+    zmap_allocator a = { zmap_huge_alloc, zmap_huge_free, NULL };
+    return a;
+}
+
+/* * Frozen snapshots: a fixed 64-byte header followed by the raw bucket array.
+ * Nothing in the image is a pointer, so it can be mapped at any address. The
+ * header pins the hash width and bucket size; byte order is the writer's.
+ */
+#define ZMAP_FROZEN_MAGIC   "ZMAPFRZ1"
+#define ZMAP_FROZEN_VERSION 1u
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_bits;
+    uint64_t bucket_size;
+    uint64_t capacity;
+    uint64_t count;
+    uint32_t bits;
+    uint32_t seed;
+    float load_factor;
+    uint32_t reserved;
+    uint64_t checksum;
+} zmap_frozen_header;
+
+#ifdef __cplusplus
+#   define ZMAP_FROZEN_ASSERT(KeyT, ValT)                                                          \
+        static_assert(std::is_trivially_copyable<KeyT>::value && std::is_trivially_copyable<ValT>::value, \
+                      "Frozen maps need trivially copyable keys and values.");
+#else
+#   define ZMAP_FROZEN_ASSERT(KeyT, ValT)
+#endif
+
+static inline zmap_frozen_header zmap_frozen_header_make(size_t bucket_size, size_t capacity, size_t count,
+                                                         uint32_t bits, uint32_t seed, float load_factor)
+{
+    zmap_frozen_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ZMAP_FROZEN_MAGIC, sizeof(hdr.magic));
+    hdr.version = ZMAP_FROZEN_VERSION;
+    hdr.hash_bits = ZMAP_HASH_BITS;
+    hdr.bucket_size = bucket_size;
+    hdr.capacity = capacity;
+    hdr.count = count;
+    hdr.bits = bits;
+    hdr.seed = seed;
+    hdr.load_factor = load_factor;
+    return hdr;
+}
+
+// 64-bit FNV-1a over 8-byte words, then the tail bytes.
+static inline uint64_t zmap_frozen_checksum(const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, sizeof(w));
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for (; i < len; i++)
+    {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+// Returns the header if the image matches this build's layout and is complete, else NULL.
+static inline const zmap_frozen_header *zmap_frozen_check(const void *data, size_t len, size_t bucket_size)
+{
+    const zmap_frozen_header *hdr = (const zmap_frozen_header*)data;
+    if (!data || len < sizeof(*hdr) || 0 != memcmp(hdr->magic, ZMAP_FROZEN_MAGIC, sizeof(hdr->magic)))
+    {
+        return NULL;
+    }
+    if (ZMAP_FROZEN_VERSION != hdr->version || ZMAP_HASH_BITS != hdr->hash_bits || bucket_size != hdr->bucket_size)
+    {
+        return NULL;
+    }
+    if ((hdr->capacity & (hdr->capacity - 1)) || hdr->capacity > (len - sizeof(*hdr)) / bucket_size)
+    {
+        return NULL;
+    }
+    if (hdr->count > hdr->capacity || hdr->bits >= 64 || (hdr->capacity && ((uint64_t)1 << hdr->bits) != hdr->capacity))
+    {
+        return NULL;
+    }
+    if (!(hdr->load_factor > 0.0f && hdr->load_factor <= 1.0f))
+    {
+        return NULL;
+    }
+    return hdr;
+}
+
+// Maps the file read-only, or reads it onto the heap where mmap is unavailable.
+static inline void *zmap_frozen_load(const char *path, size_t *len, bool *mapped)
+{
+#if ZMAP_HAS_POSIX
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat st;
+    void *p = NULL;
+    if (0 == fstat(fd, &st) && st.st_size > 0)
+    {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        p = (MAP_FAILED == p) ? NULL : p;
+    }
+    close(fd);
+    *len = p ? (size_t)st.st_size : 0;
+    *mapped = true;
+    return p;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return NULL;
+    }
+    void *p = NULL;
+    long size = (0 == fseek(fp, 0, SEEK_END)) ? ftell(fp) : -1;
+    if (size > 0 && 0 == fseek(fp, 0, SEEK_SET))
+    {
+        p = ZMAP_MALLOC((size_t)size);
+        if (p && 1 != fread(p, (size_t)size, 1, fp))
+        {
+            ZMAP_FREE(p);
+            p = NULL;
+        }
+    }
+    fclose(fp);
+    *len = p ? (size_t)size : 0;
+    *mapped = false;
+    return p;
+#endif
+}
+
+static inline void zmap_frozen_unload(void *base, size_t len, bool mapped)
+{
+#if ZMAP_HAS_POSIX
+    if (mapped)
+    {
+        munmap(base, len);
+        return;
+    }
+#endif
+    (void)len;
+    (void)mapped;
+    ZMAP_FREE(base);
+}
+
+/* * Minimal perfect hashing (hash and displace, CHD style).
+ * Keys are split into ~n/ZMAP_PHF_LAMBDA buckets. Buckets are placed largest
+ * first, each searching for a "pilot" that sends all its keys to free slots of
+ * an n-slot table. A lookup is one hash, one pilot load and one key compare.
+ */
+#ifndef ZMAP_PHF_LAMBDA
+#   define ZMAP_PHF_LAMBDA 4
+#endif
+
+#ifndef ZMAP_PHF_ATTEMPTS
+#   define ZMAP_PHF_ATTEMPTS 32
+#endif
+
+// Pilots tried per bucket before the build gives up on the seed and reseeds.
+// Buckets placed late, into a nearly full table, also get about 16 * n / free
+// more, since a single key needs n / free tries on average.
+#ifndef ZMAP_PHF_MAX_PILOT
+#   define ZMAP_PHF_MAX_PILOT (1u << 16)
+#endif
+
+// 64 bits of key hash: one call in ZMAP_HASH_64 mode, two seeded calls otherwise.
+#ifdef ZMAP_HASH_64
+#   define ZMAP_PHF_HASH(fn, key, seed) ((uint64_t)(fn)(key, seed))
+#else
+#   define ZMAP_PHF_HASH(fn, key, seed) (((uint64_t)(fn)(key, seed) << 32) | (uint64_t)(fn)(key, ~(seed)))
+#endif
+
+static inline uint64_t zmap_phf_mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Maps x onto [0, n) with a multiply instead of a division where n fits in 32 bits.
+static inline size_t zmap_phf_reduce(uint64_t x, size_t n)
+{
+    if ((uint64_t)n <= 0xFFFFFFFFull)
+    {
+        return (size_t)(((x >> 32) * (uint64_t)n) >> 32);
+    }
+    return (size_t)(x % (uint64_t)n);
+}
+
+static inline size_t zmap_phf_bucket(uint64_t h, size_t buckets)
+{
+    return zmap_phf_reduce(zmap_phf_mix(h), buckets);
+}
+
+static inline size_t zmap_phf_slot(uint64_t h, uint32_t pilot, size_t n)
+{
+    return zmap_phf_reduce(zmap_phf_mix(h ^ ((uint64_t)pilot * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull)), n);
+}
+
+// Searches a pilot for every bucket, largest buckets first (they are the hardest to place).
+static inline int zmap_phf_search(const uint64_t *hashes, size_t n, size_t nb, uint32_t *pilots, size_t *slots,
+                                  size_t dup[2], size_t *start, size_t *members, size_t *order, uint8_t *taken)
+{
+    // Group keys by bucket (CSR layout), tracking the largest bucket.
+    size_t max_size = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        start[zmap_phf_bucket(hashes[i], nb) + 1]++;
+    }
+    for (size_t b = 0; b < nb; b++)
+    {
+        max_size = (start[b + 1] > max_size) ? start[b + 1] : max_size;
+        start[b + 1] += start[b];
+        order[b] = start[b];
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        members[order[zmap_phf_bucket(hashes[i], nb)]++] = i;
+    }
+
+    size_t filled = 0;
+    for (size_t size = max_size; size > 0; size--)
+    {
+        for (size_t b = 0; b < nb; b++)
+        {
+            if (start[b + 1] - start[b] == size)
+            {
+                order[filled++] = b;
+            }
+        }
+    }
+
+    size_t used = 0;
+    for (size_t o = 0; o < filled; o++)
+    {
+        size_t b = order[o];
+        const size_t *keys = members + start[b];
+        size_t size = start[b + 1] - start[b];
+        uint64_t limit = (uint64_t)ZMAP_PHF_MAX_PILOT + 16 * (uint64_t)(n / (n - used));
+        limit = (limit < 0xFFFFFFFFull) ? limit : 0xFFFFFFFFull;
+        for (size_t x = 0; x < size; x++)
+        {
+            for (size_t y = x + 1; y < size; y++)
+            {
+                if (hashes[keys[x]] == hashes[keys[y]])
+                {
+                    dup[0] = keys[x];
+                    dup[1] = keys[y];
+                    return Z_EEXIST;
+                }
+            }
+        }
+        for (uint32_t pilot = 0;; pilot++)
+        {
+            size_t placed = 0;
+            while (placed < size)
+            {
+                size_t s = zmap_phf_slot(hashes[keys[placed]], pilot, n);
+                if (taken[s])
+                {
+                    break;
+                }
+                taken[s] = 1;
+                slots[keys[placed++]] = s;
+            }
+            if (placed == size)
+            {
+                pilots[b] = pilot;
+                used += size;
+                break;
+            }
+            while (placed > 0)
+            {
+                taken[slots[keys[--placed]]] = 0;
+            }
+            if (pilot + 1 >= limit)
+            {
+                return Z_ERR;
+            }
+        }
+    }
+    return Z_OK;
+}
+
+/* Places n hashed keys into nb buckets. On Z_OK, slots[i] is key i's slot and
+ * pilots[b] bucket b's pilot. Z_EEXIST reports two keys with identical hashes
+ * in dup[0]/dup[1] (a duplicate key, or a reason to reseed). Z_ERR means a
+ * bucket ran out of pilots (see ZMAP_PHF_MAX_PILOT); a new seed may work. */
+static inline int zmap_phf_place(const uint64_t *hashes, size_t n, size_t nb, uint32_t *pilots, size_t *slots,
+                                 size_t dup[2])
+{
+    size_t *start = (size_t*)ZMAP_CALLOC(nb + 1, sizeof(size_t));
+    size_t *members = (size_t*)ZMAP_MALLOC(n * sizeof(size_t));
+    size_t *order = (size_t*)ZMAP_MALLOC(nb * sizeof(size_t));
+    uint8_t *taken = (uint8_t*)ZMAP_CALLOC(n, sizeof(uint8_t));
+    int rc = Z_ENOMEM;
+    if (start && members && order && taken)
+    {
+        rc = zmap_phf_search(hashes, n, nb, pilots, slots, dup, start, members, order, taken);
+    }
+    ZMAP_FREE(start);
+    ZMAP_FREE(members);
+    ZMAP_FREE(order);
+    ZMAP_FREE(taken);
+    return rc;
+}
+
+/* * Slab arena for stable-map values.
+ * Fixed-size chunks are carved from slabs that double in size up to
+ * ZMAP_ARENA_MAX_CHUNKS; released chunks go on an intrusive free list.
+ * Teardown frees whole slabs, never individual values.
+ */
+typedef struct zmap_slab
+{
+    struct zmap_slab *next;
+} zmap_slab;
+
+typedef struct
+{
+    zmap_slab *slabs;
+    void *free_list;
+    char *bump;
+    char *bump_end;
+    size_t next_chunks;
+    size_t bytes;       // Held in slabs, for zmap_memory_usage.
+    bool enabled;
+} zmap_arena;
+
+// Chunk size: room for a free-list link, padded to the alignment.
+static inline size_t zmap_arena_chunk(size_t size, size_t align)
+{
+    if (align < ZMAP_ALIGNOF(void*))
+    {
+        align = ZMAP_ALIGNOF(void*);
+    }
+    if (size < sizeof(void*))
+    {
+        size = sizeof(void*);
+    }
+    return (size + align - 1) & ~(align - 1);
+}
+
+#define ZMAP_ARENA_CHUNK(T) zmap_arena_chunk(sizeof(T), ZMAP_ALIGNOF(T))
+
+// Returns an uninitialized chunk, or NULL when a new slab cannot be allocated.
+static inline void *zmap_arena_alloc(zmap_arena *a, size_t chunk, size_t align)
+{
+    void *p = a->free_list;
+    if (p)
+    {
+        memcpy(&a->free_list, p, sizeof(void*));
+        return p;
+    }
+    if ((size_t)(a->bump_end - a->bump) < chunk)
+    {
+        size_t n = a->next_chunks ? a->next_chunks : ZMAP_ARENA_MIN_CHUNKS;
+        size_t header = zmap_arena_chunk(sizeof(zmap_slab), align);
+        zmap_slab *slab = (zmap_slab*)ZMAP_MALLOC(header + n * chunk);
+        if (!slab)
+        {
+            return NULL;
+        }
+        slab->next = a->slabs;
+        a->slabs = slab;
+        a->bytes += header + n * chunk;
+        a->bump = (char*)slab + header;
+        a->bump_end = a->bump + n * chunk;
+        a->next_chunks = (n < ZMAP_ARENA_MAX_CHUNKS) ? n * 2 : n;
+    }
+    p = a->bump;
+    a->bump += chunk;
+    return p;
+}
+
+static inline void zmap_arena_release(zmap_arena *a, void *p)
+{
+    memcpy(p, &a->free_list, sizeof(void*));
+    a->free_list = p;
+}
+
+// Frees every slab. The arena stays enabled and can be reused.
+static inline void zmap_arena_free(zmap_arena *a)
+{
+    while (a->slabs)
+    {
+        zmap_slab *next = a->slabs->next;
+        ZMAP_FREE(a->slabs);
+        a->slabs = next;
+    }
+    a->free_list = NULL;
+    a->bump = NULL;
+    a->bump_end = NULL;
+    a->next_chunks = 0;
+    a->bytes = 0;
+}
+
+/* * Atomics and epoch tracking for seqlock maps.
+ * Mapped onto the GCC/Clang __atomic builtins; on other compilers define the
+ * ZMAP_ATOMIC_* and ZMAP_MO_* macros before including this header.
+ */
+#if !defined(ZMAP_ATOMIC_LOAD) && (defined(__GNUC__) || defined(__clang__))
+#   define ZMAP_MO_RELAXED              __ATOMIC_RELAXED
+#   define ZMAP_MO_ACQUIRE              __ATOMIC_ACQUIRE
+#   define ZMAP_MO_RELEASE              __ATOMIC_RELEASE
+#   define ZMAP_MO_SEQ_CST              __ATOMIC_SEQ_CST
+#   define ZMAP_ATOMIC_LOAD(p, mo)      __atomic_load_n((p), mo)
+#   define ZMAP_ATOMIC_STORE(p, v, mo)  __atomic_store_n((p), (v), mo)
+#   define ZMAP_ATOMIC_ADD(p, v, mo)    __atomic_fetch_add((p), (v), mo)
+#   define ZMAP_ATOMIC_FENCE(mo)        __atomic_thread_fence(mo)
+#   define ZMAP_ATOMIC_CAS(p, e, v, mo) __atomic_compare_exchange_n((p), (e), (v), false, mo, __ATOMIC_RELAXED)
+#endif
+
+#ifndef ZMAP_THREAD_LOCAL
+#   if defined(__cplusplus)
+#       define ZMAP_THREAD_LOCAL thread_local
+#   elif defined(_MSC_VER)
+#       define ZMAP_THREAD_LOCAL __declspec(thread)
+#   else
+#       define ZMAP_THREAD_LOCAL _Thread_local
+#   endif
+#endif
+
+#if ZMAP_HAS_SSE2
+#   define ZMAP_CPU_RELAX() _mm_pause()
+#else
+#   define ZMAP_CPU_RELAX() ((void)0)
+#endif
+
+// Reader slots per seqlock map (log2). The first threads to read a map each own
+// a slot; later ones fall back to shared counters, which is safe, just slower.
+#ifndef ZMAP_SEQ_SLOT_BITS
+#   define ZMAP_SEQ_SLOT_BITS 6
+#endif
+
+#ifdef __cplusplus
+#   define ZMAP_SEQ_ASSERT_TRIVIAL(KeyT, ValT)                                                      \
+        static_assert(std::is_trivially_copyable<KeyT>::value && std::is_trivially_copyable<ValT>::value, \
+                      "Seqlock maps read keys/values racily; they must be trivially copyable.");
+#else
+#   define ZMAP_SEQ_ASSERT_TRIVIAL(KeyT, ValT)
+#endif
+
+#ifdef ZMAP_ATOMIC_LOAD
+    // One cache line per slot. readers[] is written only by the owning thread;
+    // shared[] takes atomic increments from threads that own no slot.
+    typedef struct
+    {
+        uintptr_t owner;
+        uint32_t readers[2];
+        uint32_t shared[2];
+        unsigned char pad[ZMAP_CACHE_LINE - sizeof(uintptr_t) - 4 * sizeof(uint32_t)];
+    } zmap_seq_slot;
+
+    typedef struct
+    {
+        uint32_t *count;
+        bool owned;
+    } zmap_seq_ticket;
+
+    // The calling thread's index plus one, handed out on first use. Its address
+    // is unique per thread and serves as the slot owner token.
+    static inline uint32_t *zmap_seq_thread(void)
+    {
+        static uint32_t next = 0;
+        static ZMAP_THREAD_LOCAL uint32_t index = 0;
+        if (0 == index)
+        {
+            index = ZMAP_ATOMIC_ADD(&next, 1u, ZMAP_MO_RELAXED) + 1;
+        }
+        return &index;
+    }
+
+    static inline void zmap_seq_exit(zmap_seq_ticket t)
+    {
+        if (t.owned)
+        {
+            ZMAP_ATOMIC_STORE(t.count, ZMAP_ATOMIC_LOAD(t.count, ZMAP_MO_RELAXED) - 1, ZMAP_MO_RELEASE);
+        }
+        else
+        {
+            ZMAP_ATOMIC_ADD(t.count, (uint32_t)-1, ZMAP_MO_RELEASE);
+        }
+    }
+
+    // Announces a reader in the current epoch. The owner of a slot bumps its own
+    // count with a plain store and a fence; the re-check after the fence pairs
+    // with the one in synchronize(), so a flip cannot miss the count.
+    static inline zmap_seq_ticket zmap_seq_enter(uint32_t *epoch, zmap_seq_slot *slots, uint32_t bits)
+    {
+        uint32_t *self = zmap_seq_thread();
+        uintptr_t token = (uintptr_t)self;
+        zmap_seq_slot *slot = &slots[(*self - 1) & ((1u << bits) - 1)];
+        uintptr_t owner = ZMAP_ATOMIC_LOAD(&slot->owner, ZMAP_MO_RELAXED);
+        if (0 == owner && ZMAP_ATOMIC_CAS(&slot->owner, &owner, token, ZMAP_MO_RELAXED))
+        {
+            owner = token;
+        }
+        zmap_seq_ticket t;
+        t.owned = (owner == token);
+        for (;;)
+        {
+            uint32_t e = ZMAP_ATOMIC_LOAD(epoch, ZMAP_MO_RELAXED);
+            if (t.owned)
+            {
+                t.count = &slot->readers[e & 1];
+                ZMAP_ATOMIC_STORE(t.count, ZMAP_ATOMIC_LOAD(t.count, ZMAP_MO_RELAXED) + 1, ZMAP_MO_RELAXED);
+            }
+            else
+            {
+                t.count = &slot->shared[e & 1];
+                ZMAP_ATOMIC_ADD(t.count, 1u, ZMAP_MO_RELAXED);
+            }
+            ZMAP_ATOMIC_FENCE(ZMAP_MO_SEQ_CST);
+            if (ZMAP_ATOMIC_LOAD(epoch, ZMAP_MO_RELAXED) == e)
+            {
+                return t;
+            }
+            zmap_seq_exit(t);
+        }
+    }
+
+    // Grace period: flips the epoch and waits until every reader that entered
+    // under the old one has left. Callers publish the new table first.
+    static inline void zmap_seq_synchronize(uint32_t *epoch, zmap_seq_slot *slots, size_t n)
+    {
+        uint32_t old = ZMAP_ATOMIC_LOAD(epoch, ZMAP_MO_RELAXED);
+        ZMAP_ATOMIC_STORE(epoch, old + 1, ZMAP_MO_SEQ_CST);
+        ZMAP_ATOMIC_FENCE(ZMAP_MO_SEQ_CST);
+        for (size_t i = 0; i < n; i++)
+        {
+            while (0 != ZMAP_ATOMIC_LOAD(&slots[i].readers[old & 1], ZMAP_MO_ACQUIRE) ||
+                   0 != ZMAP_ATOMIC_LOAD(&slots[i].shared[old & 1], ZMAP_MO_ACQUIRE))
+            {
+                ZMAP_CPU_RELAX();
+            }
+        }
+    }
+#endif
+
+
+/* * Implementation injection (C vs C++).
+ * C++ uses new/delete/move for proper RAII.
+ * C uses calloc/free/struct-copy.
+ */
+#ifdef __cplusplus
+#   define ZMAP_IMPL_OPS(KeyT, ValT, Name, HASH, EQ, KeyParam, KEY_OF, KEY_PARAM)                                   \
+        static inline void zmap_free_##Name(zmap_##Name *m)                                                         \
+        {                                                                                                           \
+            ZMAP_FREE_ARRAY(zmap_bucket_##Name, &m->alloc, m->buckets, m->capacity);                                \
+            m->buckets = nullptr;                                                                                   \
+            m->count = 0;                                                                                           \
+            m->capacity = 0;                                                                                        \
+            m->threshold = 0;                                                                                       \
+            m->bits = 0;                                                                                            \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline void zmap_clear_##Name(zmap_##Name *m)                                                        \
+        {                                                                                                           \
+            for (size_t i = 0; i < m->capacity; i++)                                                                \
+            {                                                                                                       \
+                if (ZMAP_OCCUPIED == m->buckets[i].state)                                                           \
+                {                                                                                                   \
+                    m->buckets[i] = zmap_bucket_##Name();                                                           \
+                }                                                                                                   \
+            }                                                                                                       \
+            m->count = 0;                                                                                           \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline int zmap_resize_##Name(zmap_##Name *m, size_t new_cap)                                        \
+        {                                                                                                           \
+            ZMAP_COUNT_TIMER(resize_start)                                                                          \
+            try                                                                                                     \
+            {                                                                                                       \
+                zmap_bucket_##Name *new_buckets = ZMAP_ALLOC_ARRAY(zmap_bucket_##Name, &m->alloc, new_cap);         \
+                if (!new_buckets)                                                                                   \
+                {                                                                                                   \
+                    return Z_ENOMEM;                                                                                \
+                }                                                                                                   \
+                uint32_t new_bits = 0;                                                                              \
+                size_t temp = new_cap;                                                                              \
+                while(temp >>= 1)                                                                                   \
+                {                                                                                                   \
+                    new_bits++;                                                                                     \
+                }                                                                                                   \
+                for (size_t i = 0; i < m->capacity; i++)                                                            \
+                {                                                                                                   \
+                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
+                    {                                                                                               \
+                        zmap_bucket_##Name entry = std::move(m->buckets[i]);                                        \
+                        size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
+                        size_t dist = 0;                                                                            \
+                        for (;;)                                                                                    \
+                        {                                                                                           \
+                            if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
+                            {                                                                                       \
+                                new_buckets[idx] = std::move(entry);                                                \
+                                new_buckets[idx].state = ZMAP_OCCUPIED;                                             \
+                                break;                                                                              \
+                            }                                                                                       \
+                            size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
+                            if (dist > existing_dist)                                                               \
+                            {                                                                                       \
+                                std::swap(new_buckets[idx], entry);                                                 \
+                                dist = existing_dist;                                                               \
+                            }                                                                                       \
+                            idx = (idx + 1) & (new_cap - 1); dist++;                                                \
+                        }                                                                                           \
+                    }                                                                                               \
+                }                                                                                                   \
+                ZMAP_FREE_ARRAY(zmap_bucket_##Name, &m->alloc, m->buckets, m->capacity);                            \
+                m->buckets = new_buckets;                                                                           \
+                m->capacity = new_cap;                                                                              \
+                m->bits = new_bits;                                                                                 \
+                m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
+                ZMAP_COUNT_RESIZE(m, resize_start);                                                                 \
+                return Z_OK;                                                                                        \
+            }                                                                                                       \
+            catch (...)                                                                                             \
+            {                                                                                                       \
+                return Z_ENOMEM;                                                                                    \
+            }                                                                                                       \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline int zmap_put_hashed_##Name(zmap_##Name *m, KeyParam key, ValT val, zmap_hash_t hash)          \
+        {                                                                                                           \
+            ZMAP_COUNT(m, puts, 1);                                                                                 \
+            try                                                                                                     \
+            {                                                                                                       \
+                size_t idx = zmap_fib_index(hash, m->bits);                                                         \
+                size_t dist = 0;                                                                                    \
+                zmap_bucket_##Name entry;                                                                           \
+                entry.key = KEY_OF(key);                                                                            \
+                entry.value = val;                                                                                  \
+                entry.stored_hash = hash;                                                                           \
+                entry.state = ZMAP_OCCUPIED;                                                                        \
+                for (;;)                                                                                            \
+                {                                                                                                   \
+                    if (ZMAP_EMPTY == m->buckets[idx].state) {                                                      \
+                        m->buckets[idx] = std::move(entry);                                                         \
+                        m->count++;                                                                                 \
+                        return Z_OK;                                                                                \
+                    }                                                                                               \
+                    if (m->buckets[idx].stored_hash == hash && EQ(KEY_PARAM(m->buckets[idx].key), key))             \
+                    {                                                                                               \
+                        m->buckets[idx].value = val;                                                                \
+                        return Z_OK;                                                                                \
+                    }                                                                                               \
+                    size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
+                    if (dist > existing_dist)                                                                       \
+                    {                                                                                               \
+                        std::swap(m->buckets[idx], entry);                                                          \
+                        dist = existing_dist;                                                                       \
+                    }                                                                                               \
+                    ZMAP_COUNT(m, probes, 1);                                                                       \
+                    idx = (idx + 1) & (m->capacity - 1); dist++;                                                    \
+                }                                                                                                   \
+            }                                                                                                       \
+            catch (...)                                                                                             \
+            {                                                                                                       \
+                return Z_ENOMEM;                                                                                    \
+            }                                                                                                       \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline int zmap_put_##Name(zmap_##Name *m, KeyParam key, ValT val)                                   \
+        {                                                                                                           \
+            if (m->count >= m->threshold)                                                                           \
+            {                                                                                                       \
+                size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                      \
+                if (Z_OK != zmap_resize_##Name(m, new_cap))                                                         \
+                {                                                                                                   \
+                    return Z_ENOMEM;                                                                                \
+                }                                                                                                   \
+            }                                                                                                       \
+            zmap_hash_t hash;                                                                                       \
+            ZMAP_TRY_HASH(hash, HASH(key, m->seed));                                                                \
+            return zmap_put_hashed_##Name(m, key, val, hash);                                                       \
+        }
+
+#   define ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                                   \
+        static inline ValT* zmap_new_val_stable_##Name(zmap_stable_##Name *m, ValT const &val)                      \
+        {                                                                                                           \
+            if (!m->arena.enabled)                                                                                  \
+            {                                                                                                       \
+                return new ValT(val);                                                                               \
+            }                                                                                                       \
+            void *p = zmap_arena_alloc(&m->arena, ZMAP_ARENA_CHUNK(ValT), ZMAP_ALIGNOF(ValT));                      \
+            if (!p)                                                                                                 \
+            {                                                                                                       \
+                throw std::bad_alloc();                                                                             \
+            }                                                                                                       \
+            try                                                                                                     \
+            {                                                                                                       \
+                return new (p) ValT(val);                                                                           \
+            }                                                                                                       \
+            catch(...)                                                                                              \
+            {                                                                                                       \
+                zmap_arena_release(&m->arena, p);                                                                   \
+                throw;                                                                                              \
+            }                                                                                                       \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline void zmap_remove_val_stable_##Name(zmap_stable_##Name *m, ValT *ptr)                          \
+        {                                                                                                           \
+            if (!m->arena.enabled)                                                                                  \
+            {                                                                                                       \
+                delete ptr;                                                                                         \
+                return;                                                                                             \
+            }                                                                                                       \
+            z_map::detail::destroy(ptr);                                                                            \
+            zmap_arena_release(&m->arena, ptr);                                                                     \
+        }                                                                                                           \
+                                                                                                                    \
+        /* Values that need no destructor go with their slabs, so the arena path                                    \
+         * skips the bucket walk: trivially copyable buckets are reset in bulk. */                                  \
+        static inline void zmap_clear_stable_##Name(zmap_stable_##Name *m)                                          \
+        {                                                                                                           \
+            bool drop = m->arena.enabled && std::is_trivially_destructible<ValT>::value;                            \
+            if (drop && std::is_trivially_copyable<zmap_bucket_stable_##Name>::value)                               \
+            {                                                                                                       \
+                if (m->buckets)                                                                                     \
+                {                                                                                                   \
+                    memset((void*)m->buckets, 0, m->capacity * sizeof(zmap_bucket_stable_##Name));                  \
+                }                                                                                                   \
+            }                                                                                                       \
+            else                                                                                                    \
+            {                                                                                                       \
+                for (size_t i = 0; i < m->capacity; i++)                                                            \
+                {                                                                                                   \
+                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
+                    {                                                                                               \
+                        if (!drop)                                                                                  \
+                        {                                                                                           \
+                            zmap_remove_val_stable_##Name(m, m->buckets[i].value);                                  \
+                        }                                                                                           \
+                        m->buckets[i].state = ZMAP_EMPTY;                                                           \
+                    }                                                                                               \
+                }                                                                                                   \
+            }                                                                                                       \
+            zmap_arena_free(&m->arena);                                                                             \
+            m->count = 0;                                                                                           \
+        }                                                                                                           \
+                                                                                                                    \
+        /* O(slabs) with an arena and trivially destructible values. */                                             \
+        static inline void zmap_free_stable_##Name(zmap_stable_##Name *m)                                           \
+        {                                                                                                           \
+            if (m->arena.enabled && std::is_trivially_destructible<ValT>::value)                                    \
+            {                                                                                                       \
+                zmap_arena_free(&m->arena);                                                                         \
+            }                                                                                                       \
+            else                                                                                                    \
+            {                                                                                                       \
+                zmap_clear_stable_##Name(m);                                                                        \
+            }                                                                                                       \
+            delete[] m->buckets;                                                                                    \
+            *m = zmap_stable_##Name();                                                                              \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline int zmap_resize_stable_##Name(zmap_stable_##Name *m, size_t new_cap)                          \
+        {                                                                                                           \
+            try                                                                                                     \
+            {                                                                                                       \
+                zmap_bucket_stable_##Name *new_buckets = new zmap_bucket_stable_##Name[new_cap]();                  \
+                uint32_t new_bits = 0;                                                                              \
+                size_t temp = new_cap;                                                                              \
+                while(temp >>= 1)                                                                                   \
+                {                                                                                                   \
+                    new_bits++;                                                                                     \
+                }                                                                                                   \
+                for (size_t i = 0; i < m->capacity; i++)                                                            \
+                {                                                                                                   \
+                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
+                    {                                                                                               \
+                        zmap_bucket_stable_##Name entry = m->buckets[i];                                            \
+                        size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
+                        size_t dist = 0;                                                                            \
+                        for (;;)                                                                                    \
+                        {                                                                                           \
+                            if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
+                            {                                                                                       \
+                                new_buckets[idx] = entry; new_buckets[idx].state = ZMAP_OCCUPIED; break;            \
+                            }                                                                                       \
+                            size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
+                            if (dist > existing_dist)                                                               \
+                            {                                                                                       \
+                                std::swap(new_buckets[idx], entry);                                                 \
+                                dist = existing_dist;                                                               \
+                            }                                                                                       \
+                            idx = (idx + 1) & (new_cap - 1); dist++;                                                \
+                        }                                                                                           \
+                    }                                                                                               \
+                }                                                                                                   \
+                if (m->buckets)                                                                                     \
+                {                                                                                                   \
+                    delete[] m->buckets;                                                                            \
+                }                                                                                                   \
+                m->buckets = new_buckets;                                                                           \
+                m->capacity = new_cap;                                                                              \
+                m->bits = new_bits;                                                                                 \
+                m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
+                return Z_OK;                                                                                        \
+            }                                                                                                       \
+            catch(...)                                                                                              \
+            {                                                                                                       \
+                return Z_ENOMEM;                                                                                    \
+            }                                                                                                       \
+        }                                                                                                           \
+                                                                                                                    \
+        static inline int zmap_put_stable_##Name(zmap_stable_##Name *m, KeyT key, ValT val)                         \
+        {                                                                                                           \
+            try                                                                                                     \
+            {                                                                                                       \
+                if (m->count >= m->threshold)                                                                       \
+                {                                                                                                   \
+                    size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                  \
+                    if (Z_OK != zmap_resize_stable_##Name(m, new_cap))                                              \
+                    {                                                                                               \
+                        return Z_ENOMEM;                                                                            \
+                    }                                                                                               \
+                }                                                                                                   \
+                zmap_hash_t hash = m->hash_func(key, m->seed);                                                      \
+                size_t idx = zmap_fib_index(hash, m->bits);                                                         \
+                size_t dist = 0;                                                                                    \
+                zmap_bucket_stable_##Name entry;                                                                    \
+                entry.key = key;                                                                                    \
+                entry.value = nullptr;                                                                              \
+                entry.stored_hash = hash;                                                                           \
+                entry.state = ZMAP_OCCUPIED;                                                                        \
+                for (;;)                                                                                            \
+                {                                                                                                   \
+                    if (ZMAP_EMPTY == m->buckets[idx].state)                                                        \
+                    {                                                                                               \
+                        if (!entry.value)                                                                           \
+                        {                                                                                           \
+                            entry.value = zmap_new_val_stable_##Name(m, val);                                       \
+                        }                                                                                           \
+                        m->buckets[idx] = entry;                                                                    \
+                        m->count++;                                                                                 \
+                        return Z_OK;                                                                                \
+                    }                                                                                               \
+                    if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))          \
+                    {                                                                                               \
+                        *m->buckets[idx].value = val;                                                               \
+                        return Z_OK;                                                                                \
+                    }                                                                                               \
+                    size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
+                    if (dist > existing_dist)                                                                       \
+                    {                                                                                               \
+                        if (!entry.value)                                                                           \
+                        {                                                                                           \
+                            entry.value = zmap_new_val_stable_##Name(m, val);                                       \
+                        }                                                                                           \
+                        std::swap(m->buckets[idx], entry);                                                          \
+                        dist = existing_dist;                                                                       \
+                    }                                                                                               \
+                    idx = (idx + 1) & (m->capacity - 1); dist++;                                                    \
+                }                                                                                                   \
+            }                                                                                                       \
+            catch(...)                                                                                              \
+            {                                                                                                       \
+                return Z_ENOMEM;                                                                                    \
+            }                                                                                                       \
+        }
+#else
+#   define ZMAP_IMPL_OPS(KeyT, ValT, Name, HASH, EQ, KeyParam, KEY_OF, KEY_PARAM)                                       \
+        static inline void zmap_free_##Name(zmap_##Name *m)                                                             \
+        {                                                                                                               \
+            ZMAP_FREE_ARRAY(zmap_bucket_##Name, &m->alloc, m->buckets, m->capacity); *m = (zmap_##Name){0};             \
+        }                                                                                                               \
+                                                                                                                        \
+        static inline void zmap_clear_##Name(zmap_##Name *m)                                                            \
+        {                                                                                                               \
+             if (m->capacity > 0)                                                                                       \
+             {                                                                                                          \
+                memset(m->buckets, 0, m->capacity * sizeof(zmap_bucket_##Name));                                        \
+             }                                                                                                          \
+             m->count = 0;                                                                                              \
+        }                                                                                                               \
+                                                                                                                        \
+        static inline int zmap_resize_##Name(zmap_##Name *m, size_t new_cap)                                            \
+        {                                                                                                               \
+            ZMAP_COUNT_TIMER(resize_start)                                                                              \
+            zmap_bucket_##Name *new_buckets = ZMAP_ALLOC_ARRAY(zmap_bucket_##Name, &m->alloc, new_cap);                 \
+            if (!new_buckets)                                                                                           \
+            {                                                                                                           \
+                return Z_ENOMEM;                                                                                        \
+            }                                                                                                           \
+            uint32_t new_bits = 0;                                                                                      \
+            size_t temp = new_cap;                                                                                      \
+            while(temp >>= 1)                                                                                           \
+            {                                                                                                           \
+                new_bits++;                                                                                             \
+            }                                                                                                           \
+            for (size_t i = 0; i < m->capacity; i++)                                                                    \
+            {                                                                                                           \
+                if (ZMAP_OCCUPIED == m->buckets[i].state)                                                               \
+                {                                                                                                       \
+                    zmap_bucket_##Name entry = m->buckets[i];                                                           \
+                    size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                           \
+                    size_t dist = 0;                                                                                    \
+                    for (;;)                                                                                            \
+                    {                                                                                                   \
+                        if (ZMAP_EMPTY == new_buckets[idx].state)                                                       \
+                        {                                                                                               \
+                            new_buckets[idx] = entry;                                                                   \
+                            new_buckets[idx].state = ZMAP_OCCUPIED;                                                     \
+                            break;                                                                                      \
+                        }                                                                                               \
+                        size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits);         \
+                        if (dist > existing_dist)                                                                       \
+                        {                                                                                               \
+                            zmap_bucket_##Name swap_tmp = new_buckets[idx];                                             \
+                            new_buckets[idx] = entry;                                                                   \
+                            entry = swap_tmp;                                                                           \
+                            dist = existing_dist;                                                                       \
+                        }                                                                                               \
+                        idx = (idx + 1) & (new_cap - 1);                                                                \
+                        dist++;                                                                                         \
+                    }                                                                                                   \
+                }                                                                                                       \
+            }                                                                                                           \
+            ZMAP_FREE_ARRAY(zmap_bucket_##Name, &m->alloc, m->buckets, m->capacity);                                    \
+            m->buckets = new_buckets;                                                                                   \
+            m->capacity = new_cap;                                                                                      \
+            m->bits = new_bits;                                                                                         \
+            m->threshold = (size_t)(new_cap * m->load_factor);                                                          \
+            ZMAP_COUNT_RESIZE(m, resize_start);                                                                         \
+            return Z_OK;                                                                                                \
+        }                                                                                                               \
+                                                                                                                        \
+        static inline int zmap_put_hashed_##Name(zmap_##Name *m, KeyParam key, ValT val, zmap_hash_t hash)              \
+        {                                                                                                               \
+            size_t idx = zmap_fib_index(hash, m->bits);                                                                 \
+            size_t dist = 0;                                                                                            \
+            ZMAP_COUNT(m, puts, 1);                                                                                     \
+            zmap_bucket_##Name entry = (zmap_bucket_##Name){                                                            \
+                .key = KEY_OF(key), .value = val, .stored_hash = hash, .state = ZMAP_OCCUPIED };                        \
+            for (;;)                                                                                                    \
+            {                                                                                                           \
+                if (ZMAP_EMPTY == m->buckets[idx].state)                                                                \
+                {                                                                                                       \
+                    m->buckets[idx] = entry;                                                                            \
+                    m->count++;                                                                                         \
+                    return Z_OK;                                                                                        \
+                }                                                                                                       \
+                if (m->buckets[idx].stored_hash == hash && EQ(KEY_PARAM(m->buckets[idx].key), key))                     \
+                {                                                                                                       \
+                    m->buckets[idx].value = val;                                                                        \
+                    return Z_OK;                                                                                        \
+                }                                                                                                       \
+                size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);               \
+                if (dist > existing_dist)                                                                               \
+                {                                                                                                       \
+                    zmap_bucket_##Name swap_tmp = m->buckets[idx];                                                      \
+                    m->buckets[idx] = entry;                                                                            \
+                    entry = swap_tmp;                                                                                   \
+                    dist = existing_dist;                                                                               \
+                }                                                                                                       \
+                ZMAP_COUNT(m, probes, 1);                                                                               \
+                idx = (idx + 1) & (m->capacity - 1);                                                                    \
+                dist++;                                                                                                 \
+            }                                                                                                           \
+        }                                                                                                               \
+                                                                                                                        \
+        static inline int zmap_put_##Name(zmap_##Name *m, KeyParam key, ValT val)                                       \
+        {                                                                                                               \
+            if (m->count >= m->threshold)                                                                               \
+            {                                                                                                           \
+                size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                          \
+                if (Z_OK != zmap_resize_##Name(m, new_cap))                                                             \
+                {                                                                                                       \
+                    return Z_ENOMEM;                                                                                    \
+                }                                                                                                       \
+            }                                                                                                           \
+            return zmap_put_hashed_##Name(m, key, val, HASH(key, m->seed));                                             \
+        }
+
+#   define ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                               \
+        static inline ValT* zmap_new_val_stable_##Name(zmap_stable_##Name *m, ValT val)                         \
+        {                                                                                                       \
+            ValT *p = m->arena.enabled                                                                          \
+                    ? (ValT*)zmap_arena_alloc(&m->arena, ZMAP_ARENA_CHUNK(ValT), ZMAP_ALIGNOF(ValT))            \
+                    : (ValT*)ZMAP_MALLOC(sizeof(ValT));                                                         \
+            if (p)                                                                                              \
+            {                                                                                                   \
+                *p = val;                                                                                       \
+            }                                                                                                   \
+            return p;                                                                                           \
+        }                                                                                                       \
+                                                                                                                \
+        static inline void zmap_remove_val_stable_##Name(zmap_stable_##Name *m, ValT *ptr)                      \
+        {                                                                                                       \
+            if (m->arena.enabled)                                                                               \
+            {                                                                                                   \
+                zmap_arena_release(&m->arena, ptr);                                                             \
+            }                                                                                                   \
+            else                                                                                                \
+            {                                                                                                   \
+                ZMAP_FREE(ptr);                                                                                 \
+            }                                                                                                   \
+        }                                                                                                       \
+                                                                                                                \
+        /* With an arena the values go with their slabs, so buckets are reset in bulk. */                       \
+        static inline void zmap_clear_stable_##Name(zmap_stable_##Name *m)                                      \
+        {                                                                                                       \
+            if (m->arena.enabled)                                                                               \
+            {                                                                                                   \
+                if (m->buckets)                                                                                 \
+                {                                                                                               \
+                    memset(m->buckets, 0, m->capacity * sizeof(zmap_bucket_stable_##Name));                     \
+                }                                                                                               \
+            }                                                                                                   \
+            else                                                                                                \
+            {                                                                                                   \
+                for (size_t i = 0; i < m->capacity; i++)                                                        \
+                {                                                                                               \
+                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                   \
+                    {                                                                                           \
+                        ZMAP_FREE(m->buckets[i].value);                                                         \
+                        m->buckets[i].state = ZMAP_EMPTY;                                                       \
+                    }                                                                                           \
+                }                                                                                               \
+            }                                                                                                   \
+            zmap_arena_free(&m->arena);                                                                         \
+            m->count = 0;                                                                                       \
+        }                                                                                                       \
+                                                                                                                \
+        /* O(slabs) with an arena: no bucket is visited. */                                                     \
+        static inline void zmap_free_stable_##Name(zmap_stable_##Name *m)                                       \
+        {                                                                                                       \
+            if (m->arena.enabled)                                                                               \
+            {                                                                                                   \
+                zmap_arena_free(&m->arena);                                                                     \
+            }                                                                                                   \
+            else                                                                                                \
+            {                                                                                                   \
+                zmap_clear_stable_##Name(m);                                                                    \
+            }                                                                                                   \
+            ZMAP_FREE(m->buckets);                                                                              \
+            *m = (zmap_stable_##Name){0};                                                                       \
+        }                                                                                                       \
+                                                                                                                \
+        static inline int zmap_resize_stable_##Name(zmap_stable_##Name *m, size_t new_cap)                      \
+        {                                                                                                       \
+            zmap_bucket_stable_##Name *new_buckets = (zmap_bucket_stable_##Name*)                               \
+                                                     ZMAP_CALLOC(new_cap, sizeof(zmap_bucket_stable_##Name));   \
+            if (!new_buckets)                                                                                   \
+            {                                                                                                   \
+                return Z_ENOMEM;                                                                                \
+            }                                                                                                   \
+            uint32_t new_bits = 0;                                                                              \
+            size_t temp = new_cap;                                                                              \
+            while(temp >>= 1)                                                                                   \
+            {                                                                                                   \
+                new_bits++;                                                                                     \
+            }                                                                                                   \
+            for (size_t i = 0; i < m->capacity; i++)                                                            \
+            {                                                                                                   \
+                if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
+                {                                                                                               \
+                    zmap_bucket_stable_##Name entry = m->buckets[i];                                            \
+                    size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
+                    size_t dist = 0;                                                                            \
+                    for (;;)                                                                                    \
+                    {                                                                                           \
+                        if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
+                        {                                                                                       \
+                            new_buckets[idx] = entry;                                                           \
+                            new_buckets[idx].state = ZMAP_OCCUPIED;                                             \
+                            break;                                                                              \
+                        }                                                                                       \
+                        size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
+                        if (dist > existing_dist)                                                               \
+                        {                                                                                       \
+                            zmap_bucket_stable_##Name tmp = new_buckets[idx];                                   \
+                            new_buckets[idx] = entry;                                                           \
+                            entry = tmp;                                                                        \
+                            dist = existing_dist;                                                               \
+                        }                                                                                       \
+                        idx = (idx + 1) & (new_cap - 1);                                                        \
+                        dist++;                                                                                 \
+                    }                                                                                           \
+                }                                                                                               \
+            }                                                                                                   \
+            ZMAP_FREE(m->buckets);                                                                              \
+            m->buckets = new_buckets;                                                                           \
+            m->capacity = new_cap;                                                                              \
+            m->bits = new_bits;                                                                                 \
+            m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
+            return Z_OK;                                                                                        \
+        }                                                                                                       \
+                                                                                                                \
+        static inline int zmap_put_stable_##Name(zmap_stable_##Name *m, KeyT key, ValT val)                     \
+        {                                                                                                       \
+            if (m->count >= m->threshold)                                                                       \
+            {                                                                                                   \
+                size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                  \
+                if (Z_OK != zmap_resize_stable_##Name(m, new_cap))                                              \
+                {                                                                                               \
+                    return Z_ENOMEM;                                                                            \
+                }                                                                                               \
+            }                                                                                                   \
+            zmap_hash_t hash = m->hash_func(key, m->seed);                                                      \
+            size_t idx = zmap_fib_index(hash, m->bits);                                                         \
+            size_t dist = 0;                                                                                    \
+            zmap_bucket_stable_##Name entry = (zmap_bucket_stable_##Name){                                      \
+                .key = key, .value = NULL, .stored_hash = hash, .state = ZMAP_OCCUPIED };                       \
+            for (;;)                                                                                            \
+            {                                                                                                   \
+                if (ZMAP_EMPTY == m->buckets[idx].state)                                                        \
+                {                                                                                               \
+                    if (!entry.value)                                                                           \
+                    {                                                                                           \
+                        entry.value = zmap_new_val_stable_##Name(m, val);                                       \
+                        if (!entry.value)                                                                       \
+                        {                                                                                       \
+                            return Z_ENOMEM;                                                                    \
+                        }                                                                                       \
+                    }                                                                                           \
+                    m->buckets[idx] = entry;                                                                    \
+                    m->count++;                                                                                 \
+                    return Z_OK;                                                                                \
+                }                                                                                               \
+                if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))          \
+                {                                                                                               \
+                     *m->buckets[idx].value = val;                                                              \
+                     return Z_OK;                                                                               \
+                }                                                                                               \
+                size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
+                if (dist > existing_dist)                                                                       \
+                {                                                                                               \
+                    if (!entry.value)                                                                           \
+                    {                                                                                           \
+                        entry.value = zmap_new_val_stable_##Name(m, val);                                       \
+                        if (!entry.value)                                                                       \
+                        {                                                                                       \
+                            return Z_ENOMEM;                                                                    \
+                        }                                                                                       \
+                    }                                                                                           \
+                    zmap_bucket_stable_##Name temp = m->buckets[idx];                                           \
+                    m->buckets[idx] = entry;                                                                    \
+                    entry = temp;                                                                               \
+                    dist = existing_dist;                                                                       \
+                }                                                                                               \
+                idx = (idx + 1) & (m->capacity - 1);                                                            \
+                dist++;                                                                                         \
+            }                                                                                                   \
+        }
+#endif
+
+/*
+ * ZMAP_GENERATE_IMPL_KEYED
+ * Standard In-Place Map Generator. HASH(key, seed) and EQ(a, b) are expanded
+ * directly into the generated code (see ZMAP_GENERATE_IMPL for the defaults).
+ * KeyParam is the type the API takes keys as: KeyT, or KeyT const * for
+ * by-reference maps. KEY_OF turns a KeyParam into the stored KeyT, and
+ * KEY_PARAM turns a stored key back into a KeyParam for HASH and EQ.
+ */
+#define ZMAP_GENERATE_IMPL_KEYED(KeyT, ValT, Name, HASH, EQ, KeyParam, KEY_OF, KEY_PARAM)                                    \
+    typedef struct                                                                                                           \
+    {                                                                                                                        \
+        KeyT key;                                                                                                            \
+        ValT value;                                                                                                          \
+        zmap_hash_t stored_hash;                                                                                             \
+        zmap_state state;                                                                                                    \
+    } zmap_bucket_##Name;                                                                                                    \
+                                                                                                                             \
+    typedef struct                                                                                                           \
+    {                                                                                                                        \
+        zmap_bucket_##Name *buckets;                                                                                         \
+        size_t capacity;                                                                                                     \
+        size_t count;                                                                                                        \
+        size_t threshold;                                                                                                    \
+        uint32_t bits;                                                                                                       \
+        float  load_factor;                                                                                                  \
+        uint32_t seed;                                                                                                       \
+        zmap_hash_t (*hash_func)(KeyParam, uint32_t);                                                                        \
+        int      (*cmp_func)(KeyParam, KeyParam);                                                                            \
+        zmap_allocator alloc;                                                                                                \
+        ZMAP_COUNTERS_FIELD                                                                                                  \
+    } zmap_##Name;                                                                                                           \
+                                                                                                                             \
+    typedef struct                                                                                                           \
+    {                                                                                                                        \
+        zmap_##Name *map;                                                                                                    \
+        size_t index;                                                                                                        \
+    } zmap_iter_##Name;                                                                                                      \
+                                                                                                                             \
+    static inline zmap_##Name zmap_init_ext_##Name(zmap_hash_t (*h)(KeyParam, uint32_t), int (*c)(KeyParam, KeyParam),       \
+                                                   float load)                                                               \
+    {                                                                                                                        \
+        return (zmap_##Name){                                                                                                \
+            .buckets = NULL, .capacity = 0, .count = 0, .threshold = 0,                                                      \
+            .bits = 0, .load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load,                             \
+            .seed = 0xCAFEBABE, .hash_func = h, .cmp_func = c, .alloc = { NULL, NULL, NULL }                                 \
+            ZMAP_COUNTERS_INIT                                                                                               \
+        };                                                                                                                   \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline zmap_##Name zmap_init_##Name(zmap_hash_t (*h)(KeyParam, uint32_t), int (*c)(KeyParam, KeyParam))           \
+    {                                                                                                                        \
+        return zmap_init_ext_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                                \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Buckets come from `a` instead of the global ZMAP_CALLOC/ZMAP_FREE. */                                                 \
+    static inline zmap_##Name zmap_init_alloc_##Name(zmap_hash_t (*h)(KeyParam, uint32_t), int (*c)(KeyParam, KeyParam),     \
+                                                     zmap_allocator a)                                                       \
+    {                                                                                                                        \
+        zmap_##Name m = zmap_init_ext_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                       \
+        m.alloc = a;                                                                                                         \
+        return m;                                                                                                            \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Only for an empty map: stored hashes and positions keep the old seed.                                                 \
+     * zmap_rehash changes the seed of a populated map. */                                                                   \
+    static inline void zmap_set_seed_##Name(zmap_##Name *m, uint32_t s)                                                      \
+    {                                                                                                                        \
+        m->seed = s;                                                                                                         \
+    }                                                                                                                        \
+                                                                                                                             \
+    ZMAP_IMPL_OPS(KeyT, ValT, Name, HASH, EQ, KeyParam, KEY_OF, KEY_PARAM)                                                   \
+                                                                                                                             \
+    static inline ValT* zmap_find_hashed_##Name(zmap_##Name *m, KeyParam key, zmap_hash_t hash)                              \
+    {                                                                                                                        \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                          \
+        size_t dist = 0;                                                                                                     \
+        for (;;)                                                                                                             \
+        {                                                                                                                    \
+            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                         \
+            {                                                                                                                \
+                ZMAP_COUNT(m, misses, 1);                                                                                    \
+                return NULL;                                                                                                 \
+            }                                                                                                                \
+            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                        \
+            if (dist > existing_dist)                                                                                        \
+            {                                                                                                                \
+                ZMAP_COUNT(m, misses, 1);                                                                                    \
+                return NULL;                                                                                                 \
+            }                                                                                                                \
+            if (m->buckets[idx].stored_hash == hash && EQ(KEY_PARAM(m->buckets[idx].key), key))                              \
+            {                                                                                                                \
+                ZMAP_COUNT(m, hits, 1);                                                                                      \
+                return &m->buckets[idx].value;                                                                               \
+            }                                                                                                                \
+            ZMAP_COUNT(m, probes, 1);                                                                                        \
+            idx = (idx + 1) & (m->capacity - 1);                                                                             \
+            dist++;                                                                                                          \
+        }                                                                                                                    \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline ValT* zmap_get_##Name(zmap_##Name *m, KeyParam key)                                                        \
+    {                                                                                                                        \
+        if (0 == m->count)                                                                                                   \
+        {                                                                                                                    \
+            ZMAP_COUNT(m, misses, 1);                                                                                        \
+            return NULL;                                                                                                     \
+        }                                                                                                                    \
+        return zmap_find_hashed_##Name(m, key, HASH(key, m->seed));                                                          \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Returns the value slot for key, claiming a bucket for it if it is absent.                                             \
+     * Hit and insertion point come from the same probe; *inserted reports which                                             \
+     * happened. A claimed slot holds the key, but its value is unspecified until                                            \
+     * the caller stores one. Returns NULL only when growing fails. */                                                       \
+    static inline ValT* zmap_insert_slot_##Name(zmap_##Name *m, KeyParam key, bool *inserted)                                \
+    {                                                                                                                        \
+        zmap_hash_t hash = HASH(key, m->seed);                                                                               \
+        size_t idx = 0;                                                                                                      \
+        size_t dist = 0;                                                                                                     \
+        if (m->count > 0)                                                                                                    \
+        {                                                                                                                    \
+            idx = zmap_fib_index(hash, m->bits);                                                                             \
+            while (ZMAP_EMPTY != m->buckets[idx].state &&                                                                    \
+                   dist <= zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits))                                \
+            {                                                                                                                \
+                if (m->buckets[idx].stored_hash == hash && EQ(KEY_PARAM(m->buckets[idx].key), key))                          \
+                {                                                                                                            \
+                    *inserted = false;                                                                                       \
+                    ZMAP_COUNT(m, hits, 1);                                                                                  \
+                    return &m->buckets[idx].value;                                                                           \
+                }                                                                                                            \
+                ZMAP_COUNT(m, probes, 1);                                                                                    \
+                idx = (idx + 1) & (m->capacity - 1);                                                                         \
+                dist++;                                                                                                      \
+            }                                                                                                                \
+        }                                                                                                                    \
+        if (m->count >= m->threshold || 0 == m->count)                                                                       \
+        {                                                                                                                    \
+            /* Growing (or a fresh table) moves the slot; redo the walk without compares. */                                 \
+            if (m->count >= m->threshold &&                                                                                  \
+                Z_OK != zmap_resize_##Name(m, zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity))))                                 \
+            {                                                                                                                \
+                return NULL;                                                                                                 \
+            }                                                                                                                \
+            idx = zmap_fib_index(hash, m->bits);                                                                             \
+            dist = 0;                                                                                                        \
+            while (ZMAP_EMPTY != m->buckets[idx].state &&                                                                    \
+                   dist <= zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits))                                \
+            {                                                                                                                \
+                idx = (idx + 1) & (m->capacity - 1);                                                                         \
+                dist++;                                                                                                      \
+            }                                                                                                                \
+        }                                                                                                                    \
+        /* Robin Hood insert at idx: shift the rest of the cluster right by one. */                                          \
+        size_t end = idx;                                                                                                    \
+        while (ZMAP_EMPTY != m->buckets[end].state)                                                                          \
+        {                                                                                                                    \
+            end = (end + 1) & (m->capacity - 1);                                                                             \
+        }                                                                                                                    \
+        while (end != idx)                                                                                                   \
+        {                                                                                                                    \
+            size_t prev = (end - 1) & (m->capacity - 1);                                                                     \
+            m->buckets[end] = ZMAP_MOVE(m->buckets[prev]);                                                                   \
+            end = prev;                                                                                                      \
+        }                                                                                                                    \
+        m->buckets[idx].key = KEY_OF(key);                                                                                   \
+        m->buckets[idx].stored_hash = hash;                                                                                  \
+        m->buckets[idx].state = ZMAP_OCCUPIED;                                                                               \
+        m->count++;                                                                                                          \
+        ZMAP_COUNT(m, misses, 1);                                                                                            \
+        ZMAP_COUNT(m, puts, 1);                                                                                              \
+        *inserted = true;                                                                                                    \
+        return &m->buckets[idx].value;                                                                                       \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Returns the value for key, inserting default_val first if it is absent.                                               \
+     * *inserted (optional) reports which happened. Returns NULL only when                                                   \
+     * growing fails. */                                                                                                     \
+    static inline ValT* zmap_get_or_insert_##Name(zmap_##Name *m, KeyParam key, ValT default_val, bool *inserted)            \
+    {                                                                                                                        \
+        bool added = false;                                                                                                  \
+        ValT *v = zmap_insert_slot_##Name(m, key, &added);                                                                   \
+        if (v && added)                                                                                                      \
+        {                                                                                                                    \
+            *v = ZMAP_MOVE(default_val);                                                                                     \
+        }                                                                                                                    \
+        if (inserted)                                                                                                        \
+        {                                                                                                                    \
+            *inserted = added;                                                                                               \
+        }                                                                                                                    \
+        return v;                                                                                                            \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Looks up n keys, keeping ZMAP_BATCH_WINDOW home buckets in flight so that                                             \
+     * cache misses overlap. out[i] receives the value pointer or NULL.                                                      \
+     * Returns the number of keys found. */                                                                                  \
+    static inline size_t zmap_get_many_##Name(zmap_##Name *m, KeyT const *keys, size_t n, ValT **out)                        \
+    {                                                                                                                        \
+        zmap_hash_t hashes[ZMAP_BATCH_WINDOW];                                                                               \
+        size_t found = 0;                                                                                                    \
+        if (0 == m->count)                                                                                                   \
+        {                                                                                                                    \
+            for (size_t i = 0; i < n; i++)                                                                                   \
+            {                                                                                                                \
+                out[i] = NULL;                                                                                               \
+            }                                                                                                                \
+            ZMAP_COUNT(m, misses, n);                                                                                        \
+            return 0;                                                                                                        \
+        }                                                                                                                    \
+        size_t ahead = (n < ZMAP_BATCH_WINDOW) ? n : ZMAP_BATCH_WINDOW;                                                      \
+        for (size_t i = 0; i < ahead; i++)                                                                                   \
+        {                                                                                                                    \
+            hashes[i] = HASH(KEY_PARAM(keys[i]), m->seed);                                                                   \
+            ZMAP_PREFETCH(&m->buckets[zmap_fib_index(hashes[i], m->bits)]);                                                  \
+        }                                                                                                                    \
+        for (size_t i = 0; i < n; i++)                                                                                       \
+        {                                                                                                                    \
+            size_t slot = i % ZMAP_BATCH_WINDOW;                                                                             \
+            zmap_hash_t hash = hashes[slot];                                                                                 \
+            if (i + ZMAP_BATCH_WINDOW < n)                                                                                   \
+            {                                                                                                                \
+                hashes[slot] = HASH(KEY_PARAM(keys[i + ZMAP_BATCH_WINDOW]), m->seed);                                        \
+                ZMAP_PREFETCH(&m->buckets[zmap_fib_index(hashes[slot], m->bits)]);                                           \
+            }                                                                                                                \
+            out[i] = zmap_find_hashed_##Name(m, KEY_PARAM(keys[i]), hash);                                                   \
+            found += (NULL != out[i]);                                                                                       \
+        }                                                                                                                    \
+        return found;                                                                                                        \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Sizes the table so that n entries fit without growing. */                                                             \
+    static inline int zmap_reserve_##Name(zmap_##Name *m, size_t n)                                                          \
+    {                                                                                                                        \
+        if (0 == n)                                                                                                          \
+        {                                                                                                                    \
+            return Z_OK;                                                                                                     \
+        }                                                                                                                    \
+        size_t need = zmap_capacity_for(n, m->load_factor);                                                                  \
+        return (need > m->capacity) ? zmap_resize_##Name(m, need) : Z_OK;                                                    \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Rehashes down to the smallest power of two that fits count.                                                           \
+     * An empty map releases its buckets entirely. */                                                                        \
+    static inline int zmap_shrink_to_fit_##Name(zmap_##Name *m)                                                              \
+    {                                                                                                                        \
+        if (0 == m->count)                                                                                                   \
+        {                                                                                                                    \
+            ZMAP_FREE_ARRAY(zmap_bucket_##Name, &m->alloc, m->buckets, m->capacity);                                         \
+            m->buckets = NULL;                                                                                               \
+            m->capacity = 0;                                                                                                 \
+            m->threshold = 0;                                                                                                \
+            m->bits = 0;                                                                                                     \
+            return Z_OK;                                                                                                     \
+        }                                                                                                                    \
+        size_t need = zmap_capacity_for(m->count, m->load_factor);                                                           \
+        return (need < m->capacity) ? zmap_resize_##Name(m, need) : Z_OK;                                                    \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Switches to seed s and re-places every entry inside the current bucket                                                \
+     * array; nothing is allocated. All entries are rehashed and marked pending                                              \
+     * first. Each pending entry is then lifted out and Robin Hood-inserted among                                            \
+     * the placed ones, where a pending slot counts as free and the entry it held                                            \
+     * is inserted next. After replacing m->hash_func, pass m->seed. */                                                      \
+    static inline void zmap_rehash_##Name(zmap_##Name *m, uint32_t s)                                                        \
+    {                                                                                                                        \
+        m->seed = s;                                                                                                         \
+        for (size_t i = 0; i < m->capacity; i++)                                                                             \
+        {                                                                                                                    \
+            if (ZMAP_OCCUPIED == m->buckets[i].state)                                                                        \
+            {                                                                                                                \
+                m->buckets[i].stored_hash = HASH(KEY_PARAM(m->buckets[i].key), s);                                           \
+                m->buckets[i].state = ZMAP_PENDING;                                                                          \
+            }                                                                                                                \
+        }                                                                                                                    \
+        for (size_t i = 0; i < m->capacity; i++)                                                                             \
+        {                                                                                                                    \
+            if (ZMAP_PENDING != m->buckets[i].state)                                                                         \
+            {                                                                                                                \
+                continue;                                                                                                    \
+            }                                                                                                                \
+            zmap_bucket_##Name entry = ZMAP_MOVE(m->buckets[i]);                                                             \
+            ZMAP_RESET(m->buckets[i]);                                                                                       \
+            m->buckets[i].state = ZMAP_EMPTY;                                                                                \
+            entry.state = ZMAP_OCCUPIED;                                                                                     \
+            size_t idx = zmap_fib_index(entry.stored_hash, m->bits);                                                         \
+            size_t dist = 0;                                                                                                 \
+            for (;;)                                                                                                         \
+            {                                                                                                                \
+                zmap_state st = m->buckets[idx].state;                                                                       \
+                if (ZMAP_OCCUPIED != st)                                                                                     \
+                {                                                                                                            \
+                    ZMAP_SWAP(zmap_bucket_##Name, m->buckets[idx], entry);                                                   \
+                    if (ZMAP_EMPTY == st)                                                                                    \
+                    {                                                                                                        \
+                        break;                                                                                               \
+                    }                                                                                                        \
+                    /* Took a pending slot: place its old entry from its own home. */                                        \
+                    entry.state = ZMAP_OCCUPIED;                                                                             \
+                    idx = zmap_fib_index(entry.stored_hash, m->bits);                                                        \
+                    dist = 0;                                                                                                \
+                    continue;                                                                                                \
+                }                                                                                                            \
+                size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                    \
+                if (dist > existing_dist)                                                                                    \
+                {                                                                                                            \
+                    ZMAP_SWAP(zmap_bucket_##Name, m->buckets[idx], entry);                                                   \
+                    dist = existing_dist;                                                                                    \
+                }                                                                                                            \
+                idx = (idx + 1) & (m->capacity - 1);                                                                         \
+                dist++;                                                                                                      \
+            }                                                                                                                \
+        }                                                                                                                    \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Inserts n pairs. Capacity for the whole batch is reserved up front, then                                              \
+     * target buckets are hashed and prefetched ZMAP_BATCH_WINDOW keys ahead. */                                             \
+    static inline int zmap_put_many_##Name(zmap_##Name *m, KeyT const *keys, ValT const *vals, size_t n)                     \
+    {                                                                                                                        \
+        zmap_hash_t hashes[ZMAP_BATCH_WINDOW];                                                                               \
+        if (0 == n)                                                                                                          \
+        {                                                                                                                    \
+            return Z_OK;                                                                                                     \
+        }                                                                                                                    \
+        if (Z_OK != zmap_reserve_##Name(m, m->count + n))                                                                    \
+        {                                                                                                                    \
+            return Z_ENOMEM;                                                                                                 \
+        }                                                                                                                    \
+        size_t ahead = (n < ZMAP_BATCH_WINDOW) ? n : ZMAP_BATCH_WINDOW;                                                      \
+        for (size_t i = 0; i < ahead; i++)                                                                                   \
+        {                                                                                                                    \
+            ZMAP_TRY_HASH(hashes[i], HASH(KEY_PARAM(keys[i]), m->seed));                                                     \
+            ZMAP_PREFETCH(&m->buckets[zmap_fib_index(hashes[i], m->bits)]);                                                  \
+        }                                                                                                                    \
+        for (size_t i = 0; i < n; i++)                                                                                       \
+        {                                                                                                                    \
+            size_t slot = i % ZMAP_BATCH_WINDOW;                                                                             \
+            zmap_hash_t hash = hashes[slot];                                                                                 \
+            if (i + ZMAP_BATCH_WINDOW < n)                                                                                   \
+            {                                                                                                                \
+                ZMAP_TRY_HASH(hashes[slot], HASH(KEY_PARAM(keys[i + ZMAP_BATCH_WINDOW]), m->seed));                          \
+                ZMAP_PREFETCH(&m->buckets[zmap_fib_index(hashes[slot], m->bits)]);                                           \
+            }                                                                                                                \
+            if (Z_OK != zmap_put_hashed_##Name(m, KEY_PARAM(keys[i]), vals[i], hash))                                        \
+            {                                                                                                                \
+                return Z_ENOMEM;                                                                                             \
+            }                                                                                                                \
+        }                                                                                                                    \
+        return Z_OK;                                                                                                         \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline bool zmap_remove_hashed_##Name(zmap_##Name *m, KeyParam key, zmap_hash_t hash)                             \
+    {                                                                                                                        \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                          \
+        size_t dist = 0;                                                                                                     \
+        for (;;)                                                                                                             \
+        {                                                                                                                    \
+            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                         \
+            {                                                                                                                \
+                return false;                                                                                                \
+            }                                                                                                                \
+            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                        \
+            if (dist > existing_dist)                                                                                        \
+            {                                                                                                                \
+                return false;                                                                                                \
+            }                                                                                                                \
+            if (m->buckets[idx].stored_hash == hash && EQ(KEY_PARAM(m->buckets[idx].key), key))                              \
+            {                                                                                                                \
+                ZMAP_COUNT(m, removes, 1);                                                                                   \
+                m->count--;                                                                                                  \
+                for (;;)                                                                                                     \
+                {                                                                                                            \
+                    size_t next = (idx + 1) & (m->capacity - 1);                                                             \
+                    if (ZMAP_EMPTY == m->buckets[next].state)                                                                \
+                    {                                                                                                        \
+                        m->buckets[idx].state = ZMAP_EMPTY;                                                                  \
+                        return true;                                                                                         \
+                    }                                                                                                        \
+                    size_t next_dist = zmap_dist(next, m->capacity, m->buckets[next].stored_hash, m->bits);                  \
+                    if (0 == next_dist)                                                                                      \
+                    {                                                                                                        \
+                        m->buckets[idx].state = ZMAP_EMPTY;                                                                  \
+                        return true;                                                                                         \
+                    }                                                                                                        \
+                    m->buckets[idx] = m->buckets[next];                                                                      \
+                    idx = next;                                                                                              \
+                }                                                                                                            \
+            }                                                                                                                \
+            ZMAP_COUNT(m, probes, 1);                                                                                        \
+            idx = (idx + 1) & (m->capacity - 1);                                                                             \
+            dist++;                                                                                                          \
+        }                                                                                                                    \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline zmap_iter_##Name zmap_iter_init_##Name(zmap_##Name *m)                                                     \
+    {                                                                                                                        \
+        return (zmap_iter_##Name){ .map = m, .index = 0 };                                                                   \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline bool zmap_iter_next_##Name(zmap_iter_##Name *it, KeyT *out_k, ValT *out_v)                                 \
+    {                                                                                                                        \
+        if (!it->map || !it->map->buckets)                                                                                   \
+        {                                                                                                                    \
+            return false;                                                                                                    \
+        }                                                                                                                    \
+        while (it->index < it->map->capacity)                                                                                \
+        {                                                                                                                    \
+            size_t i = it->index++;                                                                                          \
+            if (ZMAP_OCCUPIED == it->map->buckets[i].state)                                                                  \
+            {                                                                                                                \
+                if (out_k) *out_k = it->map->buckets[i].key;                                                                 \
+                if (out_v) *out_v = it->map->buckets[i].value;                                                               \
+                return true;                                                                                                 \
+            }                                                                                                                \
+        }                                                                                                                    \
+        return false;                                                                                                        \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline void zmap_remove_##Name(zmap_##Name *m, KeyParam key)                                                      \
+    {                                                                                                                        \
+        if (0 == m->count)                                                                                                   \
+        {                                                                                                                    \
+            return;                                                                                                          \
+        }                                                                                                                    \
+        zmap_remove_hashed_##Name(m, key, HASH(key, m->seed));                                                               \
+    }                                                                                                                        \
+                                                                                                                             \
+    static inline size_t zmap_size_##Name(zmap_##Name *m)                                                                    \
+    {                                                                                                                        \
+        return m->count;                                                                                                     \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Bytes held by the map: the struct and its bucket array. O(1). */                                                      \
+    static inline size_t zmap_memory_usage_##Name(zmap_##Name *m)                                                            \
+    {                                                                                                                        \
+        return sizeof(*m) + m->capacity * sizeof(zmap_bucket_##Name);                                                        \
+    }                                                                                                                        \
+                                                                                                                             \
+    /* Scans every bucket: O(capacity), meant for metrics rather than hot paths.                                             \
+     * Keys sharing a home slot are contiguous under Robin Hood, so a new home                                               \
+     * starts wherever the home differs from the previous slot's. */                                                         \
+    static inline void zmap_stats_##Name(zmap_##Name *m, zmap_stats *s)                                                      \
+    {                                                                                                                        \
+        size_t total = 0;                                                                                                    \
+        size_t run = 0;                                                                                                      \
+        size_t lead = SIZE_MAX;                                                                                              \
+        size_t prev_home = SIZE_MAX;                                                                                         \
+        memset(s, 0, sizeof(*s));                                                                                            \
+        s->count = m->count;                                                                                                 \
+        s->capacity = m->capacity;                                                                                           \
+        s->memory_bytes = zmap_memory_usage_##Name(m);                                                                       \
+        if (m->capacity && ZMAP_OCCUPIED == m->buckets[m->capacity - 1].state)                                               \
+        {                                                                                                                    \
+            prev_home = zmap_fib_index(m->buckets[m->capacity - 1].stored_hash, m->bits);                                    \
+        }                                                                                                                    \
+        for (size_t i = 0; i < m->capacity; i++)                                                                             \
+        {                                                                                                                    \
+            if (ZMAP_OCCUPIED != m->buckets[i].state)                                                                        \
+            {                                                                                                                \
+                lead = (SIZE_MAX == lead) ? run : lead;                                                                      \
+                s->longest_cluster = (run > s->longest_cluster) ? run : s->longest_cluster;                                  \
+                run = 0;                                                                                                     \
+                prev_home = SIZE_MAX;                                                                                        \
+                continue;                                                                                                    \
+            }                                                                                                                \
+            zmap_hash_t hash = m->buckets[i].stored_hash;                                                                    \
+            size_t dist = zmap_dist(i, m->capacity, hash, m->bits);                                                          \
+            size_t home = zmap_fib_index(hash, m->bits);                                                                     \
+            run++;                                                                                                           \
+            total += dist;                                                                                                   \
+            s->max_probe = (dist > s->max_probe) ? dist : s->max_probe;                                                      \
+            s->probe_hist[(dist < ZMAP_STATS_BINS - 1) ? dist : ZMAP_STATS_BINS - 1]++;                                      \
+            s->distinct_homes += (home != prev_home);                                                                        \
+            prev_home = home;                                                                                                \
+        }                                                                                                                    \
+        run += (SIZE_MAX == lead) ? 0 : lead;                                                                                \
+        run = (run < m->capacity) ? run : m->capacity;                                                                       \
+        s->longest_cluster = (run > s->longest_cluster) ? run : s->longest_cluster;                                          \
+        zmap_stats_finish(s, total);                                                                                         \
+    }                                                                                                                        \
+                                                                                                                             \
+    ZMAP_COUNTERS_API(Name)                                                                                                  \
+                                                                                                                             \
+    ZMAP_GEN_SAFE_IMPL(KeyParam, ValT, Name)
+
+/*
+ * ZMAP_GENERATE_IMPL
+ * Standard map calling the hash/compare function pointers given at init.
+ *
+ * ZMAP_GENERATE_IMPL_INLINE
+ * Standard map with the hash and equality baked in at compile time, so the
+ * compiler can inline them. HASH(key, seed) returns zmap_hash_t and EQ(a, b)
+ * returns non-zero when the keys are equal. Either may be a function, a
+ * function-like macro or (in C++) a functor expression such as `MyHash{}`.
+ *
+ * ZMAP_GENERATE_REF_IMPL
+ * Standard map whose API and hash/compare callbacks take `KeyT const *`
+ * instead of `KeyT`. Large keys (hashes, std::string) are then never copied
+ * on lookup; only insertion copies the key into its bucket.
+ */
+#define ZMAP_FN_HASH(k, s) m->hash_func(k, s)
+#define ZMAP_FN_EQ(a, b)   (0 == m->cmp_func(a, b))
+
+// Key passing: KEY_OF turns a key parameter into a key, KEY_PARAM a stored key into a parameter.
+#define ZMAP_KEY_SELF(k)   (k)
+#define ZMAP_KEY_DEREF(k)  (*(k))
+#define ZMAP_KEY_ADDR(k)   (&(k))
+
+// By-value keys, for the standard and inline maps.
+#define ZMAP_GENERATE_IMPL_EX(KeyT, ValT, Name, HASH, EQ)                                                   \
+    ZMAP_GENERATE_IMPL_KEYED(KeyT, ValT, Name, HASH, EQ, KeyT, ZMAP_KEY_SELF, ZMAP_KEY_SELF)
+
+#define ZMAP_GENERATE_IMPL(KeyT, ValT, Name)              ZMAP_GENERATE_IMPL_EX(KeyT, ValT, Name, ZMAP_FN_HASH, ZMAP_FN_EQ)
+#define ZMAP_GENERATE_IMPL_INLINE(KeyT, ValT, Name, H, E) ZMAP_GENERATE_IMPL_EX(KeyT, ValT, Name, H, E)
+#define ZMAP_GENERATE_REF_IMPL(KeyT, ValT, Name)                                                            \
+    ZMAP_GENERATE_IMPL_KEYED(KeyT, ValT, Name, ZMAP_FN_HASH, ZMAP_FN_EQ, KeyT const *, ZMAP_KEY_DEREF, ZMAP_KEY_ADDR)
+
+// Ready-made equality helpers for inline registration.
+#define ZMAP_EQ_SCALAR(a, b) ((a) == (b))
+#define ZMAP_EQ_STR(a, b)    (0 == strcmp((a), (b)))
+
+/*
+ * ZMAP_GENERATE_STABLE_IMPL
+ * Stable Map Generator. Values are heap-allocated pointers.
+ */
+#define ZMAP_GENERATE_STABLE_IMPL(KeyT, ValT, Name)                                                                         \
+    typedef struct {                                                                                                        \
+        KeyT key;                                                                                                           \
+        ValT *value;                                                                                                        \
+        zmap_hash_t stored_hash;                                                                                            \
+        zmap_state state;                                                                                                   \
+    } zmap_bucket_stable_##Name;                                                                                            \
+                                                                                                                            \
+    typedef struct                                                                                                          \
+    {                                                                                                                       \
+        zmap_bucket_stable_##Name *buckets;                                                                                 \
+        size_t capacity;                                                                                                    \
+        size_t count;                                                                                                       \
+        size_t threshold;                                                                                                   \
+        uint32_t bits;                                                                                                      \
+        float load_factor;                                                                                                  \
+        uint32_t seed;                                                                                                      \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                           \
+        int (*cmp_func)(KeyT, KeyT);                                                                                        \
+        zmap_arena arena;                                                                                                   \
+    } zmap_stable_##Name;                                                                                                   \
+                                                                                                                            \
+    typedef struct                                                                                                          \
+    {                                                                                                                       \
+        zmap_stable_##Name *map;                                                                                            \
+        size_t index;                                                                                                       \
+    } zmap_iter_stable_##Name;                                                                                              \
+                                                                                                                            \
+    static inline zmap_stable_##Name zmap_init_ext_stable_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                          \
+                                                                 int (*c)(KeyT, KeyT), float load)                          \
+    {                                                                                                                       \
+        return (zmap_stable_##Name){                                                                                        \
+            .buckets = NULL, .capacity = 0, .count = 0, .threshold = 0,                                                     \
+            .bits = 0, .load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load,                            \
+            .seed = 0xCAFEBABE, .hash_func = h, .cmp_func = c,                                                              \
+            .arena = { NULL, NULL, NULL, NULL, 0, 0, false }                                                                \
+        };                                                                                                                  \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline zmap_stable_##Name zmap_init_stable_##Name(zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))        \
+    {                                                                                                                       \
+        return zmap_init_ext_stable_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                        \
+    }                                                                                                                       \
+                                                                                                                            \
+    /* Values come from a per-map slab arena instead of one allocation each. */                                             \
+    static inline zmap_stable_##Name zmap_init_stable_arena_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                        \
+                                                                   int (*c)(KeyT, KeyT))                                    \
+    {                                                                                                                       \
+        zmap_stable_##Name m = zmap_init_ext_stable_##Name(h, c, ZMAP_DEFAULT_LOAD);                                        \
+        m.arena.enabled = true;                                                                                             \
+        return m;                                                                                                           \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline void zmap_set_seed_stable_##Name(zmap_stable_##Name *m, uint32_t s)                                       \
+    {                                                                                                                       \
+        m->seed = s;                                                                                                        \
+    }                                                                                                                       \
+                                                                                                                            \
+    ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                                                  \
+                                                                                                                            \
+    static inline ValT* zmap_get_stable_##Name(zmap_stable_##Name *m, KeyT key)                                             \
+    {                                                                                                                       \
+        if (0 == m->count)                                                                                                  \
+        {                                                                                                                   \
+            return NULL;                                                                                                    \
+        }                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                      \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
+        size_t dist = 0;                                                                                                    \
+        for (;;)                                                                                                            \
+        {                                                                                                                   \
+            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
+            {                                                                                                               \
+                return NULL;                                                                                                \
+            }                                                                                                               \
+            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
+            if (dist > existing_dist)                                                                                       \
+            {                                                                                                               \
+                return NULL;                                                                                                \
+            }                                                                                                               \
+            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
+            {                                                                                                               \
+                return m->buckets[idx].value;                                                                               \
+            }                                                                                                               \
+            idx = (idx + 1) & (m->capacity - 1);                                                                            \
+            dist++;                                                                                                         \
+        }                                                                                                                   \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline void zmap_remove_stable_##Name(zmap_stable_##Name *m, KeyT key)                                           \
+    {                                                                                                                       \
+        if (0 == m->count)                                                                                                  \
+        {                                                                                                                   \
+            return;                                                                                                         \
+        }                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                      \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
+        size_t dist = 0;                                                                                                    \
+        for (;;)                                                                                                            \
+        {                                                                                                                   \
+            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
+            {                                                                                                               \
+                return;                                                                                                     \
+            }                                                                                                               \
+            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
+            if (dist > existing_dist)                                                                                       \
+            {                                                                                                               \
+                return;                                                                                                     \
+            }                                                                                                               \
+            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
+            {                                                                                                               \
+                zmap_remove_val_stable_##Name(m, m->buckets[idx].value);                                                    \
+                m->count--;                                                                                                 \
+                for (;;)                                                                                                    \
+                {                                                                                                           \
+                    size_t next = (idx + 1) & (m->capacity - 1);                                                            \
+                    if (ZMAP_EMPTY == m->buckets[next].state)                                                               \
+                    {                                                                                                       \
+                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
+                        return;                                                                                             \
+                    }                                                                                                       \
+                    size_t next_dist = zmap_dist(next, m->capacity, m->buckets[next].stored_hash, m->bits);                 \
+                    if (0 == next_dist)                                                                                     \
+                    {                                                                                                       \
+                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
+                        return;                                                                                             \
+                    }                                                                                                       \
+                    m->buckets[idx] = m->buckets[next];                                                                     \
+                    idx = next;                                                                                             \
+                }                                                                                                           \
+            }                                                                                                               \
+            idx = (idx + 1) & (m->capacity - 1);                                                                            \
+            dist++;                                                                                                         \
+        }                                                                                                                   \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline size_t zmap_size_stable_##Name(zmap_stable_##Name *m)                                                     \
+    {                                                                                                                       \
+        return m->count;                                                                                                    \
+    }                                                                                                                       \
+                                                                                                                            \
+    /* Buckets plus the values: whole slabs with an arena, else one block per value                                         \
+     * (allocator headers not included). */                                                                                 \
+    static inline size_t zmap_memory_usage_stable_##Name(zmap_stable_##Name *m)                                             \
+    {                                                                                                                       \
+        size_t values = m->arena.enabled ? m->arena.bytes : m->count * sizeof(ValT);                                        \
+        return sizeof(*m) + m->capacity * sizeof(zmap_bucket_stable_##Name) + values;                                       \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline zmap_iter_stable_##Name zmap_iter_init_stable_##Name(zmap_stable_##Name *m)                               \
+    {                                                                                                                       \
+        return (zmap_iter_stable_##Name){m, 0};                                                                             \
+    }                                                                                                                       \
+                                                                                                                            \
+    static inline bool zmap_iter_next_stable_##Name(zmap_iter_stable_##Name *it, KeyT *out_k, ValT *out_v)                  \
+    {                                                                                                                       \
+        if(!it->map || !it->map->buckets)                                                                                   \
+        {                                                                                                                   \
+            return false;                                                                                                   \
+        }                                                                                                                   \
+        while(it->index < it->map->capacity)                                                                                \
+        {                                                                                                                   \
+            size_t i = it->index++;                                                                                         \
+            if(ZMAP_OCCUPIED == it->map->buckets[i].state)                                                                  \
+            {                                                                                                               \
+                if(out_k)                                                                                                   \
+                {                                                                                                           \
+                    *out_k = it->map->buckets[i].key;                                                                       \
+                }                                                                                                           \
+                if(out_v)                                                                                                   \
+                {                                                                                                           \
+                    *out_v = *it->map->buckets[i].value;                                                                    \
+                }                                                                                                           \
+                return true;                                                                                                \
+            }                                                                                                               \
+        }                                                                                                                   \
+        return false;                                                                                                       \
+    }
+
+/*
+ * ZMAP_GENERATE_GROUP_IMPL
+ * Group-Probing Map Generator. A separate one-byte control array holds 7-bit
+ * hash fingerprints; lookups compare ZMAP_GROUP_WIDTH control bytes at once
+ * and only touch key storage on a fingerprint match. Best for miss-heavy workloads.
+ */
+#define ZMAP_GENERATE_GROUP_IMPL(KeyT, ValT, Name)                                                              \
+    typedef struct                                                                                              \
+    {                                                                                                           \
+        KeyT key;                                                                                               \
+        ValT value;                                                                                             \
+    } zmap_slot_group_##Name;                                                                                   \
+                                                                                                                \
+    typedef struct                                                                                              \
+    {                                                                                                           \
+        uint8_t *ctrl;                                                                                          \
+        zmap_slot_group_##Name *slots;                                                                          \
+        size_t capacity;                                                                                        \
+        size_t count;                                                                                           \
+        size_t tombstones;                                                                                      \
+        size_t threshold;                                                                                       \
+        uint32_t bits;                                                                                          \
+        float load_factor;                                                                                      \
+        uint32_t seed;                                                                                          \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                               \
+        int (*cmp_func)(KeyT, KeyT);                                                                            \
+    } zmap_group_##Name;                                                                                        \
+                                                                                                                \
+    typedef struct                                                                                              \
+    {                                                                                                           \
+        zmap_group_##Name *map;                                                                                 \
+        size_t index;                                                                                           \
+    } zmap_iter_group_##Name;                                                                                   \
+                                                                                                                \
+    static inline zmap_group_##Name zmap_init_ext_group_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                \
+                                                               int (*c)(KeyT, KeyT), float load)                \
+    {                                                                                                           \
+        zmap_group_##Name m;                                                                                    \
+        memset(&m, 0, sizeof(m));                                                                               \
+        m.load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load;                              \
+        m.seed = 0xCAFEBABE;                                                                                    \
+        m.hash_func = h;                                                                                        \
+        m.cmp_func = c;                                                                                         \
+        return m;                                                                                               \
+    }                                                                                                           \
+                                                                                                                \
+    static inline zmap_group_##Name zmap_init_group_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                    \
+                                                           int (*c)(KeyT, KeyT))                                \
+    {                                                                                                           \
+        return zmap_init_ext_group_##Name(h, c, ZMAP_DEFAULT_LOAD);                                             \
+    }                                                                                                           \
+                                                                                                                \
+    static inline void zmap_set_seed_group_##Name(zmap_group_##Name *m, uint32_t s)                             \
+    {                                                                                                           \
+        m->seed = s;                                                                                            \
+    }                                                                                                           \
+                                                                                                                \
+    static inline void zmap_free_group_##Name(zmap_group_##Name *m)                                             \
+    {                                                                                                           \
+        if (m->slots)                                                                                           \
+        {                                                                                                       \
+            ZMAP_DELETE_ARRAY(zmap_slot_group_##Name, m->slots);                                                \
+        }                                                                                                       \
+        ZMAP_FREE(m->ctrl);                                                                                     \
+        m->ctrl = NULL;                                                                                         \
+        m->slots = NULL;                                                                                        \
+        m->capacity = 0;                                                                                        \
+        m->count = 0;                                                                                           \
+        m->tombstones = 0;                                                                                      \
+        m->threshold = 0;                                                                                       \
+        m->bits = 0;                                                                                            \
+    }                                                                                                           \
+                                                                                                                \
+    static inline void zmap_clear_group_##Name(zmap_group_##Name *m)                                            \
+    {                                                                                                           \
+        if (m->capacity > 0)                                                                                    \
+        {                                                                                                       \
+            for (size_t i = 0; i < m->capacity; i++)                                                            \
+            {                                                                                                   \
+                if (ZMAP_CTRL_IS_FULL(m->ctrl[i]))                                                              \
+                {                                                                                               \
+                    ZMAP_RESET(m->slots[i]);                                                                    \
+                }                                                                                               \
+            }                                                                                                   \
+            memset(m->ctrl, ZMAP_CTRL_EMPTY, m->capacity + ZMAP_GROUP_WIDTH);                                   \
+        }                                                                                                       \
+        m->count = 0;                                                                                           \
+        m->tombstones = 0;                                                                                      \
+    }                                                                                                           \
+                                                                                                                \
+    static inline int zmap_resize_group_##Name(zmap_group_##Name *m, size_t new_cap)                            \
+    {                                                                                                           \
+        uint8_t *new_ctrl = (uint8_t*)ZMAP_MALLOC(new_cap + ZMAP_GROUP_WIDTH);                                  \
+        if (!new_ctrl)                                                                                          \
+        {                                                                                                       \
+            return Z_ENOMEM;                                                                                    \
+        }                                                                                                       \
+        zmap_slot_group_##Name *new_slots = ZMAP_NEW_ARRAY(zmap_slot_group_##Name, new_cap);                    \
+        if (!new_slots)                                                                                         \
+        {                                                                                                       \
+            ZMAP_FREE(new_ctrl);                                                                                \
+            return Z_ENOMEM;                                                                                    \
+        }                                                                                                       \
+        memset(new_ctrl, ZMAP_CTRL_EMPTY, new_cap + ZMAP_GROUP_WIDTH);                                          \
+        uint32_t new_bits = 0;                                                                                  \
+        size_t temp = new_cap;                                                                                  \
+        while(temp >>= 1)                                                                                       \
+        {                                                                                                       \
+            new_bits++;                                                                                         \
+        }                                                                                                       \
+        for (size_t i = 0; i < m->capacity; i++)                                                                \
+        {                                                                                                       \
+            if (ZMAP_CTRL_IS_FULL(m->ctrl[i]))                                                                  \
+            {                                                                                                   \
+                zmap_hash_t hash = m->hash_func(m->slots[i].key, m->seed);                                      \
+                size_t idx = zmap_group_find_free(new_ctrl, new_cap, new_bits, hash);                           \
+                zmap_ctrl_set(new_ctrl, new_cap, idx, ZMAP_H2(hash));                                           \
+                new_slots[idx] = ZMAP_MOVE(m->slots[i]);                                                        \
+            }                                                                                                   \
+        }                                                                                                       \
+        if (m->slots)                                                                                           \
+        {                                                                                                       \
+            ZMAP_DELETE_ARRAY(zmap_slot_group_##Name, m->slots);                                                \
+        }                                                                                                       \
+        ZMAP_FREE(m->ctrl);                                                                                     \
+        m->ctrl = new_ctrl;                                                                                     \
+        m->slots = new_slots;                                                                                   \
+        m->capacity = new_cap;                                                                                  \
+        m->bits = new_bits;                                                                                     \
+        m->tombstones = 0;                                                                                      \
+        m->threshold = (size_t)(new_cap * m->load_factor);                                                      \
+        return Z_OK;                                                                                            \
+    }                                                                                                           \
+                                                                                                                \
+    static inline zmap_slot_group_##Name *zmap_find_group_##Name(zmap_group_##Name *m, KeyT key,                \
+                                                                 zmap_hash_t hash)                              \
+    {                                                                                                           \
+        size_t mask = m->capacity - 1;                                                                          \
+        size_t pos = zmap_fib_index(hash, m->bits);                                                             \
+        size_t stride = 0;                                                                                      \
+        uint8_t h2 = ZMAP_H2(hash);                                                                             \
+        for (;;)                                                                                                \
+        {                                                                                                       \
+            const uint8_t *group = m->ctrl + pos;                                                               \
+            uint32_t match = zmap_group_match(group, h2);                                                       \
+            while (match)                                                                                       \
+            {                                                                                                   \
+                size_t idx = (pos + zmap_ctz32(match)) & mask;                                                  \
+                if (0 == m->cmp_func(m->slots[idx].key, key))                                                   \
+                {                                                                                               \
+                    return &m->slots[idx];                                                                      \
+                }                                                                                               \
+                match &= match - 1;                                                                             \
+            }                                                                                                   \
+            if (zmap_group_match(group, ZMAP_CTRL_EMPTY))                                                       \
+            {                                                                                                   \
+                return NULL;                                                                                    \
+            }                                                                                                   \
+            stride += ZMAP_GROUP_WIDTH;                                                                         \
+            pos = (pos + stride) & mask;                                                                        \
+        }                                                                                                       \
+    }                                                                                                           \
+                                                                                                                \
+    static inline int zmap_put_group_##Name(zmap_group_##Name *m, KeyT key, ValT val)                           \
+    {                                                                                                           \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                          \
+        if (m->count > 0)                                                                                       \
+        {                                                                                                       \
+            zmap_slot_group_##Name *slot = zmap_find_group_##Name(m, key, hash);                                \
+            if (slot)                                                                                           \
+            {                                                                                                   \
+                slot->value = val;                                                                              \
+                return Z_OK;                                                                                    \
+            }                                                                                                   \
+        }                                                                                                       \
+        if (m->count + m->tombstones >= m->threshold)                                                           \
+        {                                                                                                       \
+            /* Mostly tombstones: rehash in place at the same size instead of growing. */                       \
+            size_t new_cap = (m->count >= m->threshold / 2)                                                     \
+                           ? zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity)) : m->capacity;                        \
+            if (Z_OK != zmap_resize_group_##Name(m, new_cap))                                                   \
+            {                                                                                                   \
+                return Z_ENOMEM;                                                                                \
+            }                                                                                                   \
+        }                                                                                                       \
+        size_t idx = zmap_group_find_free(m->ctrl, m->capacity, m->bits, hash);                                 \
+        if (ZMAP_CTRL_DELETED == m->ctrl[idx])                                                                  \
+        {                                                                                                       \
+            m->tombstones--;                                                                                    \
+        }                                                                                                       \
+        zmap_ctrl_set(m->ctrl, m->capacity, idx, ZMAP_H2(hash));                                                \
+        m->slots[idx].key = key;                                                                                \
+        m->slots[idx].value = val;                                                                              \
+        m->count++;                                                                                             \
+        return Z_OK;                                                                                            \
+    }                                                                                                           \
+                                                                                                                \
+    static inline ValT* zmap_get_group_##Name(zmap_group_##Name *m, KeyT key)                                   \
+    {                                                                                                           \
+        if (0 == m->count)                                                                                      \
+        {                                                                                                       \
+            return NULL;                                                                                        \
+        }                                                                                                       \
+        zmap_slot_group_##Name *slot = zmap_find_group_##Name(m, key, m->hash_func(key, m->seed));              \
+        return slot ? &slot->value : NULL;                                                                      \
+    }                                                                                                           \
+                                                                                                                \
+    static inline void zmap_remove_group_##Name(zmap_group_##Name *m, KeyT key)                                 \
+    {                                                                                                           \
+        if (0 == m->count)                                                                                      \
+        {                                                                                                       \
+            return;                                                                                             \
+        }                                                                                                       \
+        zmap_slot_group_##Name *slot = zmap_find_group_##Name(m, key, m->hash_func(key, m->seed));              \
+        if (!slot)                                                                                              \
+        {                                                                                                       \
+            return;                                                                                             \
+        }                                                                                                       \
+        size_t idx = (size_t)(slot - m->slots);                                                                 \
+        ZMAP_RESET(m->slots[idx]);                                                                              \
+        zmap_ctrl_set(m->ctrl, m->capacity, idx, ZMAP_CTRL_DELETED);                                            \
+        m->count--;                                                                                             \
+        m->tombstones++;                                                                                        \
+    }                                                                                                           \
+                                                                                                                \
+    static inline size_t zmap_size_group_##Name(zmap_group_##Name *m)                                           \
+    {                                                                                                           \
+        return m->count;                                                                                        \
+    }                                                                                                           \
+                                                                                                                \
+    /* Slots plus one control byte per slot and the mirrored tail group. */                                     \
+    static inline size_t zmap_memory_usage_group_##Name(zmap_group_##Name *m)                                   \
+    {                                                                                                           \
+        size_t ctrl = m->capacity ? m->capacity + ZMAP_GROUP_WIDTH : 0;                                         \
+        return sizeof(*m) + ctrl + m->capacity * sizeof(zmap_slot_group_##Name);                                \
+    }                                                                                                           \
+                                                                                                                \
+    static inline zmap_iter_group_##Name zmap_iter_init_group_##Name(zmap_group_##Name *m)                      \
+    {                                                                                                           \
+        zmap_iter_group_##Name it;                                                                              \
+        it.map = m;                                                                                             \
+        it.index = 0;                                                                                           \
+        return it;                                                                                              \
+    }                                                                                                           \
+                                                                                                                \
+    static inline bool zmap_iter_next_group_##Name(zmap_iter_group_##Name *it, KeyT *out_k, ValT *out_v)        \
+    {                                                                                                           \
+        if (!it->map || !it->map->slots)                                                                        \
+        {                                                                                                       \
+            return false;                                                                                       \
+        }                                                                                                       \
+        while (it->index < it->map->capacity)                                                                   \
+        {                                                                                                       \
+            size_t i = it->index++;                                                                             \
+            if (ZMAP_CTRL_IS_FULL(it->map->ctrl[i]))                                                            \
+            {                                                                                                   \
+                if (out_k)                                                                                      \
+                {                                                                                               \
+                    *out_k = it->map->slots[i].key;                                                             \
+                }                                                                                               \
+                if (out_v)                                                                                      \
+                {                                                                                               \
+                    *out_v = it->map->slots[i].value;                                                           \
+                }                                                                                               \
+                return true;                                                                                    \
+            }                                                                                                   \
+        }                                                                                                       \
+        return false;                                                                                           \
+    }
+
+/*
+ * ZMAP_GENERATE_SOA_IMPL
+ * Structure-of-Arrays Map Generator. Keys, values, hashes and a one-byte
+ * metadata array (occupancy + probe distance) live in separate arrays, so
+ * probing scans only metadata, hashes and keys; values are touched on a hit.
+ */
+#define ZMAP_GENERATE_SOA_IMPL(KeyT, ValT, Name)                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        KeyT *keys;                                                                                                     \
+        ValT *values;                                                                                                   \
+        zmap_hash_t *hashes;                                                                                            \
+        uint8_t *meta;                                                                                                  \
+        size_t capacity;                                                                                                \
+        size_t count;                                                                                                   \
+        size_t threshold;                                                                                               \
+        uint32_t bits;                                                                                                  \
+        float load_factor;                                                                                              \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+    } zmap_soa_##Name;                                                                                                  \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_soa_##Name *map;                                                                                           \
+        size_t index;                                                                                                   \
+    } zmap_iter_soa_##Name;                                                                                             \
+                                                                                                                        \
+    static inline zmap_soa_##Name zmap_init_ext_soa_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                            \
+                                                           int (*c)(KeyT, KeyT), float load)                            \
+    {                                                                                                                   \
+        zmap_soa_##Name m;                                                                                              \
+        memset(&m, 0, sizeof(m));                                                                                       \
+        m.load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load;                                      \
+        m.seed = 0xCAFEBABE;                                                                                            \
+        m.hash_func = h;                                                                                                \
+        m.cmp_func = c;                                                                                                 \
+        return m;                                                                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zmap_soa_##Name zmap_init_soa_##Name(zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))          \
+    {                                                                                                                   \
+        return zmap_init_ext_soa_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_set_seed_soa_##Name(zmap_soa_##Name *m, uint32_t s)                                         \
+    {                                                                                                                   \
+        m->seed = s;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_free_soa_##Name(zmap_soa_##Name *m)                                                         \
+    {                                                                                                                   \
+        ZMAP_DELETE_ARRAY(KeyT, m->keys);                                                                               \
+        ZMAP_DELETE_ARRAY(ValT, m->values);                                                                             \
+        ZMAP_FREE(m->hashes);                                                                                           \
+        ZMAP_FREE(m->meta);                                                                                             \
+        m->keys = NULL;                                                                                                 \
+        m->values = NULL;                                                                                               \
+        m->hashes = NULL;                                                                                               \
+        m->meta = NULL;                                                                                                 \
+        m->capacity = 0;                                                                                                \
+        m->count = 0;                                                                                                   \
+        m->threshold = 0;                                                                                               \
+        m->bits = 0;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_clear_soa_##Name(zmap_soa_##Name *m)                                                        \
+    {                                                                                                                   \
+        for (size_t i = 0; i < m->capacity; i++)                                                                        \
+        {                                                                                                               \
+            if (m->meta[i])                                                                                             \
+            {                                                                                                           \
+                ZMAP_RESET(m->keys[i]);                                                                                 \
+                ZMAP_RESET(m->values[i]);                                                                               \
+                m->meta[i] = 0;                                                                                         \
+            }                                                                                                           \
+        }                                                                                                               \
+        m->count = 0;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Robin Hood placement of an absent key, starting at `idx` with probe distance `dist`. */                          \
+    static inline void zmap_place_soa_##Name(KeyT *keys, ValT *values, zmap_hash_t *hashes, uint8_t *meta,              \
+                                             size_t capacity, uint32_t bits, size_t idx, size_t dist,                   \
+                                             KeyT key, ValT val, zmap_hash_t hash)                                      \
+    {                                                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            if (0 == meta[idx])                                                                                         \
+            {                                                                                                           \
+                keys[idx] = ZMAP_MOVE(key);                                                                             \
+                values[idx] = ZMAP_MOVE(val);                                                                           \
+                hashes[idx] = hash;                                                                                     \
+                meta[idx] = zmap_meta_encode(dist);                                                                     \
+                return;                                                                                                 \
+            }                                                                                                           \
+            size_t existing_dist = zmap_meta_dist(meta[idx], idx, capacity, hashes[idx], bits);                         \
+            if (dist > existing_dist)                                                                                   \
+            {                                                                                                           \
+                ZMAP_SWAP(KeyT, keys[idx], key);                                                                        \
+                ZMAP_SWAP(ValT, values[idx], val);                                                                      \
+                ZMAP_SWAP(zmap_hash_t, hashes[idx], hash);                                                              \
+                meta[idx] = zmap_meta_encode(dist);                                                                     \
+                dist = existing_dist;                                                                                   \
+            }                                                                                                           \
+            idx = (idx + 1) & (capacity - 1);                                                                           \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zmap_resize_soa_##Name(zmap_soa_##Name *m, size_t new_cap)                                        \
+    {                                                                                                                   \
+        KeyT *new_keys = ZMAP_NEW_ARRAY(KeyT, new_cap);                                                                 \
+        ValT *new_values = ZMAP_NEW_ARRAY(ValT, new_cap);                                                               \
+        zmap_hash_t *new_hashes = (zmap_hash_t*)ZMAP_MALLOC(new_cap * sizeof(zmap_hash_t));                             \
+        uint8_t *new_meta = (uint8_t*)ZMAP_CALLOC(new_cap, sizeof(uint8_t));                                            \
+        if (!new_keys || !new_values || !new_hashes || !new_meta)                                                       \
+        {                                                                                                               \
+            ZMAP_DELETE_ARRAY(KeyT, new_keys);                                                                          \
+            ZMAP_DELETE_ARRAY(ValT, new_values);                                                                        \
+            ZMAP_FREE(new_hashes);                                                                                      \
+            ZMAP_FREE(new_meta);                                                                                        \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        uint32_t new_bits = 0;                                                                                          \
+        size_t temp = new_cap;                                                                                          \
+        while(temp >>= 1)                                                                                               \
+        {                                                                                                               \
+            new_bits++;                                                                                                 \
+        }                                                                                                               \
+        for (size_t i = 0; i < m->capacity; i++)                                                                        \
+        {                                                                                                               \
+            if (m->meta[i])                                                                                             \
+            {                                                                                                           \
+                zmap_place_soa_##Name(new_keys, new_values, new_hashes, new_meta, new_cap, new_bits,                    \
+                                      zmap_fib_index(m->hashes[i], new_bits), 0,                                        \
+                                      ZMAP_MOVE(m->keys[i]), ZMAP_MOVE(m->values[i]), m->hashes[i]);                    \
+            }                                                                                                           \
+        }                                                                                                               \
+        ZMAP_DELETE_ARRAY(KeyT, m->keys);                                                                               \
+        ZMAP_DELETE_ARRAY(ValT, m->values);                                                                             \
+        ZMAP_FREE(m->hashes);                                                                                           \
+        ZMAP_FREE(m->meta);                                                                                             \
+        m->keys = new_keys;                                                                                             \
+        m->values = new_values;                                                                                         \
+        m->hashes = new_hashes;                                                                                         \
+        m->meta = new_meta;                                                                                             \
+        m->capacity = new_cap;                                                                                          \
+        m->bits = new_bits;                                                                                             \
+        m->threshold = (size_t)(new_cap * m->load_factor);                                                              \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zmap_put_soa_##Name(zmap_soa_##Name *m, KeyT key, ValT val)                                       \
+    {                                                                                                                   \
+        if (m->count >= m->threshold)                                                                                   \
+        {                                                                                                               \
+            size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                              \
+            if (Z_OK != zmap_resize_soa_##Name(m, new_cap))                                                             \
+            {                                                                                                           \
+                return Z_ENOMEM;                                                                                        \
+            }                                                                                                           \
+        }                                                                                                               \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            uint8_t md = m->meta[idx];                                                                                  \
+            if (0 == md || dist > zmap_meta_dist(md, idx, m->capacity, m->hashes[idx], m->bits))                        \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+            if (m->hashes[idx] == hash && 0 == m->cmp_func(m->keys[idx], key))                                          \
+            {                                                                                                           \
+                m->values[idx] = val;                                                                                   \
+                return Z_OK;                                                                                            \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+        zmap_place_soa_##Name(m->keys, m->values, m->hashes, m->meta, m->capacity, m->bits, idx, dist, key, val, hash); \
+        m->count++;                                                                                                     \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_find_soa_##Name(zmap_soa_##Name *m, KeyT key)                                             \
+    {                                                                                                                   \
+        if (0 == m->count)                                                                                              \
+        {                                                                                                               \
+            return SIZE_MAX;                                                                                            \
+        }                                                                                                               \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            uint8_t md = m->meta[idx];                                                                                  \
+            if (md <= dist && (md < ZMAP_META_SAT || dist > zmap_dist(idx, m->capacity, m->hashes[idx], m->bits)))      \
+            {                                                                                                           \
+                return SIZE_MAX;                                                                                        \
+            }                                                                                                           \
+            if (m->hashes[idx] == hash && 0 == m->cmp_func(m->keys[idx], key))                                          \
+            {                                                                                                           \
+                return idx;                                                                                             \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline ValT* zmap_get_soa_##Name(zmap_soa_##Name *m, KeyT key)                                               \
+    {                                                                                                                   \
+        size_t idx = zmap_find_soa_##Name(m, key);                                                                      \
+        return (SIZE_MAX == idx) ? NULL : &m->values[idx];                                                              \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_remove_soa_##Name(zmap_soa_##Name *m, KeyT key)                                             \
+    {                                                                                                                   \
+        size_t idx = zmap_find_soa_##Name(m, key);                                                                      \
+        if (SIZE_MAX == idx)                                                                                            \
+        {                                                                                                               \
+            return;                                                                                                     \
+        }                                                                                                               \
+        m->count--;                                                                                                     \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            size_t next = (idx + 1) & (m->capacity - 1);                                                                \
+            uint8_t next_md = m->meta[next];                                                                            \
+            if (next_md <= 1)                                                                                           \
+            {                                                                                                           \
+                ZMAP_RESET(m->keys[idx]);                                                                               \
+                ZMAP_RESET(m->values[idx]);                                                                             \
+                m->meta[idx] = 0;                                                                                       \
+                return;                                                                                                 \
+            }                                                                                                           \
+            m->keys[idx] = ZMAP_MOVE(m->keys[next]);                                                                    \
+            m->values[idx] = ZMAP_MOVE(m->values[next]);                                                                \
+            m->hashes[idx] = m->hashes[next];                                                                           \
+            m->meta[idx] = (next_md < ZMAP_META_SAT) ? (uint8_t)(next_md - 1)                                           \
+                         : zmap_meta_encode(zmap_dist(idx, m->capacity, m->hashes[idx], m->bits));                      \
+            idx = next;                                                                                                 \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_size_soa_##Name(zmap_soa_##Name *m)                                                       \
+    {                                                                                                                   \
+        return m->count;                                                                                                \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_memory_usage_soa_##Name(zmap_soa_##Name *m)                                               \
+    {                                                                                                                   \
+        return sizeof(*m) + m->capacity * (sizeof(KeyT) + sizeof(ValT) + sizeof(zmap_hash_t) + sizeof(uint8_t));        \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zmap_iter_soa_##Name zmap_iter_init_soa_##Name(zmap_soa_##Name *m)                                    \
+    {                                                                                                                   \
+        zmap_iter_soa_##Name it;                                                                                        \
+        it.map = m;                                                                                                     \
+        it.index = 0;                                                                                                   \
+        return it;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline bool zmap_iter_next_soa_##Name(zmap_iter_soa_##Name *it, KeyT *out_k, ValT *out_v)                    \
+    {                                                                                                                   \
+        if (!it->map || !it->map->meta)                                                                                 \
+        {                                                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        while (it->index < it->map->capacity)                                                                           \
+        {                                                                                                               \
+            size_t i = it->index++;                                                                                     \
+            if (it->map->meta[i])                                                                                       \
+            {                                                                                                           \
+                if (out_k)                                                                                              \
+                {                                                                                                       \
+                    *out_k = it->map->keys[i];                                                                          \
+                }                                                                                                       \
+                if (out_v)                                                                                              \
+                {                                                                                                       \
+                    *out_v = it->map->values[i];                                                                        \
+                }                                                                                                       \
+                return true;                                                                                            \
+            }                                                                                                           \
+        }                                                                                                               \
+        return false;                                                                                                   \
+    }
+
+/*
+ * ZMAP_GENERATE_INCR_IMPL
+ * Incremental Map Generator. Growing allocates the new bucket array but leaves
+ * entries in the old one; every put/remove then migrates up to ZMAP_INCR_STEP
+ * old buckets, so no single operation pays for a full rehash. Until migration
+ * finishes, lookups consult both arrays. Each key lives in exactly one of them.
+ */
+#define ZMAP_GENERATE_INCR_IMPL(KeyT, ValT, Name)                                                                       \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        KeyT key;                                                                                                       \
+        ValT value;                                                                                                     \
+        zmap_hash_t hash;                                                                                               \
+        uint8_t state;                                                                                                  \
+    } zmap_bucket_incr_##Name;                                                                                          \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_bucket_incr_##Name *buckets;                                                                               \
+        size_t capacity;                                                                                                \
+        size_t count;                                                                                                   \
+        size_t threshold;                                                                                               \
+        uint32_t bits;                                                                                                  \
+        zmap_bucket_incr_##Name *old_buckets;                                                                           \
+        size_t old_capacity;                                                                                            \
+        size_t old_count;                                                                                               \
+        size_t migrate_pos;                                                                                             \
+        uint32_t old_bits;                                                                                              \
+        float load_factor;                                                                                              \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+    } zmap_incr_##Name;                                                                                                 \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_incr_##Name *map;                                                                                          \
+        size_t index;                                                                                                   \
+    } zmap_iter_incr_##Name;                                                                                            \
+                                                                                                                        \
+    static inline zmap_incr_##Name zmap_init_ext_incr_##Name(zmap_hash_t (*h)(KeyT, uint32_t),                          \
+                                                             int (*c)(KeyT, KeyT), float load)                          \
+    {                                                                                                                   \
+        zmap_incr_##Name m;                                                                                             \
+        memset(&m, 0, sizeof(m));                                                                                       \
+        m.load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load;                                      \
+        m.seed = 0xCAFEBABE;                                                                                            \
+        m.hash_func = h;                                                                                                \
+        m.cmp_func = c;                                                                                                 \
+        return m;                                                                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zmap_incr_##Name zmap_init_incr_##Name(zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))        \
+    {                                                                                                                   \
+        return zmap_init_ext_incr_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_set_seed_incr_##Name(zmap_incr_##Name *m, uint32_t s)                                       \
+    {                                                                                                                   \
+        m->seed = s;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_drop_old_incr_##Name(zmap_incr_##Name *m)                                                   \
+    {                                                                                                                   \
+        ZMAP_DELETE_ARRAY(zmap_bucket_incr_##Name, m->old_buckets);                                                     \
+        m->old_buckets = NULL;                                                                                          \
+        m->old_capacity = 0;                                                                                            \
+        m->old_count = 0;                                                                                               \
+        m->migrate_pos = 0;                                                                                             \
+        m->old_bits = 0;                                                                                                \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_free_incr_##Name(zmap_incr_##Name *m)                                                       \
+    {                                                                                                                   \
+        zmap_drop_old_incr_##Name(m);                                                                                   \
+        ZMAP_DELETE_ARRAY(zmap_bucket_incr_##Name, m->buckets);                                                         \
+        m->buckets = NULL;                                                                                              \
+        m->capacity = 0;                                                                                                \
+        m->count = 0;                                                                                                   \
+        m->threshold = 0;                                                                                               \
+        m->bits = 0;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_clear_incr_##Name(zmap_incr_##Name *m)                                                      \
+    {                                                                                                                   \
+        zmap_drop_old_incr_##Name(m);                                                                                   \
+        for (size_t i = 0; i < m->capacity; i++)                                                                        \
+        {                                                                                                               \
+            if (ZMAP_OCCUPIED == m->buckets[i].state)                                                                   \
+            {                                                                                                           \
+                ZMAP_RESET(m->buckets[i].key);                                                                          \
+                ZMAP_RESET(m->buckets[i].value);                                                                        \
+            }                                                                                                           \
+            m->buckets[i].state = ZMAP_EMPTY;                                                                           \
+        }                                                                                                               \
+        m->count = 0;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Robin Hood placement of an absent key into the new array. */                                                     \
+    static inline void zmap_place_incr_##Name(zmap_incr_##Name *m, size_t idx, size_t dist,                             \
+                                              KeyT key, ValT val, zmap_hash_t hash)                                     \
+    {                                                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = &m->buckets[idx];                                                              \
+            if (ZMAP_EMPTY == b->state)                                                                                 \
+            {                                                                                                           \
+                b->key = ZMAP_MOVE(key);                                                                                \
+                b->value = ZMAP_MOVE(val);                                                                              \
+                b->hash = hash;                                                                                         \
+                b->state = ZMAP_OCCUPIED;                                                                               \
+                return;                                                                                                 \
+            }                                                                                                           \
+            size_t existing_dist = zmap_dist(idx, m->capacity, b->hash, m->bits);                                       \
+            if (dist > existing_dist)                                                                                   \
+            {                                                                                                           \
+                ZMAP_SWAP(KeyT, b->key, key);                                                                           \
+                ZMAP_SWAP(ValT, b->value, val);                                                                         \
+                ZMAP_SWAP(zmap_hash_t, b->hash, hash);                                                                  \
+                dist = existing_dist;                                                                                   \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Moves up to `budget` old buckets into the new array. Migrated slots become                                       \
+     * ZMAP_MOVED, which probes skip over, so old chains stay intact. Returns true                                      \
+     * while a migration is still pending. */                                                                           \
+    static inline bool zmap_migrate_incr_##Name(zmap_incr_##Name *m, size_t budget)                                     \
+    {                                                                                                                   \
+        if (!m->old_buckets)                                                                                            \
+        {                                                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        while (budget-- > 0 && m->migrate_pos < m->old_capacity && m->old_count > 0)                                    \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = &m->old_buckets[m->migrate_pos++];                                             \
+            if (ZMAP_OCCUPIED == b->state)                                                                              \
+            {                                                                                                           \
+                zmap_place_incr_##Name(m, zmap_fib_index(b->hash, m->bits), 0,                                          \
+                                       ZMAP_MOVE(b->key), ZMAP_MOVE(b->value), b->hash);                                \
+                ZMAP_RESET(b->key);                                                                                     \
+                ZMAP_RESET(b->value);                                                                                   \
+                b->state = ZMAP_MOVED;                                                                                  \
+                m->old_count--;                                                                                         \
+            }                                                                                                           \
+        }                                                                                                               \
+        if (0 == m->old_count)                                                                                          \
+        {                                                                                                               \
+            zmap_drop_old_incr_##Name(m);                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        return true;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Starts a migration into an array of `new_cap` buckets, finishing any                                             \
+     * migration already in flight first. */                                                                            \
+    static inline int zmap_grow_incr_##Name(zmap_incr_##Name *m, size_t new_cap)                                        \
+    {                                                                                                                   \
+        zmap_bucket_incr_##Name *new_buckets = ZMAP_NEW_ARRAY(zmap_bucket_incr_##Name, new_cap);                        \
+        if (!new_buckets)                                                                                               \
+        {                                                                                                               \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        zmap_migrate_incr_##Name(m, SIZE_MAX);                                                                          \
+        uint32_t new_bits = 0;                                                                                          \
+        size_t temp = new_cap;                                                                                          \
+        while(temp >>= 1)                                                                                               \
+        {                                                                                                               \
+            new_bits++;                                                                                                 \
+        }                                                                                                               \
+        if (m->count > 0)                                                                                               \
+        {                                                                                                               \
+            m->old_buckets = m->buckets;                                                                                \
+            m->old_capacity = m->capacity;                                                                              \
+            m->old_count = m->count;                                                                                    \
+            m->old_bits = m->bits;                                                                                      \
+            m->migrate_pos = 0;                                                                                         \
+        }                                                                                                               \
+        else                                                                                                            \
+        {                                                                                                               \
+            ZMAP_DELETE_ARRAY(zmap_bucket_incr_##Name, m->buckets);                                                     \
+        }                                                                                                               \
+        m->buckets = new_buckets;                                                                                       \
+        m->capacity = new_cap;                                                                                          \
+        m->bits = new_bits;                                                                                             \
+        m->threshold = (size_t)(new_cap * m->load_factor);                                                              \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zmap_bucket_incr_##Name *zmap_find_old_incr_##Name(zmap_incr_##Name *m, KeyT key, zmap_hash_t hash)   \
+    {                                                                                                                   \
+        size_t idx = zmap_fib_index(hash, m->old_bits);                                                                 \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = &m->old_buckets[idx];                                                          \
+            if (ZMAP_EMPTY == b->state)                                                                                 \
+            {                                                                                                           \
+                return NULL;                                                                                            \
+            }                                                                                                           \
+            if (ZMAP_OCCUPIED == b->state)                                                                              \
+            {                                                                                                           \
+                if (dist > zmap_dist(idx, m->old_capacity, b->hash, m->old_bits))                                       \
+                {                                                                                                       \
+                    return NULL;                                                                                        \
+                }                                                                                                       \
+                if (b->hash == hash && 0 == m->cmp_func(b->key, key))                                                   \
+                {                                                                                                       \
+                    return b;                                                                                           \
+                }                                                                                                       \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->old_capacity - 1);                                                                    \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_find_new_incr_##Name(zmap_incr_##Name *m, KeyT key, zmap_hash_t hash)                     \
+    {                                                                                                                   \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = &m->buckets[idx];                                                              \
+            if (ZMAP_EMPTY == b->state || dist > zmap_dist(idx, m->capacity, b->hash, m->bits))                         \
+            {                                                                                                           \
+                return SIZE_MAX;                                                                                        \
+            }                                                                                                           \
+            if (b->hash == hash && 0 == m->cmp_func(b->key, key))                                                       \
+            {                                                                                                           \
+                return idx;                                                                                             \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zmap_put_incr_##Name(zmap_incr_##Name *m, KeyT key, ValT val)                                     \
+    {                                                                                                                   \
+        if (m->count >= m->threshold)                                                                                   \
+        {                                                                                                               \
+            size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                              \
+            if (Z_OK != zmap_grow_incr_##Name(m, new_cap))                                                              \
+            {                                                                                                           \
+                return Z_ENOMEM;                                                                                        \
+            }                                                                                                           \
+        }                                                                                                               \
+        zmap_migrate_incr_##Name(m, ZMAP_INCR_STEP);                                                                    \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        if (m->old_buckets)                                                                                             \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = zmap_find_old_incr_##Name(m, key, hash);                                       \
+            if (b)                                                                                                      \
+            {                                                                                                           \
+                b->value = val;                                                                                         \
+                return Z_OK;                                                                                            \
+            }                                                                                                           \
+        }                                                                                                               \
+        size_t idx = zmap_fib_index(hash, m->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = &m->buckets[idx];                                                              \
+            if (ZMAP_EMPTY == b->state || dist > zmap_dist(idx, m->capacity, b->hash, m->bits))                         \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+            if (b->hash == hash && 0 == m->cmp_func(b->key, key))                                                       \
+            {                                                                                                           \
+                b->value = val;                                                                                         \
+                return Z_OK;                                                                                            \
+            }                                                                                                           \
+            idx = (idx + 1) & (m->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+        zmap_place_incr_##Name(m, idx, dist, key, val, hash);                                                           \
+        m->count++;                                                                                                     \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline ValT* zmap_get_incr_##Name(zmap_incr_##Name *m, KeyT key)                                             \
+    {                                                                                                                   \
+        if (0 == m->count)                                                                                              \
+        {                                                                                                               \
+            return NULL;                                                                                                \
+        }                                                                                                               \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        size_t idx = zmap_find_new_incr_##Name(m, key, hash);                                                           \
+        if (SIZE_MAX != idx)                                                                                            \
+        {                                                                                                               \
+            return &m->buckets[idx].value;                                                                              \
+        }                                                                                                               \
+        if (m->old_buckets)                                                                                             \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = zmap_find_old_incr_##Name(m, key, hash);                                       \
+            return b ? &b->value : NULL;                                                                                \
+        }                                                                                                               \
+        return NULL;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_remove_incr_##Name(zmap_incr_##Name *m, KeyT key)                                           \
+    {                                                                                                                   \
+        if (0 == m->count)                                                                                              \
+        {                                                                                                               \
+            return;                                                                                                     \
+        }                                                                                                               \
+        zmap_migrate_incr_##Name(m, ZMAP_INCR_STEP);                                                                    \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        if (m->old_buckets)                                                                                             \
+        {                                                                                                               \
+            zmap_bucket_incr_##Name *b = zmap_find_old_incr_##Name(m, key, hash);                                       \
+            if (b)                                                                                                      \
+            {                                                                                                           \
+                ZMAP_RESET(b->key);                                                                                     \
+                ZMAP_RESET(b->value);                                                                                   \
+                b->state = ZMAP_MOVED;                                                                                  \
+                m->old_count--;                                                                                         \
+                m->count--;                                                                                             \
+                if (0 == m->old_count)                                                                                  \
+                {                                                                                                       \
+                    zmap_drop_old_incr_##Name(m);                                                                       \
+                }                                                                                                       \
+                return;                                                                                                 \
+            }                                                                                                           \
+        }                                                                                                               \
+        size_t idx = zmap_find_new_incr_##Name(m, key, hash);                                                           \
+        if (SIZE_MAX == idx)                                                                                            \
+        {                                                                                                               \
+            return;                                                                                                     \
+        }                                                                                                               \
+        m->count--;                                                                                                     \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            size_t next = (idx + 1) & (m->capacity - 1);                                                                \
+            zmap_bucket_incr_##Name *nb = &m->buckets[next];                                                            \
+            if (ZMAP_EMPTY == nb->state || 0 == zmap_dist(next, m->capacity, nb->hash, m->bits))                        \
+            {                                                                                                           \
+                ZMAP_RESET(m->buckets[idx].key);                                                                        \
+                ZMAP_RESET(m->buckets[idx].value);                                                                      \
+                m->buckets[idx].state = ZMAP_EMPTY;                                                                     \
+                return;                                                                                                 \
+            }                                                                                                           \
+            m->buckets[idx].key = ZMAP_MOVE(nb->key);                                                                   \
+            m->buckets[idx].value = ZMAP_MOVE(nb->value);                                                               \
+            m->buckets[idx].hash = nb->hash;                                                                            \
+            idx = next;                                                                                                 \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_size_incr_##Name(zmap_incr_##Name *m)                                                     \
+    {                                                                                                                   \
+        return m->count;                                                                                                \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Counts the old table too while a migration is in flight. */                                                      \
+    static inline size_t zmap_memory_usage_incr_##Name(zmap_incr_##Name *m)                                             \
+    {                                                                                                                   \
+        size_t old = m->old_buckets ? m->old_capacity : 0;                                                              \
+        return sizeof(*m) + (m->capacity + old) * sizeof(zmap_bucket_incr_##Name);                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zmap_iter_incr_##Name zmap_iter_init_incr_##Name(zmap_incr_##Name *m)                                 \
+    {                                                                                                                   \
+        zmap_iter_incr_##Name it;                                                                                       \
+        it.map = m;                                                                                                     \
+        it.index = 0;                                                                                                   \
+        return it;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Visits the new array, then whatever has not been migrated yet. */                                                \
+    static inline bool zmap_iter_next_incr_##Name(zmap_iter_incr_##Name *it, KeyT *out_k, ValT *out_v)                  \
+    {                                                                                                                   \
+        if (!it->map || !it->map->buckets)                                                                              \
         {                                                                                                               \
-            ZMAP_FREE(m->buckets); *m = (zmap_##Name){0};                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        while (it->index < it->map->capacity + it->map->old_capacity)                                                   \
+        {                                                                                                               \
+            size_t i = it->index++;                                                                                     \
+            zmap_bucket_incr_##Name *b = (i < it->map->capacity) ? &it->map->buckets[i]                                 \
+                                       : &it->map->old_buckets[i - it->map->capacity];                                  \
+            if (ZMAP_OCCUPIED == b->state)                                                                              \
+            {                                                                                                           \
+                if (out_k)                                                                                              \
+                {                                                                                                       \
+                    *out_k = b->key;                                                                                    \
+                }                                                                                                       \
+                if (out_v)                                                                                              \
+                {                                                                                                       \
+                    *out_v = b->value;                                                                                  \
+                }                                                                                                       \
+                return true;                                                                                            \
+            }                                                                                                           \
         }                                                                                                               \
+        return false;                                                                                                   \
+    }
+
+/*
+ * ZMAP_GENERATE_CONCURRENT_IMPL
+ * Sharded Concurrent Map Generator. The keyspace is split across a power-of-two
+ * number of shards picked from the high hash bits; each shard is a standard
+ * Robin Hood table (zmap_<Name>_shard) behind its own reader/writer lock.
+ * Values are copied out, since a pointer would outlive the shard lock.
+ * Init and free are not thread-safe; every other operation is.
+ */
+#define ZMAP_GENERATE_CONCURRENT_IMPL(KeyT, ValT, Name)                                                                 \
+    ZMAP_GENERATE_IMPL(KeyT, ValT, Name##_shard)                                                                        \
                                                                                                                         \
-        static inline void zmap_clear_##Name(zmap_##Name *m)                                                            \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        ZMAP_RWLOCK_T lock;                                                                                             \
+        zmap_##Name##_shard map;                                                                                        \
+        unsigned char pad[ZMAP_CACHE_LINE];                                                                             \
+    } zmap_shard_##Name;                                                                                                \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_shard_##Name *shards;                                                                                      \
+        size_t shard_count;                                                                                             \
+        uint32_t shard_bits;                                                                                            \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+    } zmap_concurrent_##Name;                                                                                           \
+                                                                                                                        \
+    static inline void zmap_free_concurrent_##Name(zmap_concurrent_##Name *m)                                           \
+    {                                                                                                                   \
+        for (size_t i = 0; i < m->shard_count; i++)                                                                     \
         {                                                                                                               \
-             if (m->capacity > 0)                                                                                       \
-             {                                                                                                          \
-                memset(m->buckets, 0, m->capacity * sizeof(zmap_bucket_##Name));                                        \
-             }                                                                                                          \
-             m->count = 0;                                                                                              \
+            ZMAP_RWLOCK_DESTROY(&m->shards[i].lock);                                                                    \
+            zmap_free_##Name##_shard(&m->shards[i].map);                                                                \
         }                                                                                                               \
+        ZMAP_DELETE_ARRAY(zmap_shard_##Name, m->shards);                                                                \
+        m->shards = NULL;                                                                                               \
+        m->shard_count = 0;                                                                                             \
+        m->shard_bits = 0;                                                                                              \
+    }                                                                                                                   \
                                                                                                                         \
-        static inline int zmap_resize_##Name(zmap_##Name *m, size_t new_cap)                                            \
+    /* shard_count is rounded up to a power of two; 0 selects ZMAP_DEFAULT_SHARDS. */                                   \
+    static inline int zmap_init_concurrent_##Name(zmap_concurrent_##Name *m, zmap_hash_t (*h)(KeyT, uint32_t),          \
+                                                  int (*c)(KeyT, KeyT), size_t shard_count)                             \
+    {                                                                                                                   \
+        memset(m, 0, sizeof(*m));                                                                                       \
+        m->seed = 0xCAFEBABE;                                                                                           \
+        m->hash_func = h;                                                                                               \
+        m->cmp_func = c;                                                                                                \
+        size_t want = shard_count ? shard_count : ZMAP_DEFAULT_SHARDS;                                                  \
+        size_t n = 1;                                                                                                   \
+        uint32_t bits = 0;                                                                                              \
+        while (n < want && bits < 16)                                                                                   \
         {                                                                                                               \
-            zmap_bucket_##Name *new_buckets = (zmap_bucket_##Name*)ZMAP_CALLOC(new_cap, sizeof(zmap_bucket_##Name));    \
-            if (!new_buckets)                                                                                           \
+            n <<= 1;                                                                                                    \
+            bits++;                                                                                                     \
+        }                                                                                                               \
+        m->shards = ZMAP_NEW_ARRAY(zmap_shard_##Name, n);                                                               \
+        if (!m->shards)                                                                                                 \
+        {                                                                                                               \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        for (size_t i = 0; i < n; i++)                                                                                  \
+        {                                                                                                               \
+            if (0 != ZMAP_RWLOCK_INIT(&m->shards[i].lock))                                                              \
             {                                                                                                           \
+                zmap_free_concurrent_##Name(m);                                                                         \
                 return Z_ENOMEM;                                                                                        \
             }                                                                                                           \
-            uint32_t new_bits = 0;                                                                                      \
-            size_t temp = new_cap;                                                                                      \
-            while(temp >>= 1)                                                                                           \
+            m->shard_count = i + 1;                                                                                     \
+            m->shards[i].map = zmap_init_##Name##_shard(h, c);                                                          \
+            zmap_set_seed_##Name##_shard(&m->shards[i].map, m->seed);                                                   \
+        }                                                                                                               \
+        m->shard_bits = bits;                                                                                           \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Picks the shard from the top bits of the mixed hash, like zmap_fib_index, so                                     \
+     * weak hashes still spread. *hash is then shifted past those bits: the shard's                                     \
+     * own Fibonacci index reads the bits below, not the ones all its keys share. */                                    \
+    static inline zmap_shard_##Name *zmap_shard_for_##Name(zmap_concurrent_##Name *m, zmap_hash_t *hash)                \
+    {                                                                                                                   \
+        if (0 == m->shard_bits)                                                                                         \
+        {                                                                                                               \
+            return &m->shards[0];                                                                                       \
+        }                                                                                                               \
+        size_t i = zmap_fib_index(*hash, m->shard_bits);                                                                \
+        *hash <<= m->shard_bits;                                                                                        \
+        return &m->shards[i];                                                                                           \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Inserts into a write-locked shard, growing it first if needed. */                                                \
+    static inline int zmap_shard_put_##Name(zmap_##Name##_shard *s, KeyT key, ValT val, zmap_hash_t hash)               \
+    {                                                                                                                   \
+        if (s->count >= s->threshold)                                                                                   \
+        {                                                                                                               \
+            size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(s->capacity));                                              \
+            if (Z_OK != zmap_resize_##Name##_shard(s, new_cap))                                                         \
             {                                                                                                           \
-                new_bits++;                                                                                             \
+                return Z_ENOMEM;                                                                                        \
             }                                                                                                           \
-            for (size_t i = 0; i < m->capacity; i++)                                                                    \
+        }                                                                                                               \
+        return zmap_put_hashed_##Name##_shard(s, key, val, hash);                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zmap_put_concurrent_##Name(zmap_concurrent_##Name *m, KeyT key, ValT val)                         \
+    {                                                                                                                   \
+        zmap_hash_t hash;                                                                                               \
+        ZMAP_TRY_HASH(hash, m->hash_func(key, m->seed));                                                                \
+        zmap_shard_##Name *s = zmap_shard_for_##Name(m, &hash);                                                         \
+        ZMAP_RWLOCK_WRLOCK(&s->lock);                                                                                   \
+        int rc = zmap_shard_put_##Name(&s->map, key, val, hash);                                                        \
+        ZMAP_RWLOCK_WRUNLOCK(&s->lock);                                                                                 \
+        return rc;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Copies the value into *out (if non-NULL). Returns true if the key was found. */                                  \
+    static inline bool zmap_get_concurrent_##Name(zmap_concurrent_##Name *m, KeyT key, ValT *out)                       \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        zmap_shard_##Name *s = zmap_shard_for_##Name(m, &hash);                                                         \
+        ZMAP_RWLOCK_RDLOCK(&s->lock);                                                                                   \
+        ValT *v = s->map.count ? zmap_find_hashed_##Name##_shard(&s->map, key, hash) : NULL;                            \
+        if (v && out)                                                                                                   \
+        {                                                                                                               \
+            *out = *v;                                                                                                  \
+        }                                                                                                               \
+        ZMAP_RWLOCK_RDUNLOCK(&s->lock);                                                                                 \
+        return NULL != v;                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline bool zmap_remove_concurrent_##Name(zmap_concurrent_##Name *m, KeyT key)                               \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        zmap_shard_##Name *s = zmap_shard_for_##Name(m, &hash);                                                         \
+        ZMAP_RWLOCK_WRLOCK(&s->lock);                                                                                   \
+        bool removed = s->map.count ? zmap_remove_hashed_##Name##_shard(&s->map, key, hash) : false;                    \
+        ZMAP_RWLOCK_WRUNLOCK(&s->lock);                                                                                 \
+        return removed;                                                                                                 \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Atomic insert-or-update: inserts `init` if the key is absent, otherwise calls                                    \
+     * fn(&value, ctx) under the shard's write lock. fn may be NULL (insert-if-absent). */                              \
+    static inline int zmap_upsert_concurrent_##Name(zmap_concurrent_##Name *m, KeyT key, ValT init,                     \
+                                                    void (*fn)(ValT *val, void *ctx), void *ctx)                        \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        zmap_shard_##Name *s = zmap_shard_for_##Name(m, &hash);                                                         \
+        int rc = Z_OK;                                                                                                  \
+        ZMAP_RWLOCK_WRLOCK(&s->lock);                                                                                   \
+        ValT *v = s->map.count ? zmap_find_hashed_##Name##_shard(&s->map, key, hash) : NULL;                            \
+        if (!v)                                                                                                         \
+        {                                                                                                               \
+            rc = zmap_shard_put_##Name(&s->map, key, init, hash);                                                       \
+        }                                                                                                               \
+        else if (fn)                                                                                                    \
+        {                                                                                                               \
+            fn(v, ctx);                                                                                                 \
+        }                                                                                                               \
+        ZMAP_RWLOCK_WRUNLOCK(&s->lock);                                                                                 \
+        return rc;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Sum of shard sizes. Each shard is read under its lock, but the total is                                          \
+     * not a single atomic snapshot while writers are active. */                                                        \
+    static inline size_t zmap_size_concurrent_##Name(zmap_concurrent_##Name *m)                                         \
+    {                                                                                                                   \
+        size_t total = 0;                                                                                               \
+        for (size_t i = 0; i < m->shard_count; i++)                                                                     \
+        {                                                                                                               \
+            ZMAP_RWLOCK_RDLOCK(&m->shards[i].lock);                                                                     \
+            total += m->shards[i].map.count;                                                                            \
+            ZMAP_RWLOCK_RDUNLOCK(&m->shards[i].lock);                                                                   \
+        }                                                                                                               \
+        return total;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_clear_concurrent_##Name(zmap_concurrent_##Name *m)                                          \
+    {                                                                                                                   \
+        for (size_t i = 0; i < m->shard_count; i++)                                                                     \
+        {                                                                                                               \
+            ZMAP_RWLOCK_WRLOCK(&m->shards[i].lock);                                                                     \
+            zmap_clear_##Name##_shard(&m->shards[i].map);                                                               \
+            ZMAP_RWLOCK_WRUNLOCK(&m->shards[i].lock);                                                                   \
+        }                                                                                                               \
+    }
+
+/*
+ * ZMAP_GENERATE_SEQLOCK_IMPL
+ * Read-Mostly Map Generator. Writers are serialized by a lock and bracket every
+ * in-place change with an odd/even sequence counter; readers take no lock, probe
+ * optimistically and retry if the counter moved. A resize publishes a new table
+ * and frees the old one only after an epoch grace period, so a reader never
+ * touches freed memory. Each of the first 2^ZMAP_SEQ_SLOT_BITS reader threads
+ * owns a slot and announces itself with a plain store; later ones share atomic
+ * counters. Either way the shared cache lines stay read-only.
+ * Keys and values are read while they may be written: they must be trivially
+ * copyable, and cmp_func must tolerate a torn key (it is only trusted once the
+ * sequence check passes).
+ */
+#define ZMAP_GENERATE_SEQLOCK_IMPL(KeyT, ValT, Name)                                                                    \
+    ZMAP_SEQ_ASSERT_TRIVIAL(KeyT, ValT)                                                                                 \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        KeyT key;                                                                                                       \
+        ValT value;                                                                                                     \
+        zmap_hash_t hash;                                                                                               \
+        uint8_t state;                                                                                                  \
+    } zmap_bucket_seq_##Name;                                                                                           \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_bucket_seq_##Name *buckets;                                                                                \
+        size_t capacity;                                                                                                \
+        uint32_t bits;                                                                                                  \
+    } zmap_table_seq_##Name;                                                                                            \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zmap_table_seq_##Name *table;                                                                                   \
+        uint32_t seq;                                                                                                   \
+        uint32_t epoch;                                                                                                 \
+        size_t count;                                                                                                   \
+        size_t threshold;                                                                                               \
+        float load_factor;                                                                                              \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+        ZMAP_RWLOCK_T writer;                                                                                           \
+        zmap_seq_slot slots[1u << ZMAP_SEQ_SLOT_BITS];                                                                  \
+    } zmap_seqlock_##Name;                                                                                              \
+                                                                                                                        \
+    static inline int zmap_init_seqlock_##Name(zmap_seqlock_##Name *m, zmap_hash_t (*h)(KeyT, uint32_t),                \
+                                               int (*c)(KeyT, KeyT))                                                    \
+    {                                                                                                                   \
+        memset(m, 0, sizeof(*m));                                                                                       \
+        m->load_factor = ZMAP_DEFAULT_LOAD;                                                                             \
+        m->seed = 0xCAFEBABE;                                                                                           \
+        m->hash_func = h;                                                                                               \
+        m->cmp_func = c;                                                                                                \
+        return (0 == ZMAP_RWLOCK_INIT(&m->writer)) ? Z_OK : Z_ENOMEM;                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_table_free_seq_##Name(zmap_table_seq_##Name *t)                                             \
+    {                                                                                                                   \
+        if (t)                                                                                                          \
+        {                                                                                                               \
+            ZMAP_FREE(t->buckets);                                                                                      \
+            ZMAP_FREE(t);                                                                                               \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_free_seqlock_##Name(zmap_seqlock_##Name *m)                                                 \
+    {                                                                                                                   \
+        zmap_table_free_seq_##Name(m->table);                                                                           \
+        ZMAP_RWLOCK_DESTROY(&m->writer);                                                                                \
+        m->table = NULL;                                                                                                \
+        m->count = 0;                                                                                                   \
+        m->threshold = 0;                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Robin Hood placement of an absent key (writer only). */                                                          \
+    static inline void zmap_place_seq_##Name(zmap_table_seq_##Name *t, size_t idx, size_t dist,                         \
+                                             KeyT key, ValT val, zmap_hash_t hash)                                      \
+    {                                                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_seq_##Name *b = &t->buckets[idx];                                                               \
+            if (ZMAP_EMPTY == b->state)                                                                                 \
             {                                                                                                           \
-                if (ZMAP_OCCUPIED == m->buckets[i].state)                                                               \
-                {                                                                                                       \
-                    zmap_bucket_##Name entry = m->buckets[i];                                                           \
-                    size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                           \
-                    size_t dist = 0;                                                                                    \
-                    for (;;)                                                                                            \
-                    {                                                                                                   \
-                        if (ZMAP_EMPTY == new_buckets[idx].state)                                                       \
-                        {                                                                                               \
-                            new_buckets[idx] = entry;                                                                   \
-                            new_buckets[idx].state = ZMAP_OCCUPIED;                                                     \
-                            break;                                                                                      \
-                        }                                                                                               \
-                        size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits);         \
-                        if (dist > existing_dist)                                                                       \
-                        {                                                                                               \
-                            zmap_bucket_##Name swap_tmp = new_buckets[idx];                                             \
-                            new_buckets[idx] = entry;                                                                   \
-                            entry = swap_tmp;                                                                           \
-                            dist = existing_dist;                                                                       \
-                        }                                                                                               \
-                        idx = (idx + 1) & (new_cap - 1);                                                                \
-                        dist++;                                                                                         \
-                    }                                                                                                   \
-                }                                                                                                       \
+                b->key = key;                                                                                           \
+                b->value = val;                                                                                         \
+                b->hash = hash;                                                                                         \
+                b->state = ZMAP_OCCUPIED;                                                                               \
+                return;                                                                                                 \
             }                                                                                                           \
-            ZMAP_FREE(m->buckets);                                                                                      \
-            m->buckets = new_buckets;                                                                                   \
-            m->capacity = new_cap;                                                                                      \
-            m->bits = new_bits;                                                                                         \
-            m->threshold = (size_t)(new_cap * m->load_factor);                                                          \
-            return Z_OK;                                                                                                \
+            size_t existing_dist = zmap_dist(idx, t->capacity, b->hash, t->bits);                                       \
+            if (dist > existing_dist)                                                                                   \
+            {                                                                                                           \
+                zmap_bucket_seq_##Name tmp = *b;                                                                        \
+                b->key = key;                                                                                           \
+                b->value = val;                                                                                         \
+                b->hash = hash;                                                                                         \
+                key = tmp.key;                                                                                          \
+                val = tmp.value;                                                                                        \
+                hash = tmp.hash;                                                                                        \
+                dist = existing_dist;                                                                                   \
+            }                                                                                                           \
+            idx = (idx + 1) & (t->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
         }                                                                                                               \
+    }                                                                                                                   \
                                                                                                                         \
-        static inline int zmap_put_##Name(zmap_##Name *m, KeyT key, ValT val)                                           \
+    /* Builds and publishes a larger table, then reclaims the old one once every                                        \
+     * reader that could still see it has left (writer lock held). */                                                   \
+    static inline int zmap_resize_seqlock_##Name(zmap_seqlock_##Name *m, size_t new_cap)                                \
+    {                                                                                                                   \
+        zmap_table_seq_##Name *nt = (zmap_table_seq_##Name*)ZMAP_MALLOC(sizeof(zmap_table_seq_##Name));                 \
+        if (!nt)                                                                                                        \
         {                                                                                                               \
-            if (m->count >= m->threshold)                                                                               \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        nt->buckets = (zmap_bucket_seq_##Name*)ZMAP_CALLOC(new_cap, sizeof(zmap_bucket_seq_##Name));                    \
+        if (!nt->buckets)                                                                                               \
+        {                                                                                                               \
+            ZMAP_FREE(nt);                                                                                              \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        nt->capacity = new_cap;                                                                                         \
+        nt->bits = 0;                                                                                                   \
+        size_t temp = new_cap;                                                                                          \
+        while(temp >>= 1)                                                                                               \
+        {                                                                                                               \
+            nt->bits++;                                                                                                 \
+        }                                                                                                               \
+        zmap_table_seq_##Name *old = m->table;                                                                          \
+        if (old)                                                                                                        \
+        {                                                                                                               \
+            for (size_t i = 0; i < old->capacity; i++)                                                                  \
             {                                                                                                           \
-                size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                          \
-                if (Z_OK != zmap_resize_##Name(m, new_cap))                                                             \
+                zmap_bucket_seq_##Name *b = &old->buckets[i];                                                           \
+                if (ZMAP_OCCUPIED == b->state)                                                                          \
                 {                                                                                                       \
-                    return Z_ENOMEM;                                                                                    \
+                    zmap_place_seq_##Name(nt, zmap_fib_index(b->hash, nt->bits), 0, b->key, b->value, b->hash);         \
                 }                                                                                                       \
             }                                                                                                           \
-            uint32_t hash = m->hash_func(key, m->seed);                                                                 \
-            size_t idx = zmap_fib_index(hash, m->bits);                                                                 \
-            size_t dist = 0;                                                                                            \
-            zmap_bucket_##Name entry = (zmap_bucket_##Name){                                                            \
-                .key = key, .value = val, .stored_hash = hash, .state = ZMAP_OCCUPIED };                                \
-            for (;;)                                                                                                    \
+        }                                                                                                               \
+        ZMAP_ATOMIC_STORE(&m->table, nt, ZMAP_MO_SEQ_CST);                                                              \
+        m->threshold = (size_t)(new_cap * m->load_factor);                                                              \
+        if (old)                                                                                                        \
+        {                                                                                                               \
+            zmap_seq_synchronize(&m->epoch, m->slots, 1u << ZMAP_SEQ_SLOT_BITS);                                        \
+            zmap_table_free_seq_##Name(old);                                                                            \
+        }                                                                                                               \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Lock-free lookup; copies the value into *out (if non-NULL) on a hit. */                                          \
+    static inline bool zmap_get_seqlock_##Name(zmap_seqlock_##Name *m, KeyT key, ValT *out)                             \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        zmap_seq_ticket ticket = zmap_seq_enter(&m->epoch, m->slots, ZMAP_SEQ_SLOT_BITS);                               \
+        bool found;                                                                                                     \
+        ValT tmp;                                                                                                       \
+        memset(&tmp, 0, sizeof(tmp));                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            uint32_t s1 = ZMAP_ATOMIC_LOAD(&m->seq, ZMAP_MO_ACQUIRE);                                                   \
+            if (s1 & 1)                                                                                                 \
             {                                                                                                           \
-                if (ZMAP_EMPTY == m->buckets[idx].state)                                                                \
-                {                                                                                                       \
-                    m->buckets[idx] = entry;                                                                            \
-                    m->count++;                                                                                         \
-                    return Z_OK;                                                                                        \
-                }                                                                                                       \
-                if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                  \
+                ZMAP_CPU_RELAX();                                                                                       \
+                continue;                                                                                               \
+            }                                                                                                           \
+            zmap_table_seq_##Name *t = ZMAP_ATOMIC_LOAD(&m->table, ZMAP_MO_SEQ_CST);                                    \
+            found = false;                                                                                              \
+            if (t)                                                                                                      \
+            {                                                                                                           \
+                size_t idx = zmap_fib_index(hash, t->bits);                                                             \
+                for (size_t dist = 0; dist <= t->capacity; dist++)                                                      \
                 {                                                                                                       \
-                    m->buckets[idx].value = val;                                                                        \
-                    return Z_OK;                                                                                        \
+                    zmap_bucket_seq_##Name *b = &t->buckets[idx];                                                       \
+                    if (ZMAP_EMPTY == b->state || dist > zmap_dist(idx, t->capacity, b->hash, t->bits))                 \
+                    {                                                                                                   \
+                        break;                                                                                          \
+                    }                                                                                                   \
+                    if (b->hash == hash && 0 == m->cmp_func(b->key, key))                                               \
+                    {                                                                                                   \
+                        tmp = b->value;                                                                                 \
+                        found = true;                                                                                   \
+                        break;                                                                                          \
+                    }                                                                                                   \
+                    idx = (idx + 1) & (t->capacity - 1);                                                                \
                 }                                                                                                       \
-                size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);               \
-                if (dist > existing_dist)                                                                               \
+            }                                                                                                           \
+            ZMAP_ATOMIC_FENCE(ZMAP_MO_ACQUIRE);                                                                         \
+            if (ZMAP_ATOMIC_LOAD(&m->seq, ZMAP_MO_RELAXED) == s1)                                                       \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+        }                                                                                                               \
+        zmap_seq_exit(ticket);                                                                                          \
+        if (found && out)                                                                                               \
+        {                                                                                                               \
+            *out = tmp;                                                                                                 \
+        }                                                                                                               \
+        return found;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Opens a write section: readers that overlap it will retry. */                                                    \
+    static inline void zmap_seq_begin_##Name(zmap_seqlock_##Name *m)                                                    \
+    {                                                                                                                   \
+        ZMAP_ATOMIC_STORE(&m->seq, m->seq + 1, ZMAP_MO_RELAXED);                                                        \
+        ZMAP_ATOMIC_FENCE(ZMAP_MO_RELEASE);                                                                             \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_seq_end_##Name(zmap_seqlock_##Name *m)                                                      \
+    {                                                                                                                   \
+        ZMAP_ATOMIC_STORE(&m->seq, m->seq + 1, ZMAP_MO_RELEASE);                                                        \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Writer-side probe. Returns the bucket holding key, or NULL with *out_idx and                                     \
+     * *out_dist set to where an insert should start. */                                                                \
+    static inline zmap_bucket_seq_##Name *zmap_find_seq_##Name(zmap_seqlock_##Name *m, KeyT key, zmap_hash_t hash,      \
+                                                               size_t *out_idx, size_t *out_dist)                       \
+    {                                                                                                                   \
+        zmap_table_seq_##Name *t = m->table;                                                                            \
+        size_t idx = zmap_fib_index(hash, t->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            zmap_bucket_seq_##Name *b = &t->buckets[idx];                                                               \
+            if (ZMAP_EMPTY == b->state || dist > zmap_dist(idx, t->capacity, b->hash, t->bits))                         \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+            if (b->hash == hash && 0 == m->cmp_func(b->key, key))                                                       \
+            {                                                                                                           \
+                return b;                                                                                               \
+            }                                                                                                           \
+            idx = (idx + 1) & (t->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+        *out_idx = idx;                                                                                                 \
+        *out_dist = dist;                                                                                               \
+        return NULL;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Inserts `init` if key is absent, otherwise calls fn(&value, ctx) (if fn is                                       \
+     * non-NULL). fn runs inside the write section and must not block. */                                               \
+    static inline int zmap_upsert_seqlock_##Name(zmap_seqlock_##Name *m, KeyT key, ValT init,                           \
+                                                 void (*fn)(ValT *val, void *ctx), void *ctx)                           \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        size_t idx = 0, dist = 0;                                                                                       \
+        ZMAP_RWLOCK_WRLOCK(&m->writer);                                                                                 \
+        if (m->count >= m->threshold)                                                                                   \
+        {                                                                                                               \
+            size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->table ? m->table->capacity : 0));                        \
+            if (Z_OK != zmap_resize_seqlock_##Name(m, new_cap))                                                         \
+            {                                                                                                           \
+                ZMAP_RWLOCK_WRUNLOCK(&m->writer);                                                                       \
+                return Z_ENOMEM;                                                                                        \
+            }                                                                                                           \
+        }                                                                                                               \
+        zmap_bucket_seq_##Name *b = zmap_find_seq_##Name(m, key, hash, &idx, &dist);                                    \
+        zmap_seq_begin_##Name(m);                                                                                       \
+        if (b)                                                                                                          \
+        {                                                                                                               \
+            if (fn)                                                                                                     \
+            {                                                                                                           \
+                fn(&b->value, ctx);                                                                                     \
+            }                                                                                                           \
+        }                                                                                                               \
+        else                                                                                                            \
+        {                                                                                                               \
+            zmap_place_seq_##Name(m->table, idx, dist, key, init, hash);                                                \
+            ZMAP_ATOMIC_STORE(&m->count, m->count + 1, ZMAP_MO_RELAXED);                                                \
+        }                                                                                                               \
+        zmap_seq_end_##Name(m);                                                                                         \
+        ZMAP_RWLOCK_WRUNLOCK(&m->writer);                                                                               \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_seq_assign_##Name(ValT *dst, void *src)                                                     \
+    {                                                                                                                   \
+        *dst = *(ValT*)src;                                                                                             \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zmap_put_seqlock_##Name(zmap_seqlock_##Name *m, KeyT key, ValT val)                               \
+    {                                                                                                                   \
+        return zmap_upsert_seqlock_##Name(m, key, val, zmap_seq_assign_##Name, &val);                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline bool zmap_remove_seqlock_##Name(zmap_seqlock_##Name *m, KeyT key)                                     \
+    {                                                                                                                   \
+        zmap_hash_t hash = m->hash_func(key, m->seed);                                                                  \
+        size_t idx = 0, dist = 0;                                                                                       \
+        ZMAP_RWLOCK_WRLOCK(&m->writer);                                                                                 \
+        zmap_bucket_seq_##Name *b = m->count ? zmap_find_seq_##Name(m, key, hash, &idx, &dist) : NULL;                  \
+        if (!b)                                                                                                         \
+        {                                                                                                               \
+            ZMAP_RWLOCK_WRUNLOCK(&m->writer);                                                                           \
+            return false;                                                                                               \
+        }                                                                                                               \
+        zmap_table_seq_##Name *t = m->table;                                                                            \
+        idx = (size_t)(b - t->buckets);                                                                                 \
+        zmap_seq_begin_##Name(m);                                                                                       \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            size_t next = (idx + 1) & (t->capacity - 1);                                                                \
+            zmap_bucket_seq_##Name *nb = &t->buckets[next];                                                             \
+            if (ZMAP_EMPTY == nb->state || 0 == zmap_dist(next, t->capacity, nb->hash, t->bits))                        \
+            {                                                                                                           \
+                t->buckets[idx].state = ZMAP_EMPTY;                                                                     \
+                break;                                                                                                  \
+            }                                                                                                           \
+            t->buckets[idx] = *nb;                                                                                      \
+            idx = next;                                                                                                 \
+        }                                                                                                               \
+        ZMAP_ATOMIC_STORE(&m->count, m->count - 1, ZMAP_MO_RELAXED);                                                    \
+        zmap_seq_end_##Name(m);                                                                                         \
+        ZMAP_RWLOCK_WRUNLOCK(&m->writer);                                                                               \
+        return true;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_size_seqlock_##Name(zmap_seqlock_##Name *m)                                               \
+    {                                                                                                                   \
+        return ZMAP_ATOMIC_LOAD(&m->count, ZMAP_MO_RELAXED);                                                            \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_clear_seqlock_##Name(zmap_seqlock_##Name *m)                                                \
+    {                                                                                                                   \
+        ZMAP_RWLOCK_WRLOCK(&m->writer);                                                                                 \
+        zmap_seq_begin_##Name(m);                                                                                       \
+        if (m->table)                                                                                                   \
+        {                                                                                                               \
+            for (size_t i = 0; i < m->table->capacity; i++)                                                             \
+            {                                                                                                           \
+                m->table->buckets[i].state = ZMAP_EMPTY;                                                                \
+            }                                                                                                           \
+        }                                                                                                               \
+        ZMAP_ATOMIC_STORE(&m->count, (size_t)0, ZMAP_MO_RELAXED);                                                       \
+        zmap_seq_end_##Name(m);                                                                                         \
+        ZMAP_RWLOCK_WRUNLOCK(&m->writer);                                                                               \
+    }
+
+/*
+ * ZMAP_GENERATE_SET_IMPL
+ * Set Generator (keys only). Keys live in one array and a parallel byte array
+ * holds the Robin Hood probe distance (see ZMAP_META_SAT), so a slot costs
+ * sizeof(KeyT) + 1 bytes. Without stored hashes, keys are compared only where
+ * the slot's distance equals the probe's own, and are rehashed on resize and
+ * for the rare saturated distances.
+ */
+#define ZMAP_GENERATE_SET_IMPL(KeyT, Name)                                                                              \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        KeyT *keys;                                                                                                     \
+        uint8_t *meta;                                                                                                  \
+        size_t capacity;                                                                                                \
+        size_t count;                                                                                                   \
+        size_t threshold;                                                                                               \
+        uint32_t bits;                                                                                                  \
+        float load_factor;                                                                                              \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+    } zset_##Name;                                                                                                      \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        zset_##Name *set;                                                                                               \
+        size_t index;                                                                                                   \
+    } zset_iter_##Name;                                                                                                 \
+                                                                                                                        \
+    static inline zset_##Name zset_init_ext_##Name(zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT), float load)  \
+    {                                                                                                                   \
+        zset_##Name s;                                                                                                  \
+        memset(&s, 0, sizeof(s));                                                                                       \
+        s.load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load;                                      \
+        s.seed = 0xCAFEBABE;                                                                                            \
+        s.hash_func = h;                                                                                                \
+        s.cmp_func = c;                                                                                                 \
+        return s;                                                                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zset_##Name zset_init_##Name(zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))                  \
+    {                                                                                                                   \
+        return zset_init_ext_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                           \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zset_set_seed_##Name(zset_##Name *s, uint32_t seed)                                              \
+    {                                                                                                                   \
+        s->seed = seed;                                                                                                 \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zset_free_##Name(zset_##Name *s)                                                                 \
+    {                                                                                                                   \
+        ZMAP_DELETE_ARRAY(KeyT, s->keys);                                                                               \
+        ZMAP_FREE(s->meta);                                                                                             \
+        s->keys = NULL;                                                                                                 \
+        s->meta = NULL;                                                                                                 \
+        s->capacity = 0;                                                                                                \
+        s->count = 0;                                                                                                   \
+        s->threshold = 0;                                                                                               \
+        s->bits = 0;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zset_clear_##Name(zset_##Name *s)                                                                \
+    {                                                                                                                   \
+        for (size_t i = 0; i < s->capacity; i++)                                                                        \
+        {                                                                                                               \
+            if (s->meta[i])                                                                                             \
+            {                                                                                                           \
+                ZMAP_RESET(s->keys[i]);                                                                                 \
+                s->meta[i] = 0;                                                                                         \
+            }                                                                                                           \
+        }                                                                                                               \
+        s->count = 0;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Probe distance of the key stored at idx, rehashing it only when saturated. */                                    \
+    static inline size_t zset_dist_##Name(zset_##Name *s, KeyT const *keys, uint8_t const *meta,                        \
+                                          size_t capacity, uint32_t bits, size_t idx)                                   \
+    {                                                                                                                   \
+        if (meta[idx] < ZMAP_META_SAT)                                                                                  \
+        {                                                                                                               \
+            return (size_t)(meta[idx] - 1);                                                                             \
+        }                                                                                                               \
+        return zmap_dist(idx, capacity, s->hash_func(keys[idx], s->seed), bits);                                        \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Robin Hood placement of an absent key, starting at `idx` with probe distance `dist`. */                          \
+    static inline void zset_place_##Name(zset_##Name *s, KeyT *keys, uint8_t *meta, size_t capacity,                    \
+                                         uint32_t bits, size_t idx, size_t dist, KeyT key)                              \
+    {                                                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            if (0 == meta[idx])                                                                                         \
+            {                                                                                                           \
+                keys[idx] = ZMAP_MOVE(key);                                                                             \
+                meta[idx] = zmap_meta_encode(dist);                                                                     \
+                return;                                                                                                 \
+            }                                                                                                           \
+            size_t existing_dist = zset_dist_##Name(s, keys, meta, capacity, bits, idx);                                \
+            if (dist > existing_dist)                                                                                   \
+            {                                                                                                           \
+                ZMAP_SWAP(KeyT, keys[idx], key);                                                                        \
+                meta[idx] = zmap_meta_encode(dist);                                                                     \
+                dist = existing_dist;                                                                                   \
+            }                                                                                                           \
+            idx = (idx + 1) & (capacity - 1);                                                                           \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline int zset_resize_##Name(zset_##Name *s, size_t new_cap)                                                \
+    {                                                                                                                   \
+        KeyT *new_keys = ZMAP_NEW_ARRAY(KeyT, new_cap);                                                                 \
+        uint8_t *new_meta = (uint8_t*)ZMAP_CALLOC(new_cap, sizeof(uint8_t));                                            \
+        if (!new_keys || !new_meta)                                                                                     \
+        {                                                                                                               \
+            ZMAP_DELETE_ARRAY(KeyT, new_keys);                                                                          \
+            ZMAP_FREE(new_meta);                                                                                        \
+            return Z_ENOMEM;                                                                                            \
+        }                                                                                                               \
+        uint32_t new_bits = 0;                                                                                          \
+        size_t temp = new_cap;                                                                                          \
+        while (temp >>= 1)                                                                                              \
+        {                                                                                                               \
+            new_bits++;                                                                                                 \
+        }                                                                                                               \
+        for (size_t i = 0; i < s->capacity; i++)                                                                        \
+        {                                                                                                               \
+            if (s->meta[i])                                                                                             \
+            {                                                                                                           \
+                zmap_hash_t hash = s->hash_func(s->keys[i], s->seed);                                                   \
+                zset_place_##Name(s, new_keys, new_meta, new_cap, new_bits, zmap_fib_index(hash, new_bits), 0,          \
+                                  ZMAP_MOVE(s->keys[i]));                                                               \
+            }                                                                                                           \
+        }                                                                                                               \
+        ZMAP_DELETE_ARRAY(KeyT, s->keys);                                                                               \
+        ZMAP_FREE(s->meta);                                                                                             \
+        s->keys = new_keys;                                                                                             \
+        s->meta = new_meta;                                                                                             \
+        s->capacity = new_cap;                                                                                          \
+        s->bits = new_bits;                                                                                             \
+        s->threshold = (size_t)(new_cap * s->load_factor);                                                              \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Walks the probe sequence of key. Returns true with idx at the key, or                                            \
+     * false with idx/dist at the Robin Hood insertion point. */                                                        \
+    static inline bool zset_probe_##Name(zset_##Name *s, KeyT key, zmap_hash_t hash, size_t *idx, size_t *dist)         \
+    {                                                                                                                   \
+        size_t i = zmap_fib_index(hash, s->bits);                                                                       \
+        size_t d = 0;                                                                                                   \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            uint8_t md = s->meta[i];                                                                                    \
+            if (0 == md)                                                                                                \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+            size_t existing_dist = (md < ZMAP_META_SAT) ? (size_t)(md - 1)                                              \
+                                 : (d + 1 < ZMAP_META_SAT) ? SIZE_MAX                                                   \
+                                 : zset_dist_##Name(s, s->keys, s->meta, s->capacity, s->bits, i);                      \
+            if (d > existing_dist)                                                                                      \
+            {                                                                                                           \
+                break;                                                                                                  \
+            }                                                                                                           \
+            if (d == existing_dist && 0 == s->cmp_func(s->keys[i], key))                                                \
+            {                                                                                                           \
+                *idx = i;                                                                                               \
+                return true;                                                                                            \
+            }                                                                                                           \
+            i = (i + 1) & (s->capacity - 1);                                                                            \
+            d++;                                                                                                        \
+        }                                                                                                               \
+        *idx = i;                                                                                                       \
+        *dist = d;                                                                                                      \
+        return false;                                                                                                   \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Adds key. Returns Z_OK if it was added, Z_FOUND if already present, Z_ENOMEM on failure. */                      \
+    static inline int zset_insert_##Name(zset_##Name *s, KeyT key)                                                      \
+    {                                                                                                                   \
+        zmap_hash_t hash = s->hash_func(key, s->seed);                                                                  \
+        size_t idx = 0;                                                                                                 \
+        size_t dist = 0;                                                                                                \
+        if (s->count > 0 && zset_probe_##Name(s, key, hash, &idx, &dist))                                               \
+        {                                                                                                               \
+            return Z_FOUND;                                                                                             \
+        }                                                                                                               \
+        if (s->count >= s->threshold || 0 == s->count)                                                                  \
+        {                                                                                                               \
+            if (s->count >= s->threshold &&                                                                             \
+                Z_OK != zset_resize_##Name(s, zmap_next_pow2(Z_GROWTH_FACTOR(s->capacity))))                            \
+            {                                                                                                           \
+                return Z_ENOMEM;                                                                                        \
+            }                                                                                                           \
+            zset_probe_##Name(s, key, hash, &idx, &dist);                                                               \
+        }                                                                                                               \
+        zset_place_##Name(s, s->keys, s->meta, s->capacity, s->bits, idx, dist, key);                                   \
+        s->count++;                                                                                                     \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline bool zset_contains_##Name(zset_##Name *s, KeyT key)                                                   \
+    {                                                                                                                   \
+        size_t idx;                                                                                                     \
+        size_t dist;                                                                                                    \
+        if (0 == s->count)                                                                                              \
+        {                                                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        return zset_probe_##Name(s, key, s->hash_func(key, s->seed), &idx, &dist);                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Removes key with backward shifting. Returns true if it was present. */                                           \
+    static inline bool zset_remove_##Name(zset_##Name *s, KeyT key)                                                     \
+    {                                                                                                                   \
+        size_t idx;                                                                                                     \
+        size_t dist;                                                                                                    \
+        if (0 == s->count || !zset_probe_##Name(s, key, s->hash_func(key, s->seed), &idx, &dist))                       \
+        {                                                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        s->count--;                                                                                                     \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            size_t next = (idx + 1) & (s->capacity - 1);                                                                \
+            uint8_t next_md = s->meta[next];                                                                            \
+            if (next_md <= 1)                                                                                           \
+            {                                                                                                           \
+                ZMAP_RESET(s->keys[idx]);                                                                               \
+                s->meta[idx] = 0;                                                                                       \
+                return true;                                                                                            \
+            }                                                                                                           \
+            size_t next_dist = zset_dist_##Name(s, s->keys, s->meta, s->capacity, s->bits, next);                       \
+            s->keys[idx] = ZMAP_MOVE(s->keys[next]);                                                                    \
+            s->meta[idx] = zmap_meta_encode(next_dist - 1);                                                             \
+            idx = next;                                                                                                 \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zset_size_##Name(zset_##Name *s)                                                               \
+    {                                                                                                                   \
+        return s->count;                                                                                                \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zset_memory_usage_##Name(zset_##Name *s)                                                       \
+    {                                                                                                                   \
+        return sizeof(*s) + s->capacity * (sizeof(KeyT) + sizeof(uint8_t));                                             \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline zset_iter_##Name zset_iter_init_##Name(zset_##Name *s)                                                \
+    {                                                                                                                   \
+        zset_iter_##Name it;                                                                                            \
+        it.set = s;                                                                                                     \
+        it.index = 0;                                                                                                   \
+        return it;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline bool zset_iter_next_##Name(zset_iter_##Name *it, KeyT *out_k)                                         \
+    {                                                                                                                   \
+        if (!it->set || !it->set->meta)                                                                                 \
+        {                                                                                                               \
+            return false;                                                                                               \
+        }                                                                                                               \
+        while (it->index < it->set->capacity)                                                                           \
+        {                                                                                                               \
+            size_t i = it->index++;                                                                                     \
+            if (it->set->meta[i])                                                                                       \
+            {                                                                                                           \
+                if (out_k)                                                                                              \
                 {                                                                                                       \
-                    zmap_bucket_##Name swap_tmp = m->buckets[idx];                                                      \
-                    m->buckets[idx] = entry;                                                                            \
-                    entry = swap_tmp;                                                                                   \
-                    dist = existing_dist;                                                                               \
+                    *out_k = it->set->keys[i];                                                                          \
                 }                                                                                                       \
-                idx = (idx + 1) & (m->capacity - 1);                                                                    \
-                dist++;                                                                                                 \
+                return true;                                                                                            \
             }                                                                                                           \
-        }
-
-#   define ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                               \
-        static inline void zmap_free_stable_##Name(zmap_stable_##Name *m)                                       \
-        {                                                                                                       \
-            if (m->buckets)                                                                                     \
-            {                                                                                                   \
-                for (size_t i = 0; i < m->capacity; i++)                                                        \
-                {                                                                                               \
-                    if (ZMAP_OCCUPIED == m->buckets[i].state)                                                   \
-                    {                                                                                           \
-                        ZMAP_FREE(m->buckets[i].value);                                                         \
-                    }                                                                                           \
-                }                                                                                               \
-                ZMAP_FREE(m->buckets);                                                                          \
-            }                                                                                                   \
-            *m = (zmap_stable_##Name){0};                                                                       \
-        }                                                                                                       \
-                                                                                                                \
-        static inline void zmap_clear_stable_##Name(zmap_stable_##Name *m)                                      \
-        {                                                                                                       \
-            zmap_free_stable_##Name(m);                                                                         \
-        }                                                                                                       \
-                                                                                                                \
-        static inline int zmap_resize_stable_##Name(zmap_stable_##Name *m, size_t new_cap)                      \
-        {                                                                                                       \
-            zmap_bucket_stable_##Name *new_buckets = (zmap_bucket_stable_##Name*)                               \
-                                                     ZMAP_CALLOC(new_cap, sizeof(zmap_bucket_stable_##Name));   \
-            if (!new_buckets)                                                                                   \
-            {                                                                                                   \
-                return Z_ENOMEM;                                                                                \
-            }                                                                                                   \
-            uint32_t new_bits = 0;                                                                              \
-            size_t temp = new_cap;                                                                              \
-            while(temp >>= 1)                                                                                   \
-            {                                                                                                   \
-                new_bits++;                                                                                     \
-            }                                                                                                   \
-            for (size_t i = 0; i < m->capacity; i++)                                                            \
-            {                                                                                                   \
-                if (ZMAP_OCCUPIED == m->buckets[i].state)                                                       \
-                {                                                                                               \
-                    zmap_bucket_stable_##Name entry = m->buckets[i];                                            \
-                    size_t idx = zmap_fib_index(entry.stored_hash, new_bits);                                   \
-                    size_t dist = 0;                                                                            \
-                    for (;;)                                                                                    \
-                    {                                                                                           \
-                        if (ZMAP_EMPTY == new_buckets[idx].state)                                               \
-                        {                                                                                       \
-                            new_buckets[idx] = entry;                                                           \
-                            new_buckets[idx].state = ZMAP_OCCUPIED;                                             \
-                            break;                                                                              \
-                        }                                                                                       \
-                        size_t existing_dist = zmap_dist(idx, new_cap, new_buckets[idx].stored_hash, new_bits); \
-                        if (dist > existing_dist)                                                               \
-                        {                                                                                       \
-                            zmap_bucket_stable_##Name tmp = new_buckets[idx];                                   \
-                            new_buckets[idx] = entry;                                                           \
-                            entry = tmp;                                                                        \
-                            dist = existing_dist;                                                               \
-                        }                                                                                       \
-                        idx = (idx + 1) & (new_cap - 1);                                                        \
-                        dist++;                                                                                 \
-                    }                                                                                           \
-                }                                                                                               \
-            }                                                                                                   \
-            ZMAP_FREE(m->buckets);                                                                              \
-            m->buckets = new_buckets;                                                                           \
-            m->capacity = new_cap;                                                                              \
-            m->bits = new_bits;                                                                                 \
-            m->threshold = (size_t)(new_cap * m->load_factor);                                                  \
-            return Z_OK;                                                                                        \
-        }                                                                                                       \
-                                                                                                                \
-        static inline int zmap_put_stable_##Name(zmap_stable_##Name *m, KeyT key, ValT val)                     \
-        {                                                                                                       \
-            if (m->count >= m->threshold)                                                                       \
-            {                                                                                                   \
-                size_t new_cap = zmap_next_pow2(Z_GROWTH_FACTOR(m->capacity));                                  \
-                if (Z_OK != zmap_resize_stable_##Name(m, new_cap))                                              \
-                {                                                                                               \
-                    return Z_ENOMEM;                                                                            \
-                }                                                                                               \
-            }                                                                                                   \
-            uint32_t hash = m->hash_func(key, m->seed);                                                         \
-            size_t idx = zmap_fib_index(hash, m->bits);                                                         \
-            size_t dist = 0;                                                                                    \
-            zmap_bucket_stable_##Name entry = (zmap_bucket_stable_##Name){                                      \
-                .key = key, .value = NULL, .stored_hash = hash, .state = ZMAP_OCCUPIED };                       \
-            for (;;)                                                                                            \
-            {                                                                                                   \
-                if (ZMAP_EMPTY == m->buckets[idx].state)                                                        \
-                {                                                                                               \
-                    if (!entry.value)                                                                           \
-                    {                                                                                           \
-                        entry.value = (ValT*)ZMAP_MALLOC(sizeof(ValT));                                         \
-                        if (!entry.value)                                                                       \
-                        {                                                                                       \
-                            return Z_ENOMEM;                                                                    \
-                        }                                                                                       \
-                        *entry.value = val;                                                                     \
-                    }                                                                                           \
-                    m->buckets[idx] = entry;                                                                    \
-                    m->count++;                                                                                 \
-                    return Z_OK;                                                                                \
-                }                                                                                               \
-                if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))          \
-                {                                                                                               \
-                     *m->buckets[idx].value = val;                                                              \
-                     return Z_OK;                                                                               \
-                }                                                                                               \
-                size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);       \
-                if (dist > existing_dist)                                                                       \
-                {                                                                                               \
-                    if (!entry.value)                                                                           \
-                    {                                                                                           \
-                        entry.value = (ValT*)ZMAP_MALLOC(sizeof(ValT));                                         \
-                        if (!entry.value)                                                                       \
-                        {                                                                                       \
-                            return Z_ENOMEM;                                                                    \
-                        }                                                                                       \
-                        *entry.value = val;                                                                     \
-                    }                                                                                           \
-                    zmap_bucket_stable_##Name temp = m->buckets[idx];                                           \
-                    m->buckets[idx] = entry;                                                                    \
-                    entry = temp;                                                                               \
-                    dist = existing_dist;                                                                       \
-                }                                                                                               \
-                idx = (idx + 1) & (m->capacity - 1);                                                            \
-                dist++;                                                                                         \
-            }                                                                                                   \
-        }                                                                                                       \
-        static inline void zmap_remove_val_stable_##Name(ValT *ptr)                                             \
-        {                                                                                                       \
-            ZMAP_FREE(ptr);                                                                                     \
-        }
-#endif
+        }                                                                                                               \
+        return false;                                                                                                   \
+    }
 
 /*
- * ZMAP_GENERATE_IMPL
- * Standard In-Place Map Generator.
+ * ZMAP_GENERATE_FROZEN_IMPL
+ * Read-only snapshots of a standard map (see "Frozen snapshots"). Keys and
+ * values must be trivially copyable and hold no pointers. The hash and
+ * compare functions are supplied again at open and must match the ones used
+ * to build the map.
  */
-#define ZMAP_GENERATE_IMPL(KeyT, ValT, Name)                                                                                \
-    typedef struct                                                                                                          \
-    {                                                                                                                       \
-        KeyT key;                                                                                                           \
-        ValT value;                                                                                                         \
-        uint32_t stored_hash;                                                                                               \
-        zmap_state state;                                                                                                   \
-    } zmap_bucket_##Name;                                                                                                   \
-                                                                                                                            \
-    typedef struct                                                                                                          \
-    {                                                                                                                       \
-        zmap_bucket_##Name *buckets;                                                                                        \
-        size_t capacity;                                                                                                    \
-        size_t count;                                                                                                       \
-        size_t threshold;                                                                                                   \
-        uint32_t bits;                                                                                                      \
-        float  load_factor;                                                                                                 \
-        uint32_t seed;                                                                                                      \
-        uint32_t (*hash_func)(KeyT, uint32_t);                                                                              \
-        int      (*cmp_func)(KeyT, KeyT);                                                                                   \
-    } zmap_##Name;                                                                                                          \
-                                                                                                                            \
-    typedef struct                                                                                                          \
-    {                                                                                                                       \
-        zmap_##Name *map;                                                                                                   \
-        size_t index;                                                                                                       \
-    } zmap_iter_##Name;                                                                                                     \
-                                                                                                                            \
-    static inline zmap_##Name zmap_init_ext_##Name(uint32_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT), float load)         \
-    {                                                                                                                       \
-        return (zmap_##Name){                                                                                               \
-            .buckets = NULL, .capacity = 0, .count = 0, .threshold = 0,                                                     \
-            .bits = 0, .load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load,                            \
-            .seed = 0xCAFEBABE, .hash_func = h, .cmp_func = c                                                               \
-        };                                                                                                                  \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline zmap_##Name zmap_init_##Name(uint32_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))                         \
-    {                                                                                                                       \
-        return zmap_init_ext_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                               \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline void zmap_set_seed_##Name(zmap_##Name *m, uint32_t s)                                                     \
-    {                                                                                                                       \
-        m->seed = s;                                                                                                        \
-    }                                                                                                                       \
-                                                                                                                            \
-    ZMAP_IMPL_OPS(KeyT, ValT, Name)                                                                                         \
-                                                                                                                            \
-    static inline ValT* zmap_get_##Name(zmap_##Name *m, KeyT key)                                                           \
-    {                                                                                                                       \
-        if (0 == m->count)                                                                                                  \
-        {                                                                                                                   \
-            return NULL;                                                                                                    \
-        }                                                                                                                   \
-        uint32_t hash = m->hash_func(key, m->seed);                                                                         \
-        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
-        size_t dist = 0;                                                                                                    \
-        for (;;)                                                                                                            \
-        {                                                                                                                   \
-            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
-            {                                                                                                               \
-                return NULL;                                                                                                \
-            }                                                                                                               \
-            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
-            if (dist > existing_dist)                                                                                       \
-            {                                                                                                               \
-                return NULL;                                                                                                \
-            }                                                                                                               \
-            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
-            {                                                                                                               \
-                return &m->buckets[idx].value;                                                                              \
-            }                                                                                                               \
-            idx = (idx + 1) & (m->capacity - 1);                                                                            \
-            dist++;                                                                                                         \
-        }                                                                                                                   \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline void zmap_remove_##Name(zmap_##Name *m, KeyT key)                                                         \
-    {                                                                                                                       \
-        if (0 == m->count)                                                                                                  \
-        {                                                                                                                   \
-            return;                                                                                                         \
-        }                                                                                                                   \
-        uint32_t hash = m->hash_func(key, m->seed);                                                                         \
-        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
-        size_t dist = 0;                                                                                                    \
-        for (;;)                                                                                                            \
-        {                                                                                                                   \
-            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
-            {                                                                                                               \
-                return;                                                                                                     \
-            }                                                                                                               \
-            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
-            if (dist > existing_dist)                                                                                       \
-            {                                                                                                               \
-                return;                                                                                                     \
-            }                                                                                                               \
-            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
-            {                                                                                                               \
-                m->count--;                                                                                                 \
-                for (;;)                                                                                                    \
-                {                                                                                                           \
-                    size_t next = (idx + 1) & (m->capacity - 1);                                                            \
-                    if (ZMAP_EMPTY == m->buckets[next].state)                                                               \
-                    {                                                                                                       \
-                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
-                        return;                                                                                             \
-                    }                                                                                                       \
-                    size_t next_dist = zmap_dist(next, m->capacity, m->buckets[next].stored_hash, m->bits);                 \
-                    if (0 == next_dist)                                                                                     \
-                    {                                                                                                       \
-                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
-                        return;                                                                                             \
-                    }                                                                                                       \
-                    m->buckets[idx] = m->buckets[next];                                                                     \
-                    idx = next;                                                                                             \
-                }                                                                                                           \
-            }                                                                                                               \
-            idx = (idx + 1) & (m->capacity - 1);                                                                            \
-            dist++;                                                                                                         \
-        }                                                                                                                   \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline zmap_iter_##Name zmap_iter_init_##Name(zmap_##Name *m)                                                    \
-    {                                                                                                                       \
-        return (zmap_iter_##Name){ .map = m, .index = 0 };                                                                  \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline bool zmap_iter_next_##Name(zmap_iter_##Name *it, KeyT *out_k, ValT *out_v)                                \
-    {                                                                                                                       \
-        if (!it->map || !it->map->buckets)                                                                                  \
-        {                                                                                                                   \
-            return false;                                                                                                   \
-        }                                                                                                                   \
-        while (it->index < it->map->capacity)                                                                               \
-        {                                                                                                                   \
-            size_t i = it->index++;                                                                                         \
-            if (ZMAP_OCCUPIED == it->map->buckets[i].state)                                                                 \
-            {                                                                                                               \
-                if (out_k) *out_k = it->map->buckets[i].key;                                                                \
-                if (out_v) *out_v = it->map->buckets[i].value;                                                              \
-                return true;                                                                                                \
-            }                                                                                                               \
-        }                                                                                                                   \
-        return false;                                                                                                       \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline size_t zmap_size_##Name(zmap_##Name *m)                                                                   \
-    {                                                                                                                       \
-        return m->count;                                                                                                    \
-    }                                                                                                                       \
-                                                                                                                            \
-    ZMAP_GEN_SAFE_IMPL(KeyT, ValT, Name)
+#define ZMAP_GENERATE_FROZEN_IMPL(KeyT, ValT, Name)                                                                     \
+    ZMAP_FROZEN_ASSERT(KeyT, ValT)                                                                                      \
+                                                                                                                        \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        const zmap_bucket_##Name *buckets;                                                                              \
+        size_t capacity;                                                                                                \
+        size_t count;                                                                                                   \
+        uint32_t bits;                                                                                                  \
+        uint32_t seed;                                                                                                  \
+        float load_factor;      /* The source map's, for rebuilding a mutable copy. */                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+        void *base;                                                                                                     \
+        size_t length;                                                                                                  \
+        bool mapped;                                                                                                    \
+    } zmap_frozen_##Name;                                                                                               \
+                                                                                                                        \
+    /* Writes m to path as a header plus the raw bucket array. Returns Z_OK or Z_ERR. */                                \
+    static inline int zmap_freeze_##Name(zmap_##Name *m, const char *path)                                              \
+    {                                                                                                                   \
+        size_t bytes = m->capacity * sizeof(zmap_bucket_##Name);                                                        \
+        zmap_frozen_header hdr = zmap_frozen_header_make(sizeof(zmap_bucket_##Name), m->capacity, m->count,             \
+                                                         m->bits, m->seed, m->load_factor);                             \
+        hdr.checksum = zmap_frozen_checksum(m->buckets, bytes);                                                         \
+        FILE *fp = fopen(path, "wb");                                                                                   \
+        if (!fp)                                                                                                        \
+        {                                                                                                               \
+            return Z_ERR;                                                                                               \
+        }                                                                                                               \
+        bool ok = 1 == fwrite(&hdr, sizeof(hdr), 1, fp) && (0 == bytes || 1 == fwrite(m->buckets, bytes, 1, fp));       \
+        ok = (0 == fclose(fp)) && ok;                                                                                   \
+        return ok ? Z_OK : Z_ERR;                                                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Reads a snapshot image already in memory. The image must outlive f.                                              \
+     * Returns Z_EINVAL if it was written for another layout or is truncated. */                                        \
+    static inline int zmap_frozen_view_##Name(zmap_frozen_##Name *f, const void *data, size_t len,                      \
+                                              zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))                   \
+    {                                                                                                                   \
+        const zmap_frozen_header *hdr = zmap_frozen_check(data, len, sizeof(zmap_bucket_##Name));                       \
+        if (!hdr)                                                                                                       \
+        {                                                                                                               \
+            return Z_EINVAL;                                                                                            \
+        }                                                                                                               \
+        memset(f, 0, sizeof(*f));                                                                                       \
+        f->buckets = (const zmap_bucket_##Name*)((const char*)data + sizeof(zmap_frozen_header));                       \
+        f->capacity = (size_t)hdr->capacity;                                                                            \
+        f->count = (size_t)hdr->count;                                                                                  \
+        f->bits = hdr->bits;                                                                                            \
+        f->seed = hdr->seed;                                                                                            \
+        f->load_factor = hdr->load_factor;                                                                              \
+        f->hash_func = h;                                                                                               \
+        f->cmp_func = c;                                                                                                \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Maps the snapshot at path read-only; pages load on first probe. */                                               \
+    static inline int zmap_frozen_open_##Name(zmap_frozen_##Name *f, const char *path,                                  \
+                                              zmap_hash_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))                   \
+    {                                                                                                                   \
+        size_t len = 0;                                                                                                 \
+        bool mapped = false;                                                                                            \
+        void *base = zmap_frozen_load(path, &len, &mapped);                                                             \
+        if (!base)                                                                                                      \
+        {                                                                                                               \
+            return Z_ERR;                                                                                               \
+        }                                                                                                               \
+        int rc = zmap_frozen_view_##Name(f, base, len, h, c);                                                           \
+        if (Z_OK != rc)                                                                                                 \
+        {                                                                                                               \
+            zmap_frozen_unload(base, len, mapped);                                                                      \
+            return rc;                                                                                                  \
+        }                                                                                                               \
+        f->base = base;                                                                                                 \
+        f->length = len;                                                                                                \
+        f->mapped = mapped;                                                                                             \
+        return Z_OK;                                                                                                    \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline void zmap_frozen_close_##Name(zmap_frozen_##Name *f)                                                  \
+    {                                                                                                                   \
+        if (f->base)                                                                                                    \
+        {                                                                                                               \
+            zmap_frozen_unload(f->base, f->length, f->mapped);                                                          \
+        }                                                                                                               \
+        memset(f, 0, sizeof(*f));                                                                                       \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Recomputes the checksum. Touches every page, so it is not done at open. */                                       \
+    static inline bool zmap_frozen_verify_##Name(zmap_frozen_##Name *f)                                                 \
+    {                                                                                                                   \
+        const zmap_frozen_header *hdr = (const zmap_frozen_header*)                                                     \
+                                        ((const char*)f->buckets - sizeof(zmap_frozen_header));                         \
+        return hdr->checksum == zmap_frozen_checksum(f->buckets, f->capacity * sizeof(zmap_bucket_##Name));             \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline const ValT* zmap_frozen_get_##Name(zmap_frozen_##Name *f, KeyT key)                                   \
+    {                                                                                                                   \
+        if (0 == f->count)                                                                                              \
+        {                                                                                                               \
+            return NULL;                                                                                                \
+        }                                                                                                               \
+        zmap_hash_t hash = f->hash_func(key, f->seed);                                                                  \
+        size_t idx = zmap_fib_index(hash, f->bits);                                                                     \
+        size_t dist = 0;                                                                                                \
+        for (;;)                                                                                                        \
+        {                                                                                                               \
+            const zmap_bucket_##Name *b = &f->buckets[idx];                                                             \
+            if (ZMAP_EMPTY == b->state)                                                                                 \
+            {                                                                                                           \
+                return NULL;                                                                                            \
+            }                                                                                                           \
+            if (dist > zmap_dist(idx, f->capacity, b->stored_hash, f->bits))                                            \
+            {                                                                                                           \
+                return NULL;                                                                                            \
+            }                                                                                                           \
+            if (b->stored_hash == hash && 0 == f->cmp_func(b->key, key))                                                \
+            {                                                                                                           \
+                return &b->value;                                                                                       \
+            }                                                                                                           \
+            idx = (idx + 1) & (f->capacity - 1);                                                                        \
+            dist++;                                                                                                     \
+        }                                                                                                               \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_frozen_size_##Name(zmap_frozen_##Name *f)                                                 \
+    {                                                                                                                   \
+        return f->count;                                                                                                \
+    }
 
 /*
- * ZMAP_GENERATE_STABLE_IMPL
- * Stable Map Generator. Values are heap-allocated pointers.
+ * ZMAP_GENERATE_PERFECT_IMPL
+ * Static maps built once from a fixed key set by minimal perfect hashing:
+ * n keys occupy exactly n slots, and a lookup compares one key at most.
  */
-#define ZMAP_GENERATE_STABLE_IMPL(KeyT, ValT, Name)                                                                         \
-    typedef struct {                                                                                                        \
-        KeyT key;                                                                                                           \
-        ValT *value;                                                                                                        \
-        uint32_t stored_hash;                                                                                               \
-        zmap_state state;                                                                                                   \
-    } zmap_bucket_stable_##Name;                                                                                            \
-                                                                                                                            \
-    typedef struct                                                                                                          \
-    {                                                                                                                       \
-        zmap_bucket_stable_##Name *buckets;                                                                                 \
-        size_t capacity;                                                                                                    \
-        size_t count;                                                                                                       \
-        size_t threshold;                                                                                                   \
-        uint32_t bits;                                                                                                      \
-        float load_factor;                                                                                                  \
-        uint32_t seed;                                                                                                      \
-        uint32_t (*hash_func)(KeyT, uint32_t);                                                                              \
-        int (*cmp_func)(KeyT, KeyT);                                                                                        \
-    } zmap_stable_##Name;                                                                                                   \
-                                                                                                                            \
-    typedef struct                                                                                                          \
-    {                                                                                                                       \
-        zmap_stable_##Name *map;                                                                                            \
-        size_t index;                                                                                                       \
-    } zmap_iter_stable_##Name;                                                                                              \
-                                                                                                                            \
-    static inline zmap_stable_##Name zmap_init_ext_stable_##Name(uint32_t (*h)(KeyT, uint32_t),                             \
-                                                                 int (*c)(KeyT, KeyT), float load)                          \
-    {                                                                                                                       \
-        return (zmap_stable_##Name){                                                                                        \
-            .buckets = NULL, .capacity = 0, .count = 0, .threshold = 0,                                                     \
-            .bits = 0, .load_factor = (load <= 0.1f || load > 0.95f) ? ZMAP_DEFAULT_LOAD : load,                            \
-            .seed = 0xCAFEBABE, .hash_func = h, .cmp_func = c                                                               \
-        };                                                                                                                  \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline zmap_stable_##Name zmap_init_stable_##Name(uint32_t (*h)(KeyT, uint32_t), int (*c)(KeyT, KeyT))           \
-    {                                                                                                                       \
-        return zmap_init_ext_stable_##Name(h, c, ZMAP_DEFAULT_LOAD);                                                        \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline void zmap_set_seed_stable_##Name(zmap_stable_##Name *m, uint32_t s)                                       \
-    {                                                                                                                       \
-        m->seed = s;                                                                                                        \
-    }                                                                                                                       \
-                                                                                                                            \
-    ZMAP_IMPL_STABLE_OPS(KeyT, ValT, Name)                                                                                  \
-                                                                                                                            \
-    static inline ValT* zmap_get_stable_##Name(zmap_stable_##Name *m, KeyT key)                                             \
-    {                                                                                                                       \
-        if (0 == m->count)                                                                                                  \
-        {                                                                                                                   \
-            return NULL;                                                                                                    \
-        }                                                                                                                   \
-        uint32_t hash = m->hash_func(key, m->seed);                                                                         \
-        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
-        size_t dist = 0;                                                                                                    \
-        for (;;)                                                                                                            \
-        {                                                                                                                   \
-            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
-            {                                                                                                               \
-                return NULL;                                                                                                \
-            }                                                                                                               \
-            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
-            if (dist > existing_dist)                                                                                       \
-            {                                                                                                               \
-                return NULL;                                                                                                \
-            }                                                                                                               \
-            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
-            {                                                                                                               \
-                return m->buckets[idx].value;                                                                               \
-            }                                                                                                               \
-            idx = (idx + 1) & (m->capacity - 1);                                                                            \
-            dist++;                                                                                                         \
-        }                                                                                                                   \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline void zmap_remove_stable_##Name(zmap_stable_##Name *m, KeyT key)                                           \
-    {                                                                                                                       \
-        if (0 == m->count)                                                                                                  \
-        {                                                                                                                   \
-            return;                                                                                                         \
-        }                                                                                                                   \
-        uint32_t hash = m->hash_func(key, m->seed);                                                                         \
-        size_t idx = zmap_fib_index(hash, m->bits);                                                                         \
-        size_t dist = 0;                                                                                                    \
-        for (;;)                                                                                                            \
-        {                                                                                                                   \
-            if (ZMAP_EMPTY == m->buckets[idx].state)                                                                        \
-            {                                                                                                               \
-                return;                                                                                                     \
-            }                                                                                                               \
-            size_t existing_dist = zmap_dist(idx, m->capacity, m->buckets[idx].stored_hash, m->bits);                       \
-            if (dist > existing_dist)                                                                                       \
-            {                                                                                                               \
-                return;                                                                                                     \
-            }                                                                                                               \
-            if (m->buckets[idx].stored_hash == hash && 0 == m->cmp_func(m->buckets[idx].key, key))                          \
-            {                                                                                                               \
-                zmap_remove_val_stable_##Name(m->buckets[idx].value);                                                       \
-                m->count--;                                                                                                 \
-                for (;;)                                                                                                    \
-                {                                                                                                           \
-                    size_t next = (idx + 1) & (m->capacity - 1);                                                            \
-                    if (ZMAP_EMPTY == m->buckets[next].state)                                                               \
-                    {                                                                                                       \
-                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
-                        return;                                                                                             \
-                    }                                                                                                       \
-                    size_t next_dist = zmap_dist(next, m->capacity, m->buckets[next].stored_hash, m->bits);                 \
-                    if (0 == next_dist)                                                                                     \
-                    {                                                                                                       \
-                        m->buckets[idx].state = ZMAP_EMPTY;                                                                 \
-                        return;                                                                                             \
-                    }                                                                                                       \
-                    m->buckets[idx] = m->buckets[next];                                                                     \
-                    idx = next;                                                                                             \
-                }                                                                                                           \
-            }                                                                                                               \
-            idx = (idx + 1) & (m->capacity - 1);                                                                            \
-            dist++;                                                                                                         \
-        }                                                                                                                   \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline size_t zmap_size_stable_##Name(zmap_stable_##Name *m)                                                     \
-    {                                                                                                                       \
-        return m->count;                                                                                                    \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline zmap_iter_stable_##Name zmap_iter_init_stable_##Name(zmap_stable_##Name *m)                               \
-    {                                                                                                                       \
-        return (zmap_iter_stable_##Name){m, 0};                                                                             \
-    }                                                                                                                       \
-                                                                                                                            \
-    static inline bool zmap_iter_next_stable_##Name(zmap_iter_stable_##Name *it, KeyT *out_k, ValT *out_v)                  \
-    {                                                                                                                       \
-        if(!it->map || !it->map->buckets)                                                                                   \
-        {                                                                                                                   \
-            return false;                                                                                                   \
-        }                                                                                                                   \
-        while(it->index < it->map->capacity)                                                                                \
-        {                                                                                                                   \
-            size_t i = it->index++;                                                                                         \
-            if(ZMAP_OCCUPIED == it->map->buckets[i].state)                                                                  \
-            {                                                                                                               \
-                if(out_k)                                                                                                   \
-                {                                                                                                           \
-                    *out_k = it->map->buckets[i].key;                                                                       \
-                }                                                                                                           \
-                if(out_v)                                                                                                   \
-                {                                                                                                           \
-                    *out_v = *it->map->buckets[i].value;                                                                    \
-                }                                                                                                           \
-                return true;                                                                                                \
-            }                                                                                                               \
-        }                                                                                                                   \
-        return false;                                                                                                       \
+#define ZMAP_GENERATE_PERFECT_IMPL(KeyT, ValT, Name)                                                                    \
+    typedef struct                                                                                                      \
+    {                                                                                                                   \
+        KeyT *keys;                                                                                                     \
+        ValT *values;                                                                                                   \
+        uint32_t *pilots;                                                                                               \
+        size_t count;                                                                                                   \
+        size_t buckets;                                                                                                 \
+        uint32_t seed;                                                                                                  \
+        zmap_hash_t (*hash_func)(KeyT, uint32_t);                                                                       \
+        int (*cmp_func)(KeyT, KeyT);                                                                                    \
+    } zmap_perfect_##Name;                                                                                              \
+                                                                                                                        \
+    static inline void zmap_perfect_free_##Name(zmap_perfect_##Name *p)                                                 \
+    {                                                                                                                   \
+        ZMAP_DELETE_ARRAY(KeyT, p->keys);                                                                               \
+        ZMAP_DELETE_ARRAY(ValT, p->values);                                                                             \
+        ZMAP_FREE(p->pilots);                                                                                           \
+        p->keys = NULL;                                                                                                 \
+        p->values = NULL;                                                                                               \
+        p->pilots = NULL;                                                                                               \
+        p->count = 0;                                                                                                   \
+        p->buckets = 0;                                                                                                 \
+    }                                                                                                                   \
+                                                                                                                        \
+    /* Builds p from n distinct keys, reseeding if two keys share a 64-bit hash                                         \
+     * or a bucket finds no pilot.                                                                                      \
+     * Returns Z_OK, Z_EEXIST on a duplicate key, Z_ENOMEM, or Z_ERR if every                                           \
+     * seed failed. */                                                                                                  \
+    static inline int zmap_build_perfect_##Name(zmap_perfect_##Name *p, zmap_hash_t (*h)(KeyT, uint32_t),               \
+                                                int (*c)(KeyT, KeyT), KeyT const *keys, ValT const *vals, size_t n)     \
+    {                                                                                                                   \
+        memset(p, 0, sizeof(*p));                                                                                       \
+        p->hash_func = h;                                                                                               \
+        p->cmp_func = c;                                                                                                \
+        p->seed = 0xCAFEBABE;                                                                                           \
+        if (0 == n)                                                                                                     \
+        {                                                                                                               \
+            return Z_OK;                                                                                                \
+        }                                                                                                               \
+        p->buckets = (n + ZMAP_PHF_LAMBDA - 1) / ZMAP_PHF_LAMBDA;                                                       \
+        uint64_t *hashes = (uint64_t*)ZMAP_MALLOC(n * sizeof(uint64_t));                                                \
+        size_t *slots = (size_t*)ZMAP_MALLOC(n * sizeof(size_t));                                                       \
+        p->pilots = (uint32_t*)ZMAP_CALLOC(p->buckets, sizeof(uint32_t));                                               \
+        int rc = (hashes && slots && p->pilots) ? Z_ERR : Z_ENOMEM;                                                     \
+        for (int attempt = 0; Z_ERR == rc && attempt < ZMAP_PHF_ATTEMPTS; attempt++)                                    \
+        {                                                                                                               \
+            size_t dup[2] = { 0, 0 };                                                                                   \
+            for (size_t i = 0; i < n; i++)                                                                              \
+            {                                                                                                           \
+                hashes[i] = ZMAP_PHF_HASH(h, keys[i], p->seed);                                                         \
+            }                                                                                                           \
+            rc = zmap_phf_place(hashes, n, p->buckets, p->pilots, slots, dup);                                          \
+            if (Z_EEXIST == rc)                                                                                         \
+            {                                                                                                           \
+                rc = (0 == c(keys[dup[0]], keys[dup[1]])) ? Z_EEXIST : Z_ERR;                                           \
+            }                                                                                                           \
+            if (Z_ERR == rc)                                                                                            \
+            {                                                                                                           \
+                p->seed = p->seed * 0x9E3779B9u + 1;                                                                    \
+            }                                                                                                           \
+        }                                                                                                               \
+        if (Z_OK == rc)                                                                                                 \
+        {                                                                                                               \
+            p->keys = ZMAP_NEW_ARRAY(KeyT, n);                                                                          \
+            p->values = ZMAP_NEW_ARRAY(ValT, n);                                                                        \
+            rc = (p->keys && p->values) ? Z_OK : Z_ENOMEM;                                                              \
+        }                                                                                                               \
+        if (Z_OK == rc)                                                                                                 \
+        {                                                                                                               \
+            for (size_t i = 0; i < n; i++)                                                                              \
+            {                                                                                                           \
+                p->keys[slots[i]] = keys[i];                                                                            \
+                p->values[slots[i]] = vals[i];                                                                          \
+            }                                                                                                           \
+            p->count = n;                                                                                               \
+        }                                                                                                               \
+        else                                                                                                            \
+        {                                                                                                               \
+            zmap_perfect_free_##Name(p);                                                                                \
+        }                                                                                                               \
+        ZMAP_FREE(hashes);                                                                                              \
+        ZMAP_FREE(slots);                                                                                               \
+        return rc;                                                                                                      \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline ValT* zmap_perfect_get_##Name(zmap_perfect_##Name *p, KeyT key)                                       \
+    {                                                                                                                   \
+        if (0 == p->count)                                                                                              \
+        {                                                                                                               \
+            return NULL;                                                                                                \
+        }                                                                                                               \
+        uint64_t hash = ZMAP_PHF_HASH(p->hash_func, key, p->seed);                                                      \
+        size_t slot = zmap_phf_slot(hash, p->pilots[zmap_phf_bucket(hash, p->buckets)], p->count);                      \
+        return (0 == p->cmp_func(p->keys[slot], key)) ? &p->values[slot] : NULL;                                        \
+    }                                                                                                                   \
+                                                                                                                        \
+    static inline size_t zmap_perfect_size_##Name(zmap_perfect_##Name *p)                                               \
+    {                                                                                                                   \
+        return p->count;                                                                                                \
     }
 
 // Dispatch entries.
@@ -1385,19 +5574,117 @@ static inline size_t zmap_dist(size_t index, size_t capacity, uint32_t hash, uin
 #define M_FREE_ENTRY(K, V, N)    zmap_##N*: zmap_free_##N,
 #define M_SIZE_ENTRY(K, V, N)    zmap_##N*: zmap_size_##N,
 #define M_CLEAR_ENTRY(K, V, N)   zmap_##N*: zmap_clear_##N,
-#define M_SEED_ENTRY(K, V, N)    zmap_##N*: zmap_set_seed_##Name,
-#define M_ITER_INIT(K, V, N)     zmap_##N*: zmap_iter_init_##Name,
-#define M_ITER_NEXT(K, V, N)     zmap_iter_##N*: zmap_iter_next_##Name,
+#define M_SEED_ENTRY(K, V, N)    zmap_##N*: zmap_set_seed_##N,
+#define M_ITER_INIT(K, V, N)     zmap_##N*: zmap_iter_init_##N,
+#define M_ITER_NEXT(K, V, N)     zmap_iter_##N*: zmap_iter_next_##N,
+#define M_GET_MANY_ENTRY(K, V, N) zmap_##N*: zmap_get_many_##N,
+#define M_PUT_MANY_ENTRY(K, V, N) zmap_##N*: zmap_put_many_##N,
+#define M_RESERVE_ENTRY(K, V, N) zmap_##N*: zmap_reserve_##N,
+#define M_SHRINK_ENTRY(K, V, N)  zmap_##N*: zmap_shrink_to_fit_##N,
+#define M_REHASH_ENTRY(K, V, N)  zmap_##N*: zmap_rehash_##N,
+#define M_STATS_ENTRY(K, V, N)   zmap_##N*: zmap_stats_##N,
+#define M_MEM_ENTRY(K, V, N)     zmap_##N*: zmap_memory_usage_##N,
+#define M_GET_OR_INSERT(K, V, N) zmap_##N*: zmap_get_or_insert_##N,
 
 #define S_PUT_ENTRY(K, V, N)     zmap_stable_##N*: zmap_put_stable_##N,
 #define S_GET_ENTRY(K, V, N)     zmap_stable_##N*: zmap_get_stable_##N,
-#define S_REM_ENTRY(K, V, N)     zmap_stable_##N*: zmap_remove_stable_##Name,
-#define S_FREE_ENTRY(K, V, N)    zmap_stable_##N*: zmap_free_stable_##Name,
-#define S_SIZE_ENTRY(K, V, N)    zmap_stable_##N*: zmap_size_stable_##Name,
-#define S_CLEAR_ENTRY(K, V, N)   zmap_stable_##N*: zmap_clear_stable_##Name,
-#define S_SEED_ENTRY(K, V, N)    zmap_stable_##N*: zmap_set_seed_stable_##Name,
-#define S_ITER_INIT(K, V, N)     zmap_stable_##N*: zmap_iter_init_stable_##Name,
-#define S_ITER_NEXT(K, V, N)     zmap_iter_stable_##N*: zmap_iter_next_stable_##Name,
+#define S_REM_ENTRY(K, V, N)     zmap_stable_##N*: zmap_remove_stable_##N,
+#define S_FREE_ENTRY(K, V, N)    zmap_stable_##N*: zmap_free_stable_##N,
+#define S_SIZE_ENTRY(K, V, N)    zmap_stable_##N*: zmap_size_stable_##N,
+#define S_CLEAR_ENTRY(K, V, N)   zmap_stable_##N*: zmap_clear_stable_##N,
+#define S_SEED_ENTRY(K, V, N)    zmap_stable_##N*: zmap_set_seed_stable_##N,
+#define S_ITER_INIT(K, V, N)     zmap_stable_##N*: zmap_iter_init_stable_##N,
+#define S_ITER_NEXT(K, V, N)     zmap_iter_stable_##N*: zmap_iter_next_stable_##N,
+#define S_MEM_ENTRY(K, V, N)     zmap_stable_##N*: zmap_memory_usage_stable_##N,
+
+#define G_PUT_ENTRY(K, V, N)     zmap_group_##N*: zmap_put_group_##N,
+#define G_GET_ENTRY(K, V, N)     zmap_group_##N*: zmap_get_group_##N,
+#define G_REM_ENTRY(K, V, N)     zmap_group_##N*: zmap_remove_group_##N,
+#define G_FREE_ENTRY(K, V, N)    zmap_group_##N*: zmap_free_group_##N,
+#define G_SIZE_ENTRY(K, V, N)    zmap_group_##N*: zmap_size_group_##N,
+#define G_CLEAR_ENTRY(K, V, N)   zmap_group_##N*: zmap_clear_group_##N,
+#define G_SEED_ENTRY(K, V, N)    zmap_group_##N*: zmap_set_seed_group_##N,
+#define G_ITER_INIT(K, V, N)     zmap_group_##N*: zmap_iter_init_group_##N,
+#define G_ITER_NEXT(K, V, N)     zmap_iter_group_##N*: zmap_iter_next_group_##N,
+#define G_MEM_ENTRY(K, V, N)     zmap_group_##N*: zmap_memory_usage_group_##N,
+
+#define A_PUT_ENTRY(K, V, N)     zmap_soa_##N*: zmap_put_soa_##N,
+#define A_GET_ENTRY(K, V, N)     zmap_soa_##N*: zmap_get_soa_##N,
+#define A_REM_ENTRY(K, V, N)     zmap_soa_##N*: zmap_remove_soa_##N,
+#define A_FREE_ENTRY(K, V, N)    zmap_soa_##N*: zmap_free_soa_##N,
+#define A_SIZE_ENTRY(K, V, N)    zmap_soa_##N*: zmap_size_soa_##N,
+#define A_CLEAR_ENTRY(K, V, N)   zmap_soa_##N*: zmap_clear_soa_##N,
+#define A_SEED_ENTRY(K, V, N)    zmap_soa_##N*: zmap_set_seed_soa_##N,
+#define A_ITER_INIT(K, V, N)     zmap_soa_##N*: zmap_iter_init_soa_##N,
+#define A_ITER_NEXT(K, V, N)     zmap_iter_soa_##N*: zmap_iter_next_soa_##N,
+#define A_MEM_ENTRY(K, V, N)     zmap_soa_##N*: zmap_memory_usage_soa_##N,
+
+#define R_PUT_ENTRY(K, V, N)     zmap_incr_##N*: zmap_put_incr_##N,
+#define R_GET_ENTRY(K, V, N)     zmap_incr_##N*: zmap_get_incr_##N,
+#define R_REM_ENTRY(K, V, N)     zmap_incr_##N*: zmap_remove_incr_##N,
+#define R_FREE_ENTRY(K, V, N)    zmap_incr_##N*: zmap_free_incr_##N,
+#define R_SIZE_ENTRY(K, V, N)    zmap_incr_##N*: zmap_size_incr_##N,
+#define R_CLEAR_ENTRY(K, V, N)   zmap_incr_##N*: zmap_clear_incr_##N,
+#define R_SEED_ENTRY(K, V, N)    zmap_incr_##N*: zmap_set_seed_incr_##N,
+#define R_ITER_INIT(K, V, N)     zmap_incr_##N*: zmap_iter_init_incr_##N,
+#define R_ITER_NEXT(K, V, N)     zmap_iter_incr_##N*: zmap_iter_next_incr_##N,
+#define R_MIGRATE_ENTRY(K, V, N) zmap_incr_##N*: zmap_migrate_incr_##N,
+#define R_MEM_ENTRY(K, V, N)     zmap_incr_##N*: zmap_memory_usage_incr_##N,
+
+#define C_PUT_ENTRY(K, V, N)     zmap_concurrent_##N*: zmap_put_concurrent_##N,
+#define C_GET_ENTRY(K, V, N)     zmap_concurrent_##N*: zmap_get_concurrent_##N,
+#define C_REM_ENTRY(K, V, N)     zmap_concurrent_##N*: zmap_remove_concurrent_##N,
+#define C_UPSERT_ENTRY(K, V, N)  zmap_concurrent_##N*: zmap_upsert_concurrent_##N,
+#define C_FREE_ENTRY(K, V, N)    zmap_concurrent_##N*: zmap_free_concurrent_##N,
+#define C_SIZE_ENTRY(K, V, N)    zmap_concurrent_##N*: zmap_size_concurrent_##N,
+#define C_CLEAR_ENTRY(K, V, N)   zmap_concurrent_##N*: zmap_clear_concurrent_##N,
+
+#define Q_PUT_ENTRY(K, V, N)     zmap_seqlock_##N*: zmap_put_seqlock_##N,
+#define Q_GET_ENTRY(K, V, N)     zmap_seqlock_##N*: zmap_get_seqlock_##N,
+#define Q_REM_ENTRY(K, V, N)     zmap_seqlock_##N*: zmap_remove_seqlock_##N,
+#define Q_UPSERT_ENTRY(K, V, N)  zmap_seqlock_##N*: zmap_upsert_seqlock_##N,
+#define Q_FREE_ENTRY(K, V, N)    zmap_seqlock_##N*: zmap_free_seqlock_##N,
+#define Q_SIZE_ENTRY(K, V, N)    zmap_seqlock_##N*: zmap_size_seqlock_##N,
+#define Q_CLEAR_ENTRY(K, V, N)   zmap_seqlock_##N*: zmap_clear_seqlock_##N,
+
+#define F_FREEZE_ENTRY(K, V, N)  zmap_##N*: zmap_freeze_##N,
+#define F_GET_ENTRY(K, V, N)     zmap_frozen_##N*: zmap_frozen_get_##N,
+#define F_SIZE_ENTRY(K, V, N)    zmap_frozen_##N*: zmap_frozen_size_##N,
+#define F_VERIFY_ENTRY(K, V, N)  zmap_frozen_##N*: zmap_frozen_verify_##N,
+#define F_CLOSE_ENTRY(K, V, N)   zmap_frozen_##N*: zmap_frozen_close_##N,
+
+#define P_GET_ENTRY(K, V, N)     zmap_perfect_##N*: zmap_perfect_get_##N,
+#define P_SIZE_ENTRY(K, V, N)    zmap_perfect_##N*: zmap_perfect_size_##N,
+#define P_FREE_ENTRY(K, V, N)    zmap_perfect_##N*: zmap_perfect_free_##N,
+
+#define ST_INSERT_ENTRY(K, N)    zset_##N*: zset_insert_##N,
+#define ST_HAS_ENTRY(K, N)       zset_##N*: zset_contains_##N,
+#define ST_REM_ENTRY(K, N)       zset_##N*: zset_remove_##N,
+#define ST_FREE_ENTRY(K, N)      zset_##N*: zset_free_##N,
+#define ST_SIZE_ENTRY(K, N)      zset_##N*: zset_size_##N,
+#define ST_CLEAR_ENTRY(K, N)     zset_##N*: zset_clear_##N,
+#define ST_SEED_ENTRY(K, N)      zset_##N*: zset_set_seed_##N,
+#define ST_ITER_NEXT(K, N)       zset_iter_##N*: zset_iter_next_##N,
+#define ST_MEM_ENTRY(K, N)       zset_##N*: zset_memory_usage_##N,
+
+// Inline maps share the standard map type, so they reuse its entries.
+#define MI_PUT_ENTRY(K, V, N, H, E)     M_PUT_ENTRY(K, V, N)
+#define MI_GET_ENTRY(K, V, N, H, E)     M_GET_ENTRY(K, V, N)
+#define MI_REM_ENTRY(K, V, N, H, E)     M_REM_ENTRY(K, V, N)
+#define MI_FREE_ENTRY(K, V, N, H, E)    M_FREE_ENTRY(K, V, N)
+#define MI_SIZE_ENTRY(K, V, N, H, E)    M_SIZE_ENTRY(K, V, N)
+#define MI_CLEAR_ENTRY(K, V, N, H, E)   M_CLEAR_ENTRY(K, V, N)
+#define MI_SEED_ENTRY(K, V, N, H, E)    M_SEED_ENTRY(K, V, N)
+#define MI_ITER_INIT(K, V, N, H, E)     M_ITER_INIT(K, V, N)
+#define MI_ITER_NEXT(K, V, N, H, E)     M_ITER_NEXT(K, V, N)
+#define MI_GET_MANY_ENTRY(K, V, N, H, E) M_GET_MANY_ENTRY(K, V, N)
+#define MI_PUT_MANY_ENTRY(K, V, N, H, E) M_PUT_MANY_ENTRY(K, V, N)
+#define MI_RESERVE_ENTRY(K, V, N, H, E)  M_RESERVE_ENTRY(K, V, N)
+#define MI_SHRINK_ENTRY(K, V, N, H, E)   M_SHRINK_ENTRY(K, V, N)
+#define MI_REHASH_ENTRY(K, V, N, H, E)   M_REHASH_ENTRY(K, V, N)
+#define MI_STATS_ENTRY(K, V, N, H, E)    M_STATS_ENTRY(K, V, N)
+#define MI_MEM_ENTRY(K, V, N, H, E)      M_MEM_ENTRY(K, V, N)
+#define MI_GET_OR_INSERT(K, V, N, H, E)  M_GET_OR_INSERT(K, V, N)
 
 #if Z_HAS_ZERROR
     static inline zres zmap_err_dummy(void* v, ...)
@@ -1423,44 +5710,217 @@ static inline size_t zmap_dist(size_t index, size_t capacity, uint32_t hash, uin
 #ifndef Z_AUTOGEN_MAPS
 #   define Z_AUTOGEN_MAPS(X)
 #endif
+#ifndef REGISTER_ZMAP_REF_TYPES
+#   define REGISTER_ZMAP_REF_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_REF_MAPS
+#   define Z_AUTOGEN_REF_MAPS(X)
+#endif
 #ifndef REGISTER_STABLE_MAPS
 #   define REGISTER_STABLE_MAPS(X)
 #endif
 #ifndef Z_AUTOGEN_STABLE_MAPS
 #   define Z_AUTOGEN_STABLE_MAPS(X)
 #endif
+#ifndef REGISTER_ZMAP_GROUP_TYPES
+#   define REGISTER_ZMAP_GROUP_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_GROUP_MAPS
+#   define Z_AUTOGEN_GROUP_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_SOA_TYPES
+#   define REGISTER_ZMAP_SOA_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_SOA_MAPS
+#   define Z_AUTOGEN_SOA_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_INCR_TYPES
+#   define REGISTER_ZMAP_INCR_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_INCR_MAPS
+#   define Z_AUTOGEN_INCR_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_CONCURRENT_TYPES
+#   define REGISTER_ZMAP_CONCURRENT_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_CONCURRENT_MAPS
+#   define Z_AUTOGEN_CONCURRENT_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_SEQLOCK_TYPES
+#   define REGISTER_ZMAP_SEQLOCK_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_SEQLOCK_MAPS
+#   define Z_AUTOGEN_SEQLOCK_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_INLINE_TYPES
+#   define REGISTER_ZMAP_INLINE_TYPES(X)
+#endif
+#ifndef REGISTER_ZMAP_FROZEN_TYPES
+#   define REGISTER_ZMAP_FROZEN_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_FROZEN_MAPS
+#   define Z_AUTOGEN_FROZEN_MAPS(X)
+#endif
+#ifndef REGISTER_ZMAP_PERFECT_TYPES
+#   define REGISTER_ZMAP_PERFECT_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_PERFECT_MAPS
+#   define Z_AUTOGEN_PERFECT_MAPS(X)
+#endif
+#ifndef REGISTER_ZSET_TYPES
+#   define REGISTER_ZSET_TYPES(X)
+#endif
+#ifndef Z_AUTOGEN_SETS
+#   define Z_AUTOGEN_SETS(X)
+#endif
+#ifndef Z_AUTOGEN_INLINE_MAPS
+#   define Z_AUTOGEN_INLINE_MAPS(X)
+#endif
 
 #define Z_ALL_MAPS(X)        Z_AUTOGEN_MAPS(X)        REGISTER_ZMAP_TYPES(X)
+#define Z_ALL_REF_MAPS(X)    Z_AUTOGEN_REF_MAPS(X)    REGISTER_ZMAP_REF_TYPES(X)
 #define Z_ALL_STABLE_MAPS(X) Z_AUTOGEN_STABLE_MAPS(X) REGISTER_STABLE_MAPS(X)
+#define Z_ALL_GROUP_MAPS(X)  Z_AUTOGEN_GROUP_MAPS(X)  REGISTER_ZMAP_GROUP_TYPES(X)
+#define Z_ALL_SOA_MAPS(X)    Z_AUTOGEN_SOA_MAPS(X)    REGISTER_ZMAP_SOA_TYPES(X)
+#define Z_ALL_INCR_MAPS(X)   Z_AUTOGEN_INCR_MAPS(X)   REGISTER_ZMAP_INCR_TYPES(X)
+#define Z_ALL_INLINE_MAPS(X) Z_AUTOGEN_INLINE_MAPS(X) REGISTER_ZMAP_INLINE_TYPES(X)
+#define Z_ALL_CONCURRENT_MAPS(X) Z_AUTOGEN_CONCURRENT_MAPS(X) REGISTER_ZMAP_CONCURRENT_TYPES(X)
+#define Z_ALL_SEQLOCK_MAPS(X)    Z_AUTOGEN_SEQLOCK_MAPS(X)    REGISTER_ZMAP_SEQLOCK_TYPES(X)
+#define Z_ALL_SETS(X)        Z_AUTOGEN_SETS(X)        REGISTER_ZSET_TYPES(X)
+#define Z_ALL_FROZEN_MAPS(X) Z_AUTOGEN_FROZEN_MAPS(X) REGISTER_ZMAP_FROZEN_TYPES(X)
+#define Z_ALL_PERFECT_MAPS(X) Z_AUTOGEN_PERFECT_MAPS(X) REGISTER_ZMAP_PERFECT_TYPES(X)
+
+// Thread-safe flavours for one dispatch entry suffix.
+#define ZMAP_SHARED_CASES(OP) Z_ALL_CONCURRENT_MAPS(C_##OP) Z_ALL_SEQLOCK_MAPS(Q_##OP)
+
+// Every registered map flavour for one dispatch entry suffix (PUT_ENTRY, ITER_INIT, ...).
+#define ZMAP_ALL_CASES(OP)   Z_ALL_MAPS(M_##OP) Z_ALL_STABLE_MAPS(S_##OP) Z_ALL_GROUP_MAPS(G_##OP) \
+                             Z_ALL_SOA_MAPS(A_##OP) Z_ALL_INCR_MAPS(R_##OP) Z_ALL_INLINE_MAPS(MI_##OP) \
+                             Z_ALL_REF_MAPS(M_##OP)
 
 Z_ALL_MAPS(ZMAP_GENERATE_IMPL)
+Z_ALL_REF_MAPS(ZMAP_GENERATE_REF_IMPL)
 Z_ALL_STABLE_MAPS(ZMAP_GENERATE_STABLE_IMPL)
+Z_ALL_GROUP_MAPS(ZMAP_GENERATE_GROUP_IMPL)
+Z_ALL_SOA_MAPS(ZMAP_GENERATE_SOA_IMPL)
+Z_ALL_INCR_MAPS(ZMAP_GENERATE_INCR_IMPL)
+Z_ALL_CONCURRENT_MAPS(ZMAP_GENERATE_CONCURRENT_IMPL)
+Z_ALL_SEQLOCK_MAPS(ZMAP_GENERATE_SEQLOCK_IMPL)
+Z_ALL_INLINE_MAPS(ZMAP_GENERATE_IMPL_INLINE)
+Z_ALL_SETS(ZMAP_GENERATE_SET_IMPL)
+Z_ALL_FROZEN_MAPS(ZMAP_GENERATE_FROZEN_IMPL)
+Z_ALL_PERFECT_MAPS(ZMAP_GENERATE_PERFECT_IMPL)
 
 // API Macros.
 #define zmap_init(Name, h, c)        zmap_init_##Name(h, c)
 #define zmap_init_stable(Name, h, c) zmap_init_stable_##Name(h, c)
+#define zmap_init_stable_arena(Name, h, c) zmap_init_stable_arena_##Name(h, c)
+#define zmap_init_alloc(Name, h, c, a) zmap_init_alloc_##Name(h, c, a)
+#define zmap_init_group(Name, h, c)  zmap_init_group_##Name(h, c)
+#define zmap_init_soa(Name, h, c)    zmap_init_soa_##Name(h, c)
+#define zmap_init_incr(Name, h, c)   zmap_init_incr_##Name(h, c)
+#define zmap_init_concurrent(Name, m, h, c, shards) zmap_init_concurrent_##Name(m, h, c, shards)
+#define zmap_init_seqlock(Name, m, h, c)            zmap_init_seqlock_##Name(m, h, c)
+#define zmap_init_inline(Name)       zmap_init_ext_##Name(NULL, NULL, ZMAP_DEFAULT_LOAD)
+#define zset_init(Name, h, c)        zset_init_##Name(h, c)
+#define zmap_frozen_open(Name, f, path, h, c) zmap_frozen_open_##Name(f, path, h, c)
+#define zmap_build_perfect(Name, p, h, c, keys, vals, n) zmap_build_perfect_##Name(p, h, c, keys, vals, n)
 
 #if defined(Z_HAS_CLEANUP) && Z_HAS_CLEANUP
 #   define zmap_autofree(Name)          Z_CLEANUP(zmap_free_##Name) zmap_##Name
 #   define zmap_autofree_stable(Name)   Z_CLEANUP(zmap_free_stable_##Name) zmap_stable_##Name
+#   define zmap_autofree_group(Name)    Z_CLEANUP(zmap_free_group_##Name) zmap_group_##Name
+#   define zmap_autofree_soa(Name)      Z_CLEANUP(zmap_free_soa_##Name) zmap_soa_##Name
+#   define zmap_autofree_incr(Name)     Z_CLEANUP(zmap_free_incr_##Name) zmap_incr_##Name
+#   define zset_autofree(Name)          Z_CLEANUP(zset_free_##Name) zset_##Name
+#endif
+
+#define zmap_put(m, k, v)   _Generic((m), ZMAP_ALL_CASES(PUT_ENTRY)   default: 0)(m, k, v)
+#define zmap_get(m, k)      _Generic((m), ZMAP_ALL_CASES(GET_ENTRY)   default: (void*)0)(m, k)
+#define zmap_remove(m, k)   _Generic((m), ZMAP_ALL_CASES(REM_ENTRY)   default: (void)0)(m, k)
+#define zmap_free(m)        _Generic((m), ZMAP_ALL_CASES(FREE_ENTRY)  default: (void)0)(m)
+#define zmap_size(m)        _Generic((m), ZMAP_ALL_CASES(SIZE_ENTRY)  default: 0)(m)
+#define zmap_clear(m)       _Generic((m), ZMAP_ALL_CASES(CLEAR_ENTRY) default: (void)0)(m)
+#define zmap_set_seed(m, s) _Generic((m), ZMAP_ALL_CASES(SEED_ENTRY)  default: (void)0)(m, s)
+
+// Batch operations (standard maps).
+#define zmap_get_many(m, keys, n, out) _Generic((m), Z_ALL_MAPS(M_GET_MANY_ENTRY) Z_ALL_INLINE_MAPS(MI_GET_MANY_ENTRY) Z_ALL_REF_MAPS(M_GET_MANY_ENTRY) default: 0)(m, keys, n, out)
+#define zmap_put_many(m, keys, vals, n) _Generic((m), Z_ALL_MAPS(M_PUT_MANY_ENTRY) Z_ALL_INLINE_MAPS(MI_PUT_MANY_ENTRY) Z_ALL_REF_MAPS(M_PUT_MANY_ENTRY) default: 0)(m, keys, vals, n)
+
+// Single-probe lookup that inserts def when key is absent. Returns the value
+// pointer (NULL on OOM); *inserted (may be NULL) tells whether def was stored.
+#define zmap_get_or_insert(m, key, def, inserted) _Generic((m), Z_ALL_MAPS(M_GET_OR_INSERT) Z_ALL_INLINE_MAPS(MI_GET_OR_INSERT) Z_ALL_REF_MAPS(M_GET_OR_INSERT) default: 0)(m, key, def, inserted)
+
+// Capacity control (standard maps).
+#define zmap_reserve(m, n)      _Generic((m), Z_ALL_MAPS(M_RESERVE_ENTRY) Z_ALL_INLINE_MAPS(MI_RESERVE_ENTRY) Z_ALL_REF_MAPS(M_RESERVE_ENTRY) default: 0)(m, n)
+#define zmap_shrink_to_fit(m)   _Generic((m), Z_ALL_MAPS(M_SHRINK_ENTRY) Z_ALL_INLINE_MAPS(MI_SHRINK_ENTRY) Z_ALL_REF_MAPS(M_SHRINK_ENTRY) default: 0)(m)
+
+// Seed rotation (standard maps): rehashes every entry under seed s in place, without a second table.
+#define zmap_rehash(m, s)       _Generic((m), Z_ALL_MAPS(M_REHASH_ENTRY) Z_ALL_INLINE_MAPS(MI_REHASH_ENTRY) Z_ALL_REF_MAPS(M_REHASH_ENTRY) default: (void)0)(m, s)
+
+#ifdef ZMAP_ENABLE_COUNTERS
+#   define M_COUNTERS_ENTRY(K, V, N)       zmap_##N*: zmap_counters_##N,
+#   define M_RESET_COUNTERS_ENTRY(K, V, N) zmap_##N*: zmap_reset_counters_##N,
+#   define MI_COUNTERS_ENTRY(K, V, N, H, E)       M_COUNTERS_ENTRY(K, V, N)
+#   define MI_RESET_COUNTERS_ENTRY(K, V, N, H, E) M_RESET_COUNTERS_ENTRY(K, V, N)
+
+// Operation counters (standard maps, ZMAP_ENABLE_COUNTERS only). zmap_counters returns a copy.
+#   define zmap_counters(m)       _Generic((m), Z_ALL_MAPS(M_COUNTERS_ENTRY) Z_ALL_INLINE_MAPS(MI_COUNTERS_ENTRY) Z_ALL_REF_MAPS(M_COUNTERS_ENTRY) default: zmap_counters_none)(m)
+#   define zmap_reset_counters(m) _Generic((m), Z_ALL_MAPS(M_RESET_COUNTERS_ENTRY) Z_ALL_INLINE_MAPS(MI_RESET_COUNTERS_ENTRY) Z_ALL_REF_MAPS(M_RESET_COUNTERS_ENTRY) default: (void)0)(m)
 #endif
 
-#define zmap_put(m, k, v)   _Generic((m), Z_ALL_MAPS(M_PUT_ENTRY)  Z_ALL_STABLE_MAPS(S_PUT_ENTRY)  default: 0)(m, k, v)
-#define zmap_get(m, k)      _Generic((m), Z_ALL_MAPS(M_GET_ENTRY)  Z_ALL_STABLE_MAPS(S_GET_ENTRY)  default: (void*)0)(m, k)
-#define zmap_remove(m, k)   _Generic((m), Z_ALL_MAPS(M_REM_ENTRY)  Z_ALL_STABLE_MAPS(S_REM_ENTRY)  default: (void)0)(m, k)
-#define zmap_free(m)        _Generic((m), Z_ALL_MAPS(M_FREE_ENTRY) Z_ALL_STABLE_MAPS(S_FREE_ENTRY) default: (void)0)(m)
-#define zmap_size(m)        _Generic((m), Z_ALL_MAPS(M_SIZE_ENTRY) Z_ALL_STABLE_MAPS(S_SIZE_ENTRY) default: 0)(m)
-#define zmap_clear(m)       _Generic((m), Z_ALL_MAPS(M_CLEAR_ENTRY)Z_ALL_STABLE_MAPS(S_CLEAR_ENTRY)default: (void)0)(m)
-#define zmap_set_seed(m, s) _Generic((m), Z_ALL_MAPS(M_SEED_ENTRY) Z_ALL_STABLE_MAPS(S_SEED_ENTRY) default: (void)0)(m, s)
+// Probe and occupancy statistics (standard maps): zmap_stats(m, &stats).
+#define zmap_stats(m, s)        _Generic((m), Z_ALL_MAPS(M_STATS_ENTRY) Z_ALL_INLINE_MAPS(MI_STATS_ENTRY) Z_ALL_REF_MAPS(M_STATS_ENTRY) default: (void)0)(m, s)
+
+// Bytes a map holds: struct, table arrays, and stable-map values. O(1).
+#define zmap_memory_usage(m)    _Generic((m), ZMAP_ALL_CASES(MEM_ENTRY) default: 0)(m)
+
+// Incremental maps: migrate up to n old buckets now (e.g. from an idle loop).
+// Returns true while a resize is still in flight.
+#define zmap_migrate(m, n) _Generic((m), Z_ALL_INCR_MAPS(R_MIGRATE_ENTRY) default: 0)(m, n)
+
+// Thread-safe maps (concurrent and seqlock). A separate family: values are copied out instead of returned by pointer.
+#define zmap_concurrent_put(m, k, v)     _Generic((m), ZMAP_SHARED_CASES(PUT_ENTRY)    default: 0)(m, k, v)
+#define zmap_concurrent_get(m, k, out)   _Generic((m), ZMAP_SHARED_CASES(GET_ENTRY)    default: 0)(m, k, out)
+#define zmap_concurrent_remove(m, k)     _Generic((m), ZMAP_SHARED_CASES(REM_ENTRY)    default: 0)(m, k)
+#define zmap_concurrent_upsert(m, k, init, fn, ctx) \
+    _Generic((m), ZMAP_SHARED_CASES(UPSERT_ENTRY) default: 0)(m, k, init, fn, ctx)
+#define zmap_concurrent_size(m)          _Generic((m), ZMAP_SHARED_CASES(SIZE_ENTRY)   default: 0)(m)
+#define zmap_concurrent_clear(m)         _Generic((m), ZMAP_SHARED_CASES(CLEAR_ENTRY)  default: (void)0)(m)
+#define zmap_concurrent_free(m)          _Generic((m), ZMAP_SHARED_CASES(FREE_ENTRY)   default: (void)0)(m)
 
 #if Z_HAS_ZERROR
-#   define zmap_put_safe(m, k, v) _Generic((m), Z_ALL_MAPS(M_PUT_SAFE_ENTRY) default: zmap_err_dummy)(m, k, v, __FILE__, __LINE__, __func__)
-#   define zmap_get_safe(m, k)    _Generic((m), Z_ALL_MAPS(M_GET_SAFE_ENTRY) default: zmap_err_dummy)(m, k, __FILE__, __LINE__, __func__)
+#   define zmap_put_safe(m, k, v) _Generic((m), Z_ALL_MAPS(M_PUT_SAFE_ENTRY) Z_ALL_REF_MAPS(M_PUT_SAFE_ENTRY) default: zmap_err_dummy)(m, k, v, __FILE__, __LINE__, __func__)
+#   define zmap_get_safe(m, k)    _Generic((m), Z_ALL_MAPS(M_GET_SAFE_ENTRY) Z_ALL_REF_MAPS(M_GET_SAFE_ENTRY) default: zmap_err_dummy)(m, k, __FILE__, __LINE__, __func__)
 #endif
 
+// Sets. zset_insert returns Z_OK when the key was added and Z_FOUND when it was already present.
+#define zset_insert(s, k)       _Generic((s), Z_ALL_SETS(ST_INSERT_ENTRY) default: 0)(s, k)
+#define zset_contains(s, k)     _Generic((s), Z_ALL_SETS(ST_HAS_ENTRY)    default: 0)(s, k)
+#define zset_remove(s, k)       _Generic((s), Z_ALL_SETS(ST_REM_ENTRY)    default: 0)(s, k)
+#define zset_free(s)            _Generic((s), Z_ALL_SETS(ST_FREE_ENTRY)   default: (void)0)(s)
+#define zset_size(s)            _Generic((s), Z_ALL_SETS(ST_SIZE_ENTRY)   default: 0)(s)
+#define zset_clear(s)           _Generic((s), Z_ALL_SETS(ST_CLEAR_ENTRY)  default: (void)0)(s)
+#define zset_set_seed(s, seed)  _Generic((s), Z_ALL_SETS(ST_SEED_ENTRY)   default: (void)0)(s, seed)
+#define zset_iter_init(Name, s) zset_iter_init_##Name(s)
+#define zset_iter_next(it, k)   _Generic((it), Z_ALL_SETS(ST_ITER_NEXT)   default: false)(it, k)
+#define zset_memory_usage(s)    _Generic((s), Z_ALL_SETS(ST_MEM_ENTRY)    default: 0)(s)
+
+// Frozen snapshots (maps also listed in REGISTER_ZMAP_FROZEN_TYPES).
+#define zmap_freeze(m, path)    _Generic((m), Z_ALL_FROZEN_MAPS(F_FREEZE_ENTRY) default: 0)(m, path)
+#define zmap_frozen_get(f, k)   _Generic((f), Z_ALL_FROZEN_MAPS(F_GET_ENTRY)    default: (void*)0)(f, k)
+#define zmap_frozen_size(f)     _Generic((f), Z_ALL_FROZEN_MAPS(F_SIZE_ENTRY)   default: 0)(f)
+#define zmap_frozen_verify(f)   _Generic((f), Z_ALL_FROZEN_MAPS(F_VERIFY_ENTRY) default: false)(f)
+#define zmap_frozen_close(f)    _Generic((f), Z_ALL_FROZEN_MAPS(F_CLOSE_ENTRY)  default: (void)0)(f)
+
+// Perfect hash tables (REGISTER_ZMAP_PERFECT_TYPES), built once by zmap_build_perfect.
+#define zmap_perfect_get(p, k)  _Generic((p), Z_ALL_PERFECT_MAPS(P_GET_ENTRY)  default: (void*)0)(p, k)
+#define zmap_perfect_size(p)    _Generic((p), Z_ALL_PERFECT_MAPS(P_SIZE_ENTRY) default: 0)(p)
+#define zmap_perfect_free(p)    _Generic((p), Z_ALL_PERFECT_MAPS(P_FREE_ENTRY) default: (void)0)(p)
+
 // Iterators.
-#define zmap_iter_init(Name, m) _Generic((m), Z_ALL_MAPS(M_ITER_INIT) Z_ALL_STABLE_MAPS(S_ITER_INIT) default: 0)(m)
-#define zmap_iter_next(it, k, v) _Generic((it), Z_ALL_MAPS(M_ITER_NEXT) Z_ALL_STABLE_MAPS(S_ITER_NEXT) default: false)(it, k, v)
+#define zmap_iter_init(Name, m) _Generic((m), ZMAP_ALL_CASES(ITER_INIT) default: 0)(m)
+#define zmap_iter_next(it, k, v) _Generic((it), ZMAP_ALL_CASES(ITER_NEXT) default: false)(it, k, v)
 
 /* * zmap_foreach(Name, m, k_ptr, v_ptr)
  * Iterates over the map. k_ptr and v_ptr are assigned pointers to key and value.
@@ -1476,8 +5936,21 @@ Z_ALL_STABLE_MAPS(ZMAP_GENERATE_STABLE_IMPL)
 #ifdef ZMAP_SHORT_NAMES
 #   define map(Name)           zmap_##Name
 #   define map_stable(Name)    zmap_stable_##Name
+#   define map_group(Name)     zmap_group_##Name
+#   define map_soa(Name)       zmap_soa_##Name
+#   define map_incr(Name)      zmap_incr_##Name
+#   define map_concurrent(Name) zmap_concurrent_##Name
+#   define map_seqlock(Name)   zmap_seqlock_##Name
 #   define map_init            zmap_init
 #   define map_init_stable     zmap_init_stable 
+#   define map_init_stable_arena zmap_init_stable_arena
+#   define map_init_alloc      zmap_init_alloc
+#   define map_init_group      zmap_init_group
+#   define map_init_soa        zmap_init_soa
+#   define map_init_incr       zmap_init_incr
+#   define map_init_concurrent zmap_init_concurrent
+#   define map_init_seqlock    zmap_init_seqlock
+#   define map_init_inline     zmap_init_inline
 #   define map_autofree        zmap_autofree
 #   define map_autofree_stable zmap_autofree_stable
 #   define map_put             zmap_put
@@ -1487,10 +5960,31 @@ Z_ALL_STABLE_MAPS(ZMAP_GENERATE_STABLE_IMPL)
 #   define map_size            zmap_size
 #   define map_clear           zmap_clear
 #   define map_set_seed        zmap_set_seed
+#   define map_get_many        zmap_get_many
+#   define map_put_many        zmap_put_many
+#   define map_get_or_insert   zmap_get_or_insert
+#   define map_reserve         zmap_reserve
+#   define map_shrink_to_fit   zmap_shrink_to_fit
+#   define map_rehash          zmap_rehash
+#   define map_stats           zmap_stats
+#   define map_memory_usage    zmap_memory_usage
+#   define map_migrate         zmap_migrate
     
 #   define map_iter_init       zmap_iter_init
 #   define map_iter_next       zmap_iter_next
 
+#   define set(Name)           zset_##Name
+#   define set_init            zset_init
+#   define set_insert          zset_insert
+#   define set_contains        zset_contains
+#   define set_remove          zset_remove
+#   define set_free            zset_free
+#   define set_size            zset_size
+#   define set_clear           zset_clear
+#   define set_iter_init       zset_iter_init
+#   define set_iter_next       zset_iter_next
+#   define set_memory_usage    zset_memory_usage
+
 #   if Z_HAS_ZERROR
 #       define map_put_safe    zmap_put_safe
 #       define map_get_safe    zmap_get_safe
@@ -1502,21 +5996,70 @@ Z_ALL_STABLE_MAPS(ZMAP_GENERATE_STABLE_IMPL)
 
 namespace z_map
 {
-    #define ZMAP_CPP_TRAITS(Key, Val, Name)                                 \
+    #define ZMAP_CPP_TRAITS_EX(Key, Val, Name, Baked, Pass)                 \
         template<> struct traits<Key, Val>                                  \
         {                                                                   \
+            static constexpr bool baked = Baked;                            \
+            using key_pass = detail::Pass<Key>;                             \
             using map_type = ::zmap_##Name;                                 \
             using bucket_type = ::zmap_bucket_##Name;                       \
             static constexpr auto init = ::zmap_init_ext_##Name;            \
             static constexpr auto put = ::zmap_put_##Name;                  \
+            static constexpr auto put_many = ::zmap_put_many_##Name;        \
+            static constexpr auto reserve = ::zmap_reserve_##Name;          \
+            static constexpr auto shrink = ::zmap_shrink_to_fit_##Name;     \
+            static constexpr auto rehash = ::zmap_rehash_##Name;            \
+            static constexpr auto stats = ::zmap_stats_##Name;              \
+            static constexpr auto memory_usage = ::zmap_memory_usage_##Name; \
+            static constexpr auto emplace = ::zmap_get_or_insert_##Name;    \
+            static constexpr auto insert_slot = ::zmap_insert_slot_##Name;  \
             static constexpr auto get = ::zmap_get_##Name;                  \
+            static constexpr auto get_many = ::zmap_get_many_##Name;        \
             static constexpr auto remove = ::zmap_remove_##Name;            \
             static constexpr auto clear = ::zmap_clear_##Name;              \
             static constexpr auto free = ::zmap_free_##Name;                \
             static constexpr auto set_seed = ::zmap_set_seed_##Name;        \
         };
 
+    #define ZMAP_CPP_TRAITS(Key, Val, Name)               ZMAP_CPP_TRAITS_EX(Key, Val, Name, false, key_by_value)
+    #define ZMAP_CPP_TRAITS_INLINE(Key, Val, Name, H, E)  ZMAP_CPP_TRAITS_EX(Key, Val, Name, true, key_by_value)
+    #define ZMAP_CPP_REF_TRAITS(Key, Val, Name)           ZMAP_CPP_TRAITS_EX(Key, Val, Name, false, key_by_ref)
+
     Z_ALL_MAPS(ZMAP_CPP_TRAITS)
+    Z_ALL_REF_MAPS(ZMAP_CPP_REF_TRAITS)
+    Z_ALL_INLINE_MAPS(ZMAP_CPP_TRAITS_INLINE)
+
+    #define ZMAP_CPP_CONCURRENT_TRAITS(Key, Val, Name)                      \
+        template<> struct concurrent_traits<Key, Val>                       \
+        {                                                                   \
+            using map_type = ::zmap_concurrent_##Name;                      \
+            static constexpr auto init = ::zmap_init_concurrent_##Name;     \
+            static constexpr auto put = ::zmap_put_concurrent_##Name;       \
+            static constexpr auto get = ::zmap_get_concurrent_##Name;       \
+            static constexpr auto remove = ::zmap_remove_concurrent_##Name; \
+            static constexpr auto upsert = ::zmap_upsert_concurrent_##Name; \
+            static constexpr auto size = ::zmap_size_concurrent_##Name;     \
+            static constexpr auto clear = ::zmap_clear_concurrent_##Name;   \
+            static constexpr auto free = ::zmap_free_concurrent_##Name;     \
+        };
+
+    Z_ALL_CONCURRENT_MAPS(ZMAP_CPP_CONCURRENT_TRAITS)
+
+    #define ZMAP_CPP_SET_TRAITS(Key, Name)                                  \
+        template<> struct set_traits<Key>                                   \
+        {                                                                   \
+            using set_type = ::zset_##Name;                                 \
+            static constexpr auto init = ::zset_init_ext_##Name;            \
+            static constexpr auto set_seed = ::zset_set_seed_##Name;        \
+            static constexpr auto insert = ::zset_insert_##Name;            \
+            static constexpr auto contains = ::zset_contains_##Name;        \
+            static constexpr auto remove = ::zset_remove_##Name;            \
+            static constexpr auto clear = ::zset_clear_##Name;              \
+            static constexpr auto free = ::zset_free_##Name;                \
+            static constexpr auto memory_usage = ::zset_memory_usage_##Name; \
+        };
+
+    Z_ALL_SETS(ZMAP_CPP_SET_TRAITS)
 }
 #endif // __cplusplus
 
@@ -656,8 +656,19 @@ do {
     zmap_uthash_sort((void**)&(head), (int(*)(void*,void*))(cmpfcn),                \
                      (head) ? (ptrdiff_t)((char*)&((head)->hh) - (char*)(head)) : 0)
 
-#define HASH_OVERHEAD(hh, head) \
-    ((head) ? (sizeof(UT_hash_table) + ((head)->hh.tbl->num_items * sizeof(UT_hash_handle))) : 0)
+/* Table, zmap bucket array (the map struct is already inside UT_hash_table),
+ * bloom filter and the handles embedded in the elements. */
+#ifdef HASH_BLOOM
+#define ZMAP_UTHASH_BLOOM_BYTES HASH_BLOOM_BYTELEN
+#else
+#define ZMAP_UTHASH_BLOOM_BYTES 0
+#endif
+
+#define HASH_OVERHEAD(hh, head)                                                               \
+    ((head) ? (sizeof(UT_hash_table)                                                          \
+               + (zmap_memory_usage_uthash_kv(&(head)->hh.tbl->map) - sizeof(zmap_uthash_kv)) \
+               + ZMAP_UTHASH_BLOOM_BYTES                                                      \
+               + ((head)->hh.tbl->num_items * sizeof(UT_hash_handle))) : 0)
 
 /* Helper macros */
 #define HH_FROM_ELMT(tbl, elmt) ((UT_hash_handle*)((char*)(elmt) + (tbl)->hho))